@@ -0,0 +1,514 @@
+// *****************************************************************************
+// * This file is part of the FreeFileSync project. It is distributed under    *
+// * GNU General Public License: http://www.gnu.org/licenses/gpl-3.0           *
+// * Copyright (C) Zenju (zenju AT freefilesync DOT org) - All Rights Reserved *
+// *****************************************************************************
+
+//reproducible measurement of folder traversal: generate a synthetic folder tree, scan it with cold and warm page cache and report
+//entries/sec, syscalls and peak memory usage, plus the memory footprint of the comparison result per row; write JSON output to compare results between versions
+
+#include <chrono>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <zen/file_access.h>
+#include <zen/file_io.h>
+#include <zen/string_tools.h>
+#include <zen/scope_guard.h>
+#include "tree_generator.h"
+#include "../lib/parallel_scan.h"
+#include "../fs/native.h"
+#include "../file_hierarchy.h"
+#include <malloc.h>              //mallinfo
+#include <unistd.h>              //sync, geteuid
+#include <sys/ioctl.h>           //
+#include <sys/syscall.h>         //perf_event_open
+#include <linux/perf_event.h>    //
+
+using namespace zen;
+
+
+namespace
+{
+const char USAGE[] =
+    "Usage: ScanBenchmark [options]\n"
+    "\n"
+    "Synthetic folder tree:\n"
+    "  --depth N          levels of sub folders                       (default 4)\n"
+    "  --fan-out N        sub folders per folder                      (default 8)\n"
+    "  --files N          files per folder                            (default 32)\n"
+    "  --symlinks N       symlinks per folder                         (default 2)\n"
+    "  --unreadable N     folders without access permissions          (default 0)\n"
+    "  --min-size BYTES   smallest file size, log-uniform distribution (default 0)\n"
+    "  --max-size BYTES   largest file size                           (default 1048576)\n"
+    "  --seed N           random seed                                 (default 1)\n"
+    "  --temp-dir PATH    create tree inside this folder              (default $TMPDIR or /tmp)\n"
+    "  --keep-tree        don't delete the tree after the benchmark\n"
+    "\n"
+    "Measurement:\n"
+    "  --threads N[,N...] threads per folder for zen::fillBuffer()    (default 1,4)\n"
+    "  --runs N           repetitions per configuration               (default 3)\n"
+    "  --output FILE      write results as JSON\n"
+    "\n"
+    "Cold page cache requires write access to /proc/sys/vm/drop_caches (root); syscalls are counted via the\n"
+    "raw_syscalls:sys_enter tracepoint (root or perf_event_paranoid = -1). Otherwise these values are omitted.\n";
+
+
+class SyscallCounter //counts syscalls of this process, including threads created after construction
+{
+public:
+    SyscallCounter()
+    {
+        for (const char* idPath : { "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+                                    "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id" })
+        {
+            std::ifstream idFile(idPath);
+            std::uint64_t tracepointId = 0;
+            if (idFile >> tracepointId)
+            {
+                ::perf_event_attr attr = {};
+                attr.type     = PERF_TYPE_TRACEPOINT;
+                attr.size     = sizeof(attr);
+                attr.config   = tracepointId;
+                attr.disabled = 1;
+                attr.inherit  = 1; //include worker threads: their counts are added when they exit
+
+                fd_ = static_cast<int>(::syscall(__NR_perf_event_open, &attr, 0 /*this process*/, -1 /*any CPU*/, -1 /*group*/, 0 /*flags*/));
+                if (fd_ != -1)
+                    break;
+            }
+        }
+    }
+
+    ~SyscallCounter() { if (fd_ != -1) ::close(fd_); }
+
+    void start()
+    {
+        if (fd_ != -1)
+        {
+            ::ioctl(fd_, PERF_EVENT_IOC_RESET,  0);
+            ::ioctl(fd_, PERF_EVENT_IOC_ENABLE, 0);
+        }
+    }
+
+    std::int64_t stop() //return -1 if not available
+    {
+        if (fd_ == -1)
+            return -1;
+        ::ioctl(fd_, PERF_EVENT_IOC_DISABLE, 0);
+
+        std::uint64_t count = 0;
+        if (::read(fd_, &count, sizeof(count)) != sizeof(count))
+            return -1;
+        return static_cast<std::int64_t>(count);
+    }
+
+private:
+    SyscallCounter           (const SyscallCounter&) = delete;
+    SyscallCounter& operator=(const SyscallCounter&) = delete;
+
+    int fd_ = -1;
+};
+
+
+bool dropPageCache() //return false if not permitted
+{
+    ::sync();
+    std::ofstream dropCaches("/proc/sys/vm/drop_caches");
+    return static_cast<bool>(dropCaches << "3" << std::flush); //page cache, dentries and inodes
+}
+
+
+void resetPeakMemory()
+{
+    std::ofstream("/proc/self/clear_refs") << "5"; //reset VmHWM: Linux 4.0 and later; otherwise the peak of the whole process is reported
+}
+
+
+std::int64_t getPeakMemoryKB() //return -1 if not available
+{
+    std::ifstream status("/proc/self/status");
+    for (std::string line; std::getline(status, line); )
+        if (startsWith(line, "VmHWM:"))
+            return stringTo<std::int64_t>(afterFirst(line, ':', IF_MISSING_RETURN_NONE)); //"VmHWM:	   12345 kB"
+    return -1;
+}
+
+
+std::uint64_t getHeapBytesInUse() //glibc: allocated blocks including mmap()ed ones; unlike RSS not distorted by memory freed earlier
+{
+#if __GLIBC_PREREQ(2, 33)
+    const struct ::mallinfo2 mi = ::mallinfo2();
+    return mi.uordblks + mi.hblkhd;
+#else
+    const struct ::mallinfo mi = ::mallinfo(); //int fields: wrap around beyond 4 GB
+    return static_cast<std::uint32_t>(mi.uordblks) + static_cast<std::uint32_t>(mi.hblkhd);
+#endif
+}
+
+//------------------------------------------------------------------------------------------
+
+struct ScanResult
+{
+    size_t items  = 0;
+    size_t errors = 0;
+};
+
+
+struct BenchmarkResult
+{
+    std::string method;
+    size_t threads = 1;
+    std::string cache; //"cold" or "warm"
+    size_t run = 0;
+    ScanResult scan;
+    double seconds = 0;
+    std::int64_t syscalls = -1;
+    std::int64_t peakMemoryKB = -1;
+};
+
+
+struct MemoryResult //comparison result built from the scan: memory per row
+{
+    size_t rows = 0;
+    double bytesPerRow = 0;           //total heap usage
+    double objectPoolBytesPerRow = 0; //... of which FilePair, FolderPair, SymlinkPair
+};
+
+
+size_t countItems(const FolderContainer& folder)
+{
+    size_t itemCount = folder.files.size() + folder.symlinks.size() + folder.folders.size();
+    for (const auto& subFolder : folder.folders)
+        itemCount += countItems(subFolder.second);
+    return itemCount;
+}
+
+
+class BenchmarkFillBufferCallback : public FillBufferCallback
+{
+public:
+    BenchmarkFillBufferCallback(size_t& errorCount) : errorCount_(errorCount) {}
+
+    HandleError reportError(const std::wstring& msg, size_t retryNumber) override { ++errorCount_; return ON_ERROR_IGNORE; } //expected for unreadable folders
+    void        reportStatus(const std::wstring& msg, int itemsTotal) override {}
+    void reportFolderScanned(const DirectoryKey& key) override {}
+
+private:
+    size_t& errorCount_;
+};
+
+
+ScanResult runFillBuffer(const AbstractPath& baseFolderPath, size_t threads)
+{
+    const std::set<DirectoryKey> keys { DirectoryKey(baseFolderPath, std::make_shared<NullFilter>(), SymLinkHandling::DIRECT) };
+    std::map<DirectoryKey, DirectoryValue> buf;
+
+    ScanResult result;
+    BenchmarkFillBufferCallback callback(result.errors);
+
+    fillBuffer(keys, buf, callback, threads, false /*allowStaleAttributes*/, SCAN_SNAPSHOT_OFF, false /*deferErrors*/, 100 /*updateIntervalMs*/);
+
+    for (const auto& item : buf)
+        result.items += countItems(item.second.folderCont);
+    return result;
+}
+
+
+class CountingTraverserCallback : public AFS::TraverserCallback //raw traversal speed: no output container, no filtering
+{
+public:
+    CountingTraverserCallback(ScanResult& result) : result_(result) {}
+
+    void                               onFile   (const FileInfo&    fi) override { ++result_.items; }
+    HandleLink                         onSymlink(const SymlinkInfo& si) override { ++result_.items; return LINK_SKIP; }
+    std::unique_ptr<TraverserCallback> onDir    (const DirInfo&     di) override { ++result_.items; return std::make_unique<CountingTraverserCallback>(result_); }
+
+    HandleError reportDirError (const std::wstring& msg, size_t retryNumber)                          override { ++result_.errors; return ON_ERROR_IGNORE; }
+    HandleError reportItemError(const std::wstring& msg, size_t retryNumber, const Zstring& itemName) override { ++result_.errors; return ON_ERROR_IGNORE; }
+
+private:
+    ScanResult& result_;
+};
+
+
+ScanResult runTraverseFolder(const AbstractPath& baseFolderPath)
+{
+    ScanResult result;
+    CountingTraverserCallback callback(result);
+    AFS::traverseFolder(baseFolderPath, callback);
+    return result;
+}
+
+
+void addEqualPairs(HierarchyObject& hierObj, const FolderContainer& folderCont) //all items exist on both sides
+{
+    //like MergeSides: convert each scanned name only once
+    for (const auto& file : folderCont.files)
+    {
+        const Zstring itemName = file.first;
+        hierObj.addSubFile(itemName, file.second, FILE_EQUAL, itemName, file.second);
+    }
+
+    for (const auto& symlink : folderCont.symlinks)
+    {
+        const Zstring itemName = symlink.first;
+        hierObj.addSubLink(itemName, symlink.second, SYMLINK_EQUAL, itemName, symlink.second);
+    }
+
+    for (const auto& folder : folderCont.folders)
+    {
+        const Zstring itemName = folder.first;
+        addEqualPairs(hierObj.addSubFolder(itemName, itemName, DIR_EQUAL), folder.second);
+    }
+}
+
+
+//memory footprint of the comparison result: like comparing the folder tree with an identical copy
+MemoryResult measureComparisonMemory(const AbstractPath& baseFolderPath)
+{
+    const std::set<DirectoryKey> keys { DirectoryKey(baseFolderPath, std::make_shared<NullFilter>(), SymLinkHandling::DIRECT) };
+    std::map<DirectoryKey, DirectoryValue> buf;
+
+    size_t errorCount = 0;
+    BenchmarkFillBufferCallback callback(errorCount);
+    fillBuffer(keys, buf, callback, 1, false /*allowStaleAttributes*/, SCAN_SNAPSHOT_OFF, false /*deferErrors*/, 100 /*updateIntervalMs*/);
+
+    MemoryResult result;
+    const std::uint64_t heapBytesBefore = getHeapBytesInUse();
+
+    BaseFolderPair baseFolder(baseFolderPath, true, baseFolderPath, true, keys.begin()->filter_, CompareVariant::TIME_SIZE, 2, std::vector<unsigned int>());
+    for (const auto& item : buf)
+        addEqualPairs(baseFolder, item.second.folderCont);
+
+    const std::uint64_t heapBytes = getHeapBytesInUse() - heapBytesBefore;
+
+    for (const auto& item : buf)
+        result.rows += countItems(item.second.folderCont);
+    if (result.rows > 0)
+    {
+        result.bytesPerRow           = static_cast<double>(heapBytes)                     / result.rows;
+        result.objectPoolBytesPerRow = static_cast<double>(baseFolder.getObjectPoolSize()) / result.rows;
+    }
+    return result;
+}
+
+
+template <class Function>
+BenchmarkResult measure(Function runScan, SyscallCounter& syscallCounter)
+{
+    BenchmarkResult result;
+    resetPeakMemory();
+    syscallCounter.start();
+    const auto startTime = std::chrono::steady_clock::now();
+
+    result.scan = runScan();
+
+    result.seconds      = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+    result.syscalls     = syscallCounter.stop();
+    result.peakMemoryKB = getPeakMemoryKB();
+    return result;
+}
+
+//------------------------------------------------------------------------------------------
+
+std::string jsonString(const std::string& str)
+{
+    std::string output = "\"";
+    for (const char c : str)
+        if (c == '"' || c == '\\')
+            output += std::string("\\") + c;
+        else if (static_cast<unsigned char>(c) < 0x20)
+            output += "\\u00" + std::string(1, "0123456789abcdef"[c >> 4]) + "0123456789abcdef"[c & 0xf];
+        else
+            output += c;
+    return output + "\"";
+}
+
+
+template <class Num>
+std::string jsonNumber(Num number) { return number < 0 ? "null" : numberTo<std::string>(number); } //-1: not available
+
+
+std::string formatJson(const TreeConfig& cfg, const TreeStats& stats, const std::vector<BenchmarkResult>& results, const MemoryResult& memory)
+{
+    std::string output = "{\n";
+    output += "  \"tree\": {";
+    output += "\"depth\": "              + numberTo<std::string>(cfg.depth);
+    output += ", \"fanOut\": "           + numberTo<std::string>(cfg.fanOut);
+    output += ", \"filesPerFolder\": "   + numberTo<std::string>(cfg.filesPerFolder);
+    output += ", \"symlinksPerFolder\": "+ numberTo<std::string>(cfg.symlinksPerFolder);
+    output += ", \"minFileSize\": "      + numberTo<std::string>(cfg.minFileSize);
+    output += ", \"maxFileSize\": "      + numberTo<std::string>(cfg.maxFileSize);
+    output += ", \"seed\": "             + numberTo<std::string>(cfg.seed);
+    output += ", \"folders\": "          + numberTo<std::string>(stats.folders);
+    output += ", \"files\": "            + numberTo<std::string>(stats.files);
+    output += ", \"symlinks\": "         + numberTo<std::string>(stats.symlinks);
+    output += ", \"unreadableFolders\": "+ numberTo<std::string>(stats.unreadableFolders);
+    output += ", \"bytes\": "            + numberTo<std::string>(stats.bytes);
+    output += "},\n";
+    output += "  \"results\": [";
+
+    for (auto it = results.begin(); it != results.end(); ++it)
+    {
+        output += it == results.begin() ? "\n" : ",\n";
+        output += "    {\"method\": " + jsonString(it->method);
+        output += ", \"threads\": "      + numberTo<std::string>(it->threads);
+        output += ", \"cache\": "        + jsonString(it->cache);
+        output += ", \"run\": "          + numberTo<std::string>(it->run);
+        output += ", \"items\": "        + numberTo<std::string>(it->scan.items);
+        output += ", \"errors\": "       + numberTo<std::string>(it->scan.errors);
+        output += ", \"seconds\": "      + numberTo<std::string>(it->seconds);
+        output += ", \"itemsPerSec\": "  + numberTo<std::string>(it->seconds > 0 ? it->scan.items / it->seconds : 0.0);
+        output += ", \"syscalls\": "     + jsonNumber(it->syscalls);
+        output += ", \"peakMemoryKB\": " + jsonNumber(it->peakMemoryKB);
+        output += "}";
+    }
+    output += "\n  ],\n";
+    output += "  \"comparisonResult\": {";
+    output += "\"rows\": "                    + numberTo<std::string>(memory.rows);
+    output += ", \"bytesPerRow\": "           + numberTo<std::string>(memory.bytesPerRow);
+    output += ", \"objectPoolBytesPerRow\": " + numberTo<std::string>(memory.objectPoolBytesPerRow);
+    output += ", \"sizeofFilePair\": "        + numberTo<std::string>(sizeof(FilePair));
+    output += ", \"sizeofFolderPair\": "      + numberTo<std::string>(sizeof(FolderPair));
+    output += ", \"sizeofSymlinkPair\": "     + numberTo<std::string>(sizeof(SymlinkPair));
+    output += "}\n}\n";
+    return output;
+}
+
+
+void printResult(const BenchmarkResult& result)
+{
+    std::cout << result.method << " threads=" << result.threads << " cache=" << result.cache << " run=" << result.run <<
+              ": " << result.scan.items << " items, " << result.scan.errors << " errors, " << result.seconds << " s, " <<
+              static_cast<std::int64_t>(result.seconds > 0 ? result.scan.items / result.seconds : 0) << " items/s, syscalls=" <<
+              jsonNumber(result.syscalls) << ", peak memory=" << jsonNumber(result.peakMemoryKB) << " KB" << std::endl;
+}
+}
+
+
+int main(int argc, char* argv[])
+{
+    TreeConfig cfg;
+    std::vector<size_t> threadCounts { 1, 4 };
+    size_t runs = 3;
+    Zstring tempFolderPath;
+    Zstring outputFilePath;
+    bool keepTree = false;
+
+    for (int i = 1; i < argc; ++i)
+    {
+        const std::string arg = argv[i];
+        const auto nextArg = [&]() -> std::string
+        {
+            if (i + 1 >= argc)
+                throw std::string("Missing value for " + arg);
+            return argv[++i];
+        };
+
+        try
+        {
+            if      (arg == "--depth"     ) cfg.depth             = stringTo<size_t>(nextArg());
+            else if (arg == "--fan-out"   ) cfg.fanOut            = stringTo<size_t>(nextArg());
+            else if (arg == "--files"     ) cfg.filesPerFolder    = stringTo<size_t>(nextArg());
+            else if (arg == "--symlinks"  ) cfg.symlinksPerFolder = stringTo<size_t>(nextArg());
+            else if (arg == "--unreadable") cfg.unreadableFolders = stringTo<size_t>(nextArg());
+            else if (arg == "--min-size"  ) cfg.minFileSize       = stringTo<std::uint64_t>(nextArg());
+            else if (arg == "--max-size"  ) cfg.maxFileSize       = stringTo<std::uint64_t>(nextArg());
+            else if (arg == "--seed"      ) cfg.seed              = stringTo<std::uint32_t>(nextArg());
+            else if (arg == "--runs"      ) runs                  = std::max<size_t>(stringTo<size_t>(nextArg()), 1);
+            else if (arg == "--temp-dir"  ) tempFolderPath        = utfCvrtTo<Zstring>(nextArg());
+            else if (arg == "--output"    ) outputFilePath        = utfCvrtTo<Zstring>(nextArg());
+            else if (arg == "--keep-tree" ) keepTree              = true;
+            else if (arg == "--threads")
+            {
+                threadCounts.clear();
+                for (const std::string& count : split(nextArg(), ','))
+                    threadCounts.push_back(std::max<size_t>(stringTo<size_t>(count), 1));
+            }
+            else
+                throw std::string(arg == "--help" ? "" : "Unknown option: " + arg);
+        }
+        catch (const std::string& msg)
+        {
+            if (!msg.empty())
+                std::cerr << msg << "\n\n";
+            std::cerr << USAGE;
+            return msg.empty() ? 0 : 1;
+        }
+    }
+
+    if (tempFolderPath.empty())
+        try
+        {
+            tempFolderPath = getTempFolderPath(); //throw FileError
+        }
+        catch (FileError&) { tempFolderPath = Zstr("/tmp"); }
+
+    Zstring baseFolderPath;
+    try
+    {
+        ZEN_ON_SCOPE_EXIT(if (!keepTree && !baseFolderPath.empty())
+                          try { removeTree(baseFolderPath); /*throw FileError*/ }
+                          catch (const FileError& e) { std::cerr << utfCvrtTo<std::string>(e.toString()) << std::endl; });
+
+        std::cout << "Generating folder tree..." << std::endl;
+        const TreeStats stats = generateTree(cfg, tempFolderPath, baseFolderPath); //throw FileError
+
+        std::cout << utfCvrtTo<std::string>(baseFolderPath) << ": " << stats.folders << " folders, " << stats.files << " files, " <<
+                  stats.symlinks << " symlinks, " << stats.unreadableFolders << " unreadable folders" << std::endl;
+        if (stats.unreadableFolders > 0 && ::geteuid() == 0)
+            std::cout << "Note: running as root => unreadable folders are traversed nevertheless" << std::endl;
+
+        const AbstractPath baseFolderPathAbs = createItemPathNativeNoFormatting(baseFolderPath);
+        SyscallCounter syscallCounter;
+        std::vector<BenchmarkResult> results;
+
+        const auto benchmark = [&](const std::string& method, size_t threads, const std::function<ScanResult()>& runScan)
+        {
+            if (dropPageCache())
+                for (size_t run = 1; run <= runs; ++run)
+                {
+                    dropPageCache();
+                    BenchmarkResult result = measure(runScan, syscallCounter);
+                    result.method  = method;
+                    result.threads = threads;
+                    result.cache   = "cold";
+                    result.run     = run;
+                    printResult(result);
+                    results.push_back(result);
+                }
+
+            runScan(); //fill the page cache
+            for (size_t run = 1; run <= runs; ++run)
+            {
+                BenchmarkResult result = measure(runScan, syscallCounter);
+                result.method  = method;
+                result.threads = threads;
+                result.cache   = "warm";
+                result.run     = run;
+                printResult(result);
+                results.push_back(result);
+            }
+        };
+
+        benchmark("traverseFolder", 1, [&] { return runTraverseFolder(baseFolderPathAbs); });
+
+        for (const size_t threads : threadCounts)
+            benchmark("fillBuffer", threads, [&] { return runFillBuffer(baseFolderPathAbs, threads); });
+
+        const MemoryResult memory = measureComparisonMemory(baseFolderPathAbs);
+        std::cout << "comparison result: " << memory.rows << " rows, " << memory.bytesPerRow << " bytes/row, of which object pool: " <<
+                  memory.objectPoolBytesPerRow << " bytes/row (sizeof FilePair=" << sizeof(FilePair) << ", FolderPair=" << sizeof(FolderPair) <<
+                  ", SymlinkPair=" << sizeof(SymlinkPair) << ")" << std::endl;
+
+        if (!outputFilePath.empty())
+            saveBinContainer(outputFilePath, formatJson(cfg, stats, results, memory), nullptr); //throw FileError
+    }
+    catch (const FileError& e)
+    {
+        std::cerr << utfCvrtTo<std::string>(e.toString()) << std::endl;
+        return 1;
+    }
+    return 0;
+}
@@ -0,0 +1,141 @@
+// *****************************************************************************
+// * This file is part of the FreeFileSync project. It is distributed under    *
+// * GNU General Public License: http://www.gnu.org/licenses/gpl-3.0           *
+// * Copyright (C) Zenju (zenju AT freefilesync DOT org) - All Rights Reserved *
+// *****************************************************************************
+
+#include "tree_generator.h"
+#include <cmath>
+#include <random>
+#include <vector>
+#include <algorithm>
+#include <cstring>
+#include <zen/file_access.h>
+#include <zen/scope_guard.h>
+#include <fcntl.h>    //open
+#include <unistd.h>   //ftruncate, symlink
+#include <dirent.h>   //opendir
+#include <sys/stat.h> //mkdir, chmod
+
+using namespace zen;
+
+
+namespace
+{
+std::uint64_t getRandomFileSize(const TreeConfig& cfg, std::mt19937& rng)
+{
+    if (cfg.maxFileSize <= cfg.minFileSize)
+        return cfg.minFileSize;
+
+    std::uniform_real_distribution<double> dist(std::log(cfg.minFileSize + 1.0), std::log(cfg.maxFileSize + 1.0));
+    return std::min(cfg.maxFileSize, std::max(cfg.minFileSize, static_cast<std::uint64_t>(std::exp(dist(rng)) - 1)));
+}
+
+
+void createSparseFile(const Zstring& filePath, std::uint64_t fileSize) //throw FileError
+{
+    const int fdFile = ::open(filePath.c_str(), O_WRONLY | O_CREAT | O_EXCL, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+    if (fdFile == -1)
+        THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot write file %x."), L"%x", fmtPath(filePath)), L"open");
+    ZEN_ON_SCOPE_EXIT(::close(fdFile));
+
+    if (::ftruncate(fdFile, fileSize) != 0)
+        THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot write file %x."), L"%x", fmtPath(filePath)), L"ftruncate");
+}
+
+
+void fillFolder(const TreeConfig& cfg, const Zstring& folderPath, size_t level, std::mt19937& rng, std::vector<Zstring>& subFolders, TreeStats& stats) //throw FileError
+{
+    for (size_t i = 0; i < cfg.filesPerFolder; ++i)
+    {
+        const std::uint64_t fileSize = getRandomFileSize(cfg, rng);
+        createSparseFile(appendSeparator(folderPath) + Zstr("file_") + numberTo<Zstring>(i) + Zstr(".dat"), fileSize); //throw FileError
+        ++stats.files;
+        stats.bytes += fileSize;
+    }
+
+    for (size_t i = 0; i < cfg.symlinksPerFolder; ++i)
+    {
+        const Zstring linkPath = appendSeparator(folderPath) + Zstr("link_") + numberTo<Zstring>(i);
+        const Zstring target = i % 2 == 0 && cfg.filesPerFolder > 0 ?
+                               Zstr("file_") + numberTo<Zstring>(i % cfg.filesPerFolder) + Zstr(".dat") :
+                               Zstring(Zstr("missing_target"));
+        if (::symlink(target.c_str(), linkPath.c_str()) != 0)
+            THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot create symbolic link %x."), L"%x", fmtPath(linkPath)), L"symlink");
+        ++stats.symlinks;
+    }
+
+    if (level < cfg.depth)
+        for (size_t i = 0; i < cfg.fanOut; ++i)
+        {
+            const Zstring subFolderPath = appendSeparator(folderPath) + Zstr("folder_") + numberTo<Zstring>(i);
+            if (::mkdir(subFolderPath.c_str(), S_IRWXU | S_IRGRP | S_IXGRP | S_IROTH | S_IXOTH) != 0)
+                THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot create directory %x."), L"%x", fmtPath(subFolderPath)), L"mkdir");
+            ++stats.folders;
+            subFolders.push_back(subFolderPath);
+
+            fillFolder(cfg, subFolderPath, level + 1, rng, subFolders, stats); //throw FileError
+        }
+}
+
+
+void restorePermissions(const Zstring& folderPath) //throw FileError
+{
+    if (::chmod(folderPath.c_str(), S_IRWXU) != 0)
+        THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot write permissions of %x."), L"%x", fmtPath(folderPath)), L"chmod");
+
+    std::vector<Zstring> subFolders;
+    {
+        DIR* folder = ::opendir(folderPath.c_str());
+        if (!folder)
+            THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot open directory %x."), L"%x", fmtPath(folderPath)), L"opendir");
+        ZEN_ON_SCOPE_EXIT(::closedir(folder));
+
+        while (const ::dirent* entry = ::readdir(folder)) //no need for readdir_r: one DIR per thread
+            if (::strcmp(entry->d_name, ".") != 0 && ::strcmp(entry->d_name, "..") != 0)
+            {
+                const Zstring itemPath = appendSeparator(folderPath) + entry->d_name;
+                struct ::stat statData = {};
+                if (entry->d_type == DT_DIR ||
+                    (entry->d_type == DT_UNKNOWN && ::lstat(itemPath.c_str(), &statData) == 0 && S_ISDIR(statData.st_mode)))
+                    subFolders.push_back(itemPath);
+            }
+    }
+
+    for (const Zstring& subFolderPath : subFolders)
+        restorePermissions(subFolderPath); //throw FileError
+}
+}
+
+
+TreeStats zen::generateTree(const TreeConfig& cfg, const Zstring& parentFolderPath, Zstring& baseFolderPath) //throw FileError
+{
+    Zstring pathTemplate = appendSeparator(parentFolderPath) + Zstr("FFS_ScanBenchmark_XXXXXX");
+    if (!::mkdtemp(pathTemplate.begin()))
+        THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot create directory %x."), L"%x", fmtPath(pathTemplate)), L"mkdtemp");
+    baseFolderPath = pathTemplate;
+
+    std::mt19937 rng(cfg.seed);
+    std::vector<Zstring> subFolders;
+    TreeStats stats;
+
+    fillFolder(cfg, baseFolderPath, 0, rng, subFolders, stats); //throw FileError
+
+    std::shuffle(subFolders.begin(), subFolders.end(), rng);
+    subFolders.resize(std::min(subFolders.size(), cfg.unreadableFolders));
+
+    for (const Zstring& folderPath : subFolders)
+    {
+        if (::chmod(folderPath.c_str(), 0) != 0)
+            THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot write permissions of %x."), L"%x", fmtPath(folderPath)), L"chmod");
+        ++stats.unreadableFolders;
+    }
+    return stats;
+}
+
+
+void zen::removeTree(const Zstring& baseFolderPath) //throw FileError
+{
+    restorePermissions(baseFolderPath);         //throw FileError
+    removeDirectoryRecursively(baseFolderPath); //
+}
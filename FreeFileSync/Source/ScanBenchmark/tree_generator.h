@@ -0,0 +1,45 @@
+// *****************************************************************************
+// * This file is part of the FreeFileSync project. It is distributed under    *
+// * GNU General Public License: http://www.gnu.org/licenses/gpl-3.0           *
+// * Copyright (C) Zenju (zenju AT freefilesync DOT org) - All Rights Reserved *
+// *****************************************************************************
+
+#ifndef TREE_GENERATOR_H_8340572304857203485
+#define TREE_GENERATOR_H_8340572304857203485
+
+#include <cstdint>
+#include <zen/zstring.h>
+#include <zen/file_error.h>
+
+
+namespace zen
+{
+struct TreeConfig
+{
+    size_t depth             = 4;  //levels of sub folders below the base folder
+    size_t fanOut            = 8;  //sub folders per folder
+    size_t filesPerFolder    = 32;
+    size_t symlinksPerFolder = 2;  //alternating: relative link to a file of the same folder / dangling link
+    size_t unreadableFolders = 0;  //randomly chosen sub folders with all permissions removed (no effect when running as root!)
+    std::uint64_t minFileSize = 0;       //file sizes are log-uniformly distributed: many small, few large files
+    std::uint64_t maxFileSize = 1 << 20; //files are sparse: sizes model the attributes only, creating the tree costs no disk space
+    std::uint32_t seed = 1;              //same seed => same tree
+};
+
+struct TreeStats
+{
+    size_t folders  = 0; //excluding base folder
+    size_t files    = 0;
+    size_t symlinks = 0;
+    size_t unreadableFolders = 0;
+    std::uint64_t bytes = 0;
+};
+
+//create a new folder inside "parentFolderPath" and fill it according to the configuration
+TreeStats generateTree(const TreeConfig& cfg, const Zstring& parentFolderPath, Zstring& baseFolderPath); //throw FileError; baseFolderPath is set before anything is created
+
+//restore permissions of unreadable folders, then delete recursively
+void removeTree(const Zstring& baseFolderPath); //throw FileError
+}
+
+#endif //TREE_GENERATOR_H_8340572304857203485
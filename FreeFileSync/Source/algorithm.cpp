@@ -239,6 +239,9 @@ bool stillInSync(const InSyncFile& dbFile, CompareVariant compareVar, int fileTi
             return dbFile.cmpVar == CompareVariant::CONTENT;
         //in contrast to comparison, we don't care about modification time here!
 
+        case CompareVariant::CONTENT_SAMPLED: //full comparison is "good enough"
+            return dbFile.cmpVar == CompareVariant::CONTENT || dbFile.cmpVar == CompareVariant::CONTENT_SAMPLED;
+
         case CompareVariant::SIZE: //file size/case-sensitive short name always matches on both sides for an "in-sync" database entry
             return true;
     }
@@ -280,16 +283,17 @@ bool stillInSync(const InSyncSymlink& dbLink, CompareVariant compareVar, int fil
     switch (compareVar)
     {
         case CompareVariant::TIME_SIZE:
-            if (dbLink.cmpVar == CompareVariant::CONTENT || dbLink.cmpVar == CompareVariant::SIZE)
+            if (dbLink.cmpVar == CompareVariant::CONTENT || dbLink.cmpVar == CompareVariant::CONTENT_SAMPLED || dbLink.cmpVar == CompareVariant::SIZE)
                 return true; //special rule: this is already "good enough" for CompareVariant::TIME_SIZE!
 
             //case-sensitive short name match is a database invariant!
             return sameFileTime(dbLink.left.lastWriteTimeRaw, dbLink.right.lastWriteTimeRaw, fileTimeTolerance, ignoreTimeShiftMinutes);
 
         case CompareVariant::CONTENT:
+        case CompareVariant::CONTENT_SAMPLED:
         case CompareVariant::SIZE: //== categorized by content! see comparison.cpp, ComparisonBuffer::compareBySize()
             //case-sensitive short name match is a database invariant!
-            return dbLink.cmpVar == CompareVariant::CONTENT || dbLink.cmpVar == CompareVariant::SIZE;
+            return dbLink.cmpVar == CompareVariant::CONTENT || dbLink.cmpVar == CompareVariant::CONTENT_SAMPLED || dbLink.cmpVar == CompareVariant::SIZE;
     }
     assert(false);
     return false;
@@ -637,6 +637,17 @@ void runBatchMode(const Zstring& globalConfigFile, const XmlBatchConfig& batchCf
                                              allowPwPrompt, //allowUserInteraction
                                              globalCfg.runWithBackgroundPriority,
                                              globalCfg.folderAccessTimeout,
+                                             globalCfg.scanThreadsPerFolder,
+                                             globalCfg.scanAllowStaleAttributes,
+                                             globalCfg.scanSnapshotMode,
+                                             globalCfg.scanDeferErrors || batchCfg.handleError == ON_ERROR_IGNORE, //nobody waits for ignored errors: don't stall scanning
+                                             globalCfg.contentCompareThreads,
+                                             globalCfg.contentHashCache,
+                                             globalCfg.trustSyncDatabase,
+                                             globalCfg.sampledCompareBlocks,
+                                             globalCfg.sampledCompareFullPercent,
+                                             globalCfg.diskOrderedAccess,
+                                             globalCfg.outOfCoreFolderPath,
                                              globalCfg.createLockFile,
                                              dirLocks,
                                              cmpConfig,
@@ -655,6 +666,7 @@ void runBatchMode(const Zstring& globalConfigFile, const XmlBatchConfig& batchCf
                     globalCfg.failSafeFileCopy,
                     globalCfg.runWithBackgroundPriority,
                     globalCfg.folderAccessTimeout,
+                    globalCfg.diskOrderedAccess,
                     syncProcessCfg,
                     cmpResult,
                     statusHandler);
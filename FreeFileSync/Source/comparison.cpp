@@ -7,10 +7,15 @@
 #include "comparison.h"
 #include <zen/process_priority.h>
 #include <zen/perf.h>
+#include <zen/format_unit.h>
 #include "algorithm.h"
 #include "lib/parallel_scan.h"
 #include "lib/dir_exist_async.h"
+#include "lib/parallel_compare.h"
+#include "lib/content_hash_cache.h"
+#include "lib/db_file.h"
 #include "lib/binary.h"
+#include "lib/disk_order.h"
 #include "lib/cmp_filetime.h"
 #include "lib/status_handler_impl.h"
 #include "fs/concrete.h"
@@ -160,38 +165,107 @@ void checkFolderDependency(const std::vector<ResolvedFolderPair>& folderPairs, b
 
 //#############################################################################################################################
 
+void categorizeSymlinkByContent(SymlinkPair& symlink, ProcessCallback& callback);
+
+
+//helper threads shared by all MergeSides::execute() running at the same time, e.g. folder pairs merged while scanning continues:
+//=> at most "cores - 1" helper threads in total, in addition to the threads calling execute()
+class MergeThreadBudget
+{
+public:
+    MergeThreadBudget() : helpersFree_(std::max<size_t>(std::thread::hardware_concurrency(), 1) - 1) {}
+
+    size_t acquire(size_t helpersMax) //returns number of helper threads granted: possibly 0
+    {
+        size_t helpersGranted = 0;
+        helpersFree_.access([&](size_t& helpersFree)
+        {
+            helpersGranted = std::min(helpersMax, helpersFree);
+            helpersFree -= helpersGranted;
+        });
+        return helpersGranted;
+    }
+
+    void release(size_t helperCount) { helpersFree_.access([&](size_t& helpersFree) { helpersFree += helperCount; }); }
+
+private:
+    MergeThreadBudget           (const MergeThreadBudget&) = delete;
+    MergeThreadBudget& operator=(const MergeThreadBudget&) = delete;
+
+    Protected<size_t> helpersFree_;
+};
+
+
 class ComparisonBuffer
 {
 public:
-    ComparisonBuffer(const std::set<DirectoryKey>& keysToRead, int fileTimeTolerance, ProcessCallback& callback);
+    //folder pairs compared by time and size are already compared while scanning continues for other folders
+    ComparisonBuffer(const std::set<DirectoryKey>& keysToRead, const std::vector<std::pair<ResolvedFolderPair, FolderPairCfg>>& workLoad,
+                     int fileTimeTolerance, size_t scanThreadsPerFolder, bool allowStaleAttributes, ScanSnapshotMode scanSnapshotMode, bool deferScanErrors,
+                     const Zstring& outOfCoreFolderPath, ProcessCallback& callback);
+
+    //fully categorized result for CompareVariant::TIME_SIZE and SIZE; nullptr otherwise
+    std::shared_ptr<BaseFolderPair> getScanTimeResult(size_t workLoadIdx) const { return scanTimeResults_[workLoadIdx]; }
 
-    //create comparison result table and fill category except for files existing on both sides: undefinedFiles and undefinedSymlinks are appended!
-    std::shared_ptr<BaseFolderPair> compareByTimeSize(const ResolvedFolderPair& fp, const FolderPairCfg& fpConfig) const;
-    std::shared_ptr<BaseFolderPair> compareBySize    (const ResolvedFolderPair& fp, const FolderPairCfg& fpConfig) const;
-    std::list<std::shared_ptr<BaseFolderPair>> compareByContent(const std::vector<std::pair<ResolvedFolderPair, FolderPairCfg>>& workLoad) const;
+    std::list<std::shared_ptr<BaseFolderPair>> compareByContent(const std::vector<std::pair<ResolvedFolderPair, FolderPairCfg>>& workLoad, size_t threadsPerDevicePair, bool useHashCache, bool trustSyncDatabase,
+                                                                size_t sampleBlocks, size_t sampleFullPercent, bool diskOrderedAccess) const;
 
 private:
     ComparisonBuffer           (const ComparisonBuffer&) = delete;
     ComparisonBuffer& operator=(const ComparisonBuffer&) = delete;
 
-    std::shared_ptr<BaseFolderPair> performComparison(const ResolvedFolderPair& fp,
+    struct PreparedComparison
+    {
+        std::shared_ptr<BaseFolderPair> output;
+        const DirectoryValue* bufValueLeft  = nullptr; //nullptr if base folder is not existing
+        const DirectoryValue* bufValueRight = nullptr; //
+        std::map<Zstring, std::wstring, LessFilePath> failedReads; //base-relative paths or empty if read-error for whole base directory
+    };
+    PreparedComparison prepareComparison(const ResolvedFolderPair& fp, const FolderPairCfg& fpCfg, bool reportStatus) const; //context of main thread
+
+    //fill comparison result table and category except for files existing on both sides: undefinedFiles and undefinedSymlinks are appended!
+    void mergeFolders(const PreparedComparison& input, const FolderPairCfg& fpCfg, //no callback: may run on a worker thread
+                      std::vector<FilePair*>& undefinedFiles,
+                      std::vector<SymlinkPair*>& undefinedSymlinks) const;
+
+    std::shared_ptr<BaseFolderPair> performComparison(const ResolvedFolderPair& fp, //prepareComparison() + mergeFolders()
                                                       const FolderPairCfg& fpCfg,
                                                       std::vector<FilePair*>& undefinedFiles,
                                                       std::vector<SymlinkPair*>& undefinedSymlinks) const;
 
+    void categorizeByTimeSize(const std::vector<FilePair*>& uncategorizedFiles, const std::vector<SymlinkPair*>& uncategorizedLinks, const FolderPairCfg& fpConfig) const;
+    void categorizeFilesBySize(const std::vector<FilePair*>& uncategorizedFiles) const; //symlinks: see categorizeSymlinkByContent()
+
+    struct ScanTimeComparison //pipeline state of a folder pair compared by time and size
+    {
+        PreparedComparison input;
+        std::vector<FilePair*>    uncategorizedFiles;
+        std::vector<SymlinkPair*> uncategorizedLinks;
+        std::exception_ptr error; //e.g. std::bad_alloc: must not escape the worker thread
+    };
+    void startScanTimeComparisons(const std::set<DirectoryKey>& keysToRead, const std::set<DirectoryKey>& keysScanned,
+                                  std::vector<ScanTimeComparison>& pipeline, FixedList<InterruptibleThread>& mergeWorker); //throw X
+
+    const std::int64_t scanStartTime_ = std::time(nullptr); //number of seconds since Jan. 1st 1970 UTC
     std::map<DirectoryKey, DirectoryValue> directoryBuffer; //contains only *existing* directories
+    const std::vector<std::pair<ResolvedFolderPair, FolderPairCfg>>& workLoad_;
+    std::vector<std::shared_ptr<BaseFolderPair>> scanTimeResults_; //one per workLoad_ item
+    mutable MergeThreadBudget mergeThreadBudget_; //shared by folder pairs being merged concurrently
     const int fileTimeTolerance_;
+    const Zstring outOfCoreFolderPath_; //empty: comparison rows are kept in RAM
     ProcessCallback& callback_;
 };
 
 
-ComparisonBuffer::ComparisonBuffer(const std::set<DirectoryKey>& keysToRead, int fileTimeTolerance, ProcessCallback& callback) :
-    fileTimeTolerance_(fileTimeTolerance), callback_(callback)
+ComparisonBuffer::ComparisonBuffer(const std::set<DirectoryKey>& keysToRead, const std::vector<std::pair<ResolvedFolderPair, FolderPairCfg>>& workLoad,
+                                   int fileTimeTolerance, size_t scanThreadsPerFolder, bool allowStaleAttributes, ScanSnapshotMode scanSnapshotMode, bool deferScanErrors,
+                                   const Zstring& outOfCoreFolderPath, ProcessCallback& callback) :
+    workLoad_(workLoad), scanTimeResults_(workLoad.size()), fileTimeTolerance_(fileTimeTolerance), outOfCoreFolderPath_(outOfCoreFolderPath), callback_(callback)
 {
     class CbImpl : public FillBufferCallback
     {
     public:
-        CbImpl(ProcessCallback& pcb) : callback_(pcb) {}
+        CbImpl(ProcessCallback& pcb, const std::function<void(const DirectoryKey& key)>& onFolderScanned) : callback_(pcb), onFolderScanned_(onFolderScanned) {}
 
         void reportStatus(const std::wstring& statusMsg, int itemsTotal) override
         {
@@ -217,15 +291,120 @@ ComparisonBuffer::ComparisonBuffer(const std::set<DirectoryKey>& keysToRead, int
             return ON_ERROR_IGNORE;
         }
 
+        void reportFolderScanned(const DirectoryKey& key) override { onFolderScanned_(key); }
+
     private:
         ProcessCallback& callback_;
+        const std::function<void(const DirectoryKey& key)> onFolderScanned_;
         int itemsReported = 0;
-    } cb(callback);
+    };
+
+    std::vector<ScanTimeComparison> pipeline(workLoad.size());
+    FixedList<InterruptibleThread> mergeWorker;
+    ZEN_ON_SCOPE_EXIT
+    (
+        for (InterruptibleThread& wt : mergeWorker)
+            wt.interrupt(); //e.g. user abort during scan: don't wait for merges still queued; no-op if worker has finished already
+        for (InterruptibleThread& wt : mergeWorker)
+            if (wt.joinable()) //= precondition of thread::join(): thread may already be joined by thread::tryJoinFor() below
+                wt.join();
+    );
+
+    std::set<DirectoryKey> keysScanned;
+
+    CbImpl cb(callback, [&](const DirectoryKey& key)
+    {
+        keysScanned.insert(key);
+        startScanTimeComparisons(keysToRead, keysScanned, pipeline, mergeWorker); //throw X
+    });
 
     fillBuffer(keysToRead, //in
                directoryBuffer, //out
                cb,
+               scanThreadsPerFolder,
+               allowStaleAttributes,
+               scanSnapshotMode,
+               deferScanErrors,
                UI_UPDATE_INTERVAL / 2); //every ~50 ms
+
+    startScanTimeComparisons(keysToRead, keysToRead, pipeline, mergeWorker); //folder pairs without any existing base folder
+
+    //wait for folder pairs still being merged: keep UI responsive
+    if (!mergeWorker.empty())
+    {
+        callback.reportStatus(_("Generating file list..."));
+        callback.forceUiRefresh();
+    }
+    for (InterruptibleThread& wt : mergeWorker)
+        while (!wt.tryJoinFor(std::chrono::milliseconds(UI_UPDATE_INTERVAL / 2)))
+            callback.requestUiRefresh(); //throw X
+
+    for (size_t i = 0; i < workLoad_.size(); ++i)
+    {
+        if (pipeline[i].error)
+            std::rethrow_exception(pipeline[i].error);
+
+        if (workLoad_[i].second.compareVar == CompareVariant::SIZE)
+            for (SymlinkPair* symlink : pipeline[i].uncategorizedLinks)
+                categorizeSymlinkByContent(*symlink, callback_); //"compare by size" has the semantics of a quick content-comparison!
+    }
+}
+
+
+//pipeline: merge and categorize a folder pair on a worker thread as soon as both sides are scanned => CPU work is hidden behind the I/O of folders still being scanned,
+//while the main thread keeps reporting status and errors; granularity is a folder pair: merging requires complete scan results for both base folders
+void ComparisonBuffer::startScanTimeComparisons(const std::set<DirectoryKey>& keysToRead, const std::set<DirectoryKey>& keysScanned,
+                                                std::vector<ScanTimeComparison>& pipeline, FixedList<InterruptibleThread>& mergeWorker) //throw X
+{
+    for (size_t i = 0; i < workLoad_.size(); ++i)
+        if (!scanTimeResults_[i])
+        {
+            const ResolvedFolderPair& fp    = workLoad_[i].first;
+            const FolderPairCfg&      fpCfg = workLoad_[i].second;
+
+            auto isScanned = [&](const AbstractPath& folderPath)
+            {
+                const DirectoryKey key(folderPath, fpCfg.filter.nameFilter, fpCfg.handleSymlinks);
+                return keysToRead.find(key) == keysToRead.end() || //base folder not existing: nothing to scan
+                       keysScanned.find(key) != keysScanned.end();
+            };
+
+            if (isScanned(fp.folderPathLeft) &&
+                isScanned(fp.folderPathRight))
+                switch (fpCfg.compareVar)
+                {
+                    case CompareVariant::TIME_SIZE:
+                    case CompareVariant::SIZE:
+                    {
+                        ScanTimeComparison& stc = pipeline[i];
+                        //directoryBuffer is modified by fillBuffer() => look up on main thread only; don't overwrite the status of folders still being scanned
+                        stc.input = prepareComparison(fp, fpCfg, false /*reportStatus*/); //throw X
+                        scanTimeResults_[i] = stc.input.output;
+
+                        mergeWorker.emplace_back([this, &stc, &fpCfg]
+                        {
+#ifdef ZEN_WIN
+                            setCurrentThreadName("Compare Folder Pair");
+#endif
+                            try
+                            {
+                                mergeFolders(stc.input, fpCfg, stc.uncategorizedFiles, stc.uncategorizedLinks);
+
+                                if (fpCfg.compareVar == CompareVariant::TIME_SIZE)
+                                    categorizeByTimeSize(stc.uncategorizedFiles, stc.uncategorizedLinks, fpCfg);
+                                else
+                                    categorizeFilesBySize(stc.uncategorizedFiles); //symlinks are resolved on main thread: may report errors
+                            }
+                            catch (...) { stc.error = std::current_exception(); }
+                        });
+                    }
+                    break;
+
+                    case CompareVariant::CONTENT:
+                    case CompareVariant::CONTENT_SAMPLED:
+                        break; //don't compete for I/O with the scan
+                }
+        }
 }
 
 
@@ -314,13 +493,8 @@ void categorizeSymlinkByTime(SymlinkPair& symlink)
 }
 
 
-std::shared_ptr<BaseFolderPair> ComparisonBuffer::compareByTimeSize(const ResolvedFolderPair& fp, const FolderPairCfg& fpConfig) const
+void ComparisonBuffer::categorizeByTimeSize(const std::vector<FilePair*>& uncategorizedFiles, const std::vector<SymlinkPair*>& uncategorizedLinks, const FolderPairCfg& fpConfig) const
 {
-    //do basis scan and retrieve files existing on both sides as "compareCandidates"
-    std::vector<FilePair*> uncategorizedFiles;
-    std::vector<SymlinkPair*> uncategorizedLinks;
-    std::shared_ptr<BaseFolderPair> output = performComparison(fp, fpConfig, uncategorizedFiles, uncategorizedLinks);
-
     //finish symlink categorization
     for (SymlinkPair* symlink : uncategorizedLinks)
         categorizeSymlinkByTime(*symlink);
@@ -364,7 +538,6 @@ std::shared_ptr<BaseFolderPair> ComparisonBuffer::compareByTimeSize(const Resolv
                 break;
         }
     }
-    return output;
 }
 
 
@@ -414,16 +587,8 @@ void categorizeSymlinkByContent(SymlinkPair& symlink, ProcessCallback& callback)
 }
 
 
-std::shared_ptr<BaseFolderPair> ComparisonBuffer::compareBySize(const ResolvedFolderPair& fp, const FolderPairCfg& fpConfig) const
+void ComparisonBuffer::categorizeFilesBySize(const std::vector<FilePair*>& uncategorizedFiles) const
 {
-    //do basis scan and retrieve files existing on both sides as "compareCandidates"
-    std::vector<FilePair*> uncategorizedFiles;
-    std::vector<SymlinkPair*> uncategorizedLinks;
-    std::shared_ptr<BaseFolderPair> output = performComparison(fp, fpConfig, uncategorizedFiles, uncategorizedLinks);
-
-    //finish symlink categorization
-    for (SymlinkPair* symlink : uncategorizedLinks)
-        categorizeSymlinkByContent(*symlink, callback_); //"compare by size" has the semantics of a quick content-comparison!
     //harmonize with algorithm.cpp, stillInSync()!
 
     //categorize files that exist on both sides
@@ -443,11 +608,109 @@ std::shared_ptr<BaseFolderPair> ComparisonBuffer::compareBySize(const ResolvedFo
         else
             file->setCategory<FILE_DIFFERENT_CONTENT>();
     }
-    return output;
 }
 
 
-std::list<std::shared_ptr<BaseFolderPair>> ComparisonBuffer::compareByContent(const std::vector<std::pair<ResolvedFolderPair, FolderPairCfg>>& workLoad) const
+void categorizeFileByContent(FilePair& file, bool haveSameContent)
+{
+    if (haveSameContent)
+    {
+        //Caveat:
+        //1. FILE_EQUAL may only be set if short names match in case: InSyncFolder's mapping tables use short name as a key! see db_file.cpp
+        //2. FILE_EQUAL is expected to mean identical file sizes! See InSyncFile
+        //3. harmonize with "bool stillInSync()" in algorithm.cpp, FilePair::setSyncedTo() in file_hierarchy.h
+        if (file.getItemName<LEFT_SIDE>() != file.getItemName<RIGHT_SIDE>())
+            file.setCategoryDiffMetadata(getDescrDiffMetaShortnameCase(file));
+#if 0 //don't synchronize modtime only see SynchronizeFolderPair::synchronizeFileInt(), SO_COPY_METADATA_TO_*
+        else if (!sameFileTime(file.getLastWriteTime<LEFT_SIDE>(),
+                               file.getLastWriteTime<RIGHT_SIDE>(), file.base().getFileTimeTolerance(), file.base().getIgnoredTimeShift()))
+            file.setCategoryDiffMetadata(getDescrDiffMetaDate(file));
+#endif
+        else
+            file.setCategory<FILE_EQUAL>();
+    }
+    else
+        file.setCategory<FILE_DIFFERENT_CONTENT>();
+}
+
+
+template <SelectedSide side> inline
+bool matchesInSyncDescr(const InSyncDescrFile& descr, const FilePair& file)
+{
+    //change time can't be set by user space: detects writes and metadata changes even if the modification time was restored
+    return !descr.fileId.empty() && descr.changeTimeRaw != 0 &&
+           descr.fileId           == file.getFileId       <side>() &&
+           descr.lastWriteTimeRaw == file.getLastWriteTime<side>() &&
+           descr.changeTimeRaw    == file.getChangeTime   <side>();
+}
+
+
+//both files are unchanged since the last synchronization found them having equal content
+bool unchangedSinceLastSync(const FilePair& file, const InSyncFolder& lastSyncState, CompareVariant activeCmpVar)
+{
+    const std::vector<Zstring> itemNames = split(file.getPairRelativePath(), FILE_NAME_SEPARATOR);
+    assert(!itemNames.empty());
+
+    const InSyncFolder* dbFolder = &lastSyncState;
+    for (auto it = itemNames.begin(); it + 1 != itemNames.end(); ++it)
+    {
+        auto itFolder = dbFolder->folders.find(*it);
+        if (itFolder == dbFolder->folders.end())
+            return false;
+        dbFolder = &itFolder->second;
+    }
+
+    auto itFile = dbFolder->files.find(itemNames.back());
+    if (itFile == dbFolder->files.end())
+        return false;
+    const InSyncFile& dbFile = itFile->second;
+
+    return (dbFile.cmpVar == CompareVariant::CONTENT || dbFile.cmpVar == activeCmpVar) && //in-sync state was found by a content comparison at least as thorough as the current one
+           dbFile.fileSize == file.getFileSize<LEFT_SIDE>() &&
+           matchesInSyncDescr< LEFT_SIDE>(dbFile.left,  file) &&
+           matchesInSyncDescr<RIGHT_SIDE>(dbFile.right, file);
+}
+
+
+template <SelectedSide side> inline
+Opt<Hash128> getCachedContentHash(const ContentHashCache& cache, const FilePair& file)
+{
+    return getCachedContentHash(cache, file.getRelativePath<side>(), file.getFileId<side>(), file.getFileSize<side>(), file.getLastWriteTime<side>());
+}
+
+
+template <SelectedSide side>
+void updateContentHashCache(ContentHashCache& cache, const FilePair& file, const Hash128& hash, std::int64_t scanStartTime)
+{
+    //the file may have been modified after scanning: the hash is only valid for the scanned attributes if any later
+    //modification changes the modification time, i.e. the file was last modified before the scan (consider FAT: 2 seconds)
+    if (file.getLastWriteTime<side>() >= scanStartTime - 2)
+        cache.erase(file.getRelativePath<side>());
+    else
+    {
+        CachedContentHash& entry = cache[file.getRelativePath<side>()];
+        entry.fileId        = file.getFileId<side>();
+        entry.fileSize      = file.getFileSize<side>();
+        entry.lastWriteTime = file.getLastWriteTime<side>();
+        entry.hash          = hash;
+    }
+}
+
+
+template <SelectedSide side, class Function>
+void visitExistingFiles(const HierarchyObject& hierObj, Function onFile)
+{
+    for (const FilePair& file : hierObj.refSubFiles())
+        if (!file.isEmpty<side>())
+            onFile(file);
+
+    for (const FolderPair& folder : hierObj.refSubFolders())
+        visitExistingFiles<side>(folder, onFile);
+}
+
+
+std::list<std::shared_ptr<BaseFolderPair>> ComparisonBuffer::compareByContent(const std::vector<std::pair<ResolvedFolderPair, FolderPairCfg>>& workLoad, size_t threadsPerDevicePair, bool useHashCache, bool trustSyncDatabase,
+                                                                              size_t sampleBlocks, size_t sampleFullPercent, bool diskOrderedAccess) const
 {
     std::list<std::shared_ptr<BaseFolderPair>> output;
     if (workLoad.empty())
@@ -455,6 +718,35 @@ std::list<std::shared_ptr<BaseFolderPair>> ComparisonBuffer::compareByContent(co
 
     //PERF_START;
     std::vector<FilePair*> filesToCompareBytewise;
+    std::vector<ContentCompareJob> jobs; //per file to compare
+
+    //limit concurrent comparisons per pair of physical devices: folder pairs on the same devices share their limits
+    std::vector<ContentCompareDevice> devices;
+    std::vector<std::pair<bool, bool>> devicesRotational; //left/right side of each device pair
+    std::map<std::pair<Zstring, Zstring>, size_t> deviceIndexes;
+
+    //optional: trust the cached hashes of unchanged files instead of reading them again; one cache per base folder
+    std::map<AbstractPath, ContentHashCache, AFS::LessAbstractPath> hashCaches;
+    std::vector<std::pair<ContentHashCache*, ContentHashCache*>> jobHashCaches; //per file to compare
+
+    size_t sameFileCount      = 0; //equal without reading: found during traversal
+    size_t sharedExtentsCount = 0; //                      : found by compareContentParallel()
+    size_t unchangedSyncCount = 0; //                      : unchanged since last sync
+
+    auto getHashCache = [&](const AbstractPath& baseFolderPath) -> ContentHashCache&
+    {
+        auto rv = hashCaches.emplace(baseFolderPath, ContentHashCache());
+        if (rv.second)
+            try
+            {
+                rv.first->second = loadContentHashCache(baseFolderPath); //throw FileError
+            }
+            catch (FileError&) {} //cache is just a cache: read all files and overwrite it
+        return rv.first->second;
+    };
+
+    //CompareVariant::CONTENT_SAMPLED: verify a subset completely; selected by relative path => same files for repeated comparisons, reproducible results
+    auto isFullCompareSample = [&](const FilePair& file) { return StringHash()(file.getPairRelativePath()) % 100 < sampleFullPercent; };
 
     //process folder pairs one after another
     for (const auto& w : workLoad)
@@ -465,6 +757,39 @@ std::list<std::shared_ptr<BaseFolderPair>> ComparisonBuffer::compareByContent(co
 
         output.push_back(performComparison(w.first, w.second, undefinedFiles, uncategorizedLinks));
 
+        const AFS::StorageDeviceInfo devInfoL = AFS::getStorageDeviceInfo(w.first.folderPathLeft ); //noexcept
+        const AFS::StorageDeviceInfo devInfoR = AFS::getStorageDeviceInfo(w.first.folderPathRight); //
+        size_t deviceIdx = devices.size();
+
+        if (!devInfoL.deviceId.empty() && !devInfoR.deviceId.empty())
+        {
+            auto rv = deviceIndexes.emplace(std::make_pair(devInfoL.deviceId, devInfoR.deviceId), deviceIdx);
+            deviceIdx = rv.first->second;
+        }
+        if (deviceIdx == devices.size()) //unknown device => one group per folder pair
+        {
+            ContentCompareDevice dev; //default: one file at a time => spinning disk: avoid seek thrashing
+            if (!devInfoL.rotational && !devInfoR.rotational) //no spinning disk: compare files in parallel
+            {
+                dev.maxJobs      = std::max<size_t>(threadsPerDevicePair, 1);
+                dev.maxLargeJobs = std::min<size_t>(dev.maxJobs, 2);
+            }
+            devices.push_back(dev);
+            devicesRotational.emplace_back(devInfoL.rotational, devInfoR.rotational);
+        }
+
+        ContentHashCache* hashCacheL = useHashCache ? &getHashCache(w.first.folderPathLeft ) : nullptr;
+        ContentHashCache* hashCacheR = useHashCache ? &getHashCache(w.first.folderPathRight) : nullptr;
+
+        //optional: trust the last synchronous state of files that are unchanged since
+        std::shared_ptr<InSyncFolder> lastSyncState;
+        if (trustSyncDatabase && w.second.directionCfg.var == DirectionConfig::TWO_WAY && !undefinedFiles.empty())
+            try
+            {
+                lastSyncState = loadLastSynchronousState(*output.back(), [&](std::int64_t bytesDelta) { callback_.requestUiRefresh(); }); //throw FileError, FileErrorDatabaseNotExisting, X
+            }
+            catch (FileError&) {} //no database or incompatible: read all files; errors are reported by redetermineSyncDirection()
+
         //content comparison of file content happens AFTER finding corresponding files and AFTER filtering
         //in order to separate into two processes (scanning and comparing)
         for (FilePair* file : undefinedFiles)
@@ -477,8 +802,43 @@ std::list<std::shared_ptr<BaseFolderPair>> ComparisonBuffer::compareByContent(co
                 //both soft and hard filter were already applied in ComparisonBuffer::performComparison()!
                 if (!file->isActive())
                     file->setCategoryConflict(getConflictSkippedBinaryComparison(*file));
+                else if (AFS::isSameFile(file->getAbstractPath<LEFT_SIDE >(), file->getFileId<LEFT_SIDE >(),
+                                         file->getAbstractPath<RIGHT_SIDE>(), file->getFileId<RIGHT_SIDE>())) //hard link, bind mount, ...: nothing to read
+                {
+                    categorizeFileByContent(*file, true);
+                    ++sameFileCount;
+                }
+                else if (lastSyncState && unchangedSinceLastSync(*file, *lastSyncState, w.second.compareVar))
+                {
+                    categorizeFileByContent(*file, true);
+                    ++unchangedSyncCount;
+                }
                 else
+                {
+                    ContentCompareJob job = { file->getAbstractPath<LEFT_SIDE>(), file->getAbstractPath<RIGHT_SIDE>(), file->getFileSize<LEFT_SIDE>(), deviceIdx };
+
+                    if (w.second.compareVar == CompareVariant::CONTENT_SAMPLED && !isFullCompareSample(*file))
+                    {
+                        job.sampleBlocks = std::max<size_t>(sampleBlocks, 1);
+                        if (useHashCache)
+                            jobHashCaches.emplace_back(hashCacheL, hashCacheR); //no hashes: files are read incompletely
+                    }
+                    else if (useHashCache)
+                    {
+                        job.computeHashes = true;
+                        job.knownHash1 = getCachedContentHash<LEFT_SIDE >(*hashCacheL, *file);
+                        job.knownHash2 = getCachedContentHash<RIGHT_SIDE>(*hashCacheR, *file);
+
+                        if (job.knownHash1 && job.knownHash2) //both files unchanged: nothing to read; cryptographic hash => equal hashes mean equal content
+                        {
+                            categorizeFileByContent(*file, *job.knownHash1 == *job.knownHash2);
+                            continue;
+                        }
+                        jobHashCaches.emplace_back(hashCacheL, hashCacheR);
+                    }
                     filesToCompareBytewise.push_back(file);
+                    jobs.push_back(job);
+                }
             }
 
         //finish symlink categorization
@@ -486,12 +846,41 @@ std::list<std::shared_ptr<BaseFolderPair>> ComparisonBuffer::compareByContent(co
             categorizeSymlinkByContent(*symlink, callback_);
     }
 
+    //spinning disks: read files in the order of their physical location
+    bool diskOrderApplied = false;
+    if (diskOrderedAccess)
+    {
+        const auto lookupStartTime = std::chrono::steady_clock::now();
+        std::vector<std::uint64_t> locations(jobs.size()); //0: not on a spinning disk
+        for (size_t i = 0; i < jobs.size(); ++i)
+        {
+            const std::pair<bool, bool>& rotational = devicesRotational[jobs[i].deviceIdx];
+            if (rotational.first || rotational.second)
+            {
+                locations[i] = AFS::getDiskLocation(rotational.first ? jobs[i].filePath1 : jobs[i].filePath2); //noexcept
+                diskOrderApplied = true;
+                callback_.requestUiRefresh(); //throw X
+            }
+        }
+        if (diskOrderApplied)
+        {
+            //per-device job queues preserve the relative order
+            const std::vector<size_t> order = getDiskOrder(locations);
+            applyDiskOrder(jobs, order);
+            applyDiskOrder(filesToCompareBytewise, order);
+            if (useHashCache)
+                applyDiskOrder(jobHashCaches, order);
+
+            callback_.reportInfo(getDiskOrderReport(locations, order, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - lookupStartTime))); //throw X
+        }
+    }
+
     //finish categorization...
-    const size_t objectsTotal = filesToCompareBytewise.size();
+    const size_t objectsTotal = jobs.size();
 
-    std::uint64_t bytesTotal = 0; //left and right filesizes are equal
-    for (FilePair* file : filesToCompareBytewise)
-        bytesTotal += file->getFileSize<LEFT_SIDE>();
+    std::uint64_t bytesTotal = 0; //left and right filesizes are equal; only one of both is read if the other's hash is known
+    for (const ContentCompareJob& job : jobs)
+        bytesTotal += job.sampleBlocks > 0 ? getSampledContentSize(job.fileSize, job.sampleBlocks) : job.fileSize;
 
     callback_.initNewPhase(static_cast<int>(objectsTotal), //may throw
                            bytesTotal,
@@ -501,50 +890,116 @@ std::list<std::shared_ptr<BaseFolderPair>> ComparisonBuffer::compareByContent(co
 
     //PERF_START;
 
-    //compare files (that have same size) bytewise...
-    for (FilePair* file : filesToCompareBytewise)
+    const auto compareStartTime = std::chrono::steady_clock::now();
+
+    //compare files (that have same size) bytewise: several files at a time, each device pair is limited separately
+    const std::vector<ContentCompareResult> results = compareContentParallel(jobs, devices, [&](size_t jobIdx)
     {
-        callback_.reportStatus(replaceCpy(txtComparingContentOfFiles, L"%x", fmtPath(file->getPairRelativePath())));
+        return replaceCpy(txtComparingContentOfFiles, L"%x", fmtPath(filesToCompareBytewise[jobIdx]->getPairRelativePath()));
+    }, callback_, UI_UPDATE_INTERVAL / 2); //throw X
 
-        //check files that exist in left and right model but have different content
+    if (diskOrderApplied) //compare against a run without disk-ordered access
+        callback_.reportInfo(replaceCpy(replaceCpy(_("Comparing content in disk order: %x in %y ms"),
+                                                   L"%x", filesizeToShortString(static_cast<std::int64_t>(bytesTotal))),
+                                        L"%y", numberTo<std::wstring>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - compareStartTime).count()))); //throw X
 
-        bool haveSameContent = false;
-        Opt<std::wstring> errMsg = tryReportingError([&]
+    for (size_t i = 0; i < filesToCompareBytewise.size(); ++i)
+    {
+        FilePair* file = filesToCompareBytewise[i];
+
+        //check files that exist in left and right model but have different content
+        if (const Opt<std::wstring>& errMsg = results[i].errorMsg)
+            file->setCategoryConflict(*errMsg);
+        else
         {
-            StatisticsReporter statReporter(1, file->getFileSize<LEFT_SIDE>(), callback_);
+            categorizeFileByContent(*file, results[i].haveSameContent);
+            if (results[i].sharedExtents)
+                ++sharedExtentsCount;
 
-            auto onUpdateStatus = [&](std::int64_t bytesDelta) { statReporter.reportDelta(0, bytesDelta); };
+            if (useHashCache)
+            {
+                if (const Opt<Hash128>& hash = results[i].hash1)
+                    updateContentHashCache<LEFT_SIDE>(*jobHashCaches[i].first, *file, *hash, scanStartTime_);
+                if (const Opt<Hash128>& hash = results[i].hash2)
+                    updateContentHashCache<RIGHT_SIDE>(*jobHashCaches[i].second, *file, *hash, scanStartTime_);
+            }
+        }
+    }
 
-            haveSameContent = filesHaveSameContent(file->getAbstractPath<LEFT_SIDE>(),
-                                                   file->getAbstractPath<RIGHT_SIDE>(), onUpdateStatus); //throw FileError
-            statReporter.reportDelta(1, 0);
+    if (sameFileCount > 0 || sharedExtentsCount > 0 || unchangedSyncCount > 0)
+    {
+        std::wstring msg = _("Equal files detected without reading their content:");
+        if (sameFileCount > 0)
+            msg += L"\n    " + _("Same file (hard link, bind mount)") + L" - " + numberTo<std::wstring>(sameFileCount);
+        if (sharedExtentsCount > 0)
+            msg += L"\n    " + _("Shared data extents (reflink, snapshot)") + L" - " + numberTo<std::wstring>(sharedExtentsCount);
+        if (unchangedSyncCount > 0)
+            msg += L"\n    " + _("Unchanged since last synchronization") + L" - " + numberTo<std::wstring>(unchangedSyncCount);
+        callback_.reportInfo(msg); //throw X
+    }
 
-            statReporter.reportFinished();
-        }, callback_); //throw X?
+    if (useHashCache)
+    {
+        //remove entries of deleted files, but keep those excluded by the filter: they may still be needed by a different configuration
+        std::set<const CachedContentHash*> existingEntries;
+        std::map<AbstractPath, std::vector<HardFilter::FilterRef>, AFS::LessAbstractPath> baseFolderFilters;
+        std::set<AbstractPath, AFS::LessAbstractPath> unavailableBaseFolders; //folder not existing at the time of comparison: keep cache as is
 
-        if (errMsg)
-            file->setCategoryConflict(*errMsg);
-        else
+        auto itOut = output.begin();
+        for (const auto& w : workLoad)
         {
-            if (haveSameContent)
+            const BaseFolderPair& baseFolder = **itOut++;
+
+            auto markExisting = [&](const ContentHashCache& cache, const Zstring& relPath)
             {
-                //Caveat:
-                //1. FILE_EQUAL may only be set if short names match in case: InSyncFolder's mapping tables use short name as a key! see db_file.cpp
-                //2. FILE_EQUAL is expected to mean identical file sizes! See InSyncFile
-                //3. harmonize with "bool stillInSync()" in algorithm.cpp, FilePair::setSyncedTo() in file_hierarchy.h
-                if (file->getItemName<LEFT_SIDE>() != file->getItemName<RIGHT_SIDE>())
-                    file->setCategoryDiffMetadata(getDescrDiffMetaShortnameCase(*file));
-#if 0 //don't synchronize modtime only see SynchronizeFolderPair::synchronizeFileInt(), SO_COPY_METADATA_TO_*
-                else if (!sameFileTime(file->getLastWriteTime<LEFT_SIDE>(),
-                                       file->getLastWriteTime<RIGHT_SIDE>(), file->base().getFileTimeTolerance(), file->base().getIgnoredTimeShift()))
-                    file->setCategoryDiffMetadata(getDescrDiffMetaDate(*file));
-#endif
-                else
-                    file->setCategory<FILE_EQUAL>();
-            }
-            else
-                file->setCategory<FILE_DIFFERENT_CONTENT>();
+                auto it = cache.find(relPath);
+                if (it != cache.end())
+                    existingEntries.insert(&it->second);
+            };
+            const ContentHashCache& hashCacheL = hashCaches.find(w.first.folderPathLeft )->second;
+            const ContentHashCache& hashCacheR = hashCaches.find(w.first.folderPathRight)->second;
+            visitExistingFiles<LEFT_SIDE >(baseFolder, [&](const FilePair& file) { markExisting(hashCacheL, file.getRelativePath<LEFT_SIDE >()); });
+            visitExistingFiles<RIGHT_SIDE>(baseFolder, [&](const FilePair& file) { markExisting(hashCacheR, file.getRelativePath<RIGHT_SIDE>()); });
+
+            //files at or below items that failed to read are missing from the comparison result: keep their entries, too
+            auto addPruneFilter = [&](const AbstractPath& folderPath)
+            {
+                Zstring excludefilterFailedRead;
+                auto itDir = directoryBuffer.find(DirectoryKey(folderPath, w.second.filter.nameFilter, w.second.handleSymlinks));
+                if (itDir != directoryBuffer.end())
+                    for (const std::map<Zstring, std::wstring, LessFilePath>* failedReads : { &itDir->second.failedFolderReads, &itDir->second.failedItemReads })
+                        for (const auto& item : *failedReads)
+                            if (item.first.empty()) //read-error for whole base directory
+                                unavailableBaseFolders.insert(folderPath);
+                            else
+                                excludefilterFailedRead += item.first + Zstr("\n"); //exclude item AND (potential) child items!
+
+                baseFolderFilters[folderPath].push_back(w.second.filter.nameFilter->copyFilterAddingExclusion(excludefilterFailedRead));
+            };
+            addPruneFilter(w.first.folderPathLeft);
+            addPruneFilter(w.first.folderPathRight);
+
+            if (!baseFolder.isExisting<LEFT_SIDE>())
+                unavailableBaseFolders.insert(w.first.folderPathLeft);
+            if (!baseFolder.isExisting<RIGHT_SIDE>())
+                unavailableBaseFolders.insert(w.first.folderPathRight);
         }
+
+        for (auto& item : hashCaches)
+            if (unavailableBaseFolders.find(item.first) == unavailableBaseFolders.end())
+            {
+                ContentHashCache& cache = item.second;
+                const std::vector<HardFilter::FilterRef>& filters = baseFolderFilters[item.first];
+
+                for (auto it = cache.begin(); it != cache.end();)
+                    if (existingEntries.find(&it->second) == existingEntries.end() &&
+                        std::any_of(filters.begin(), filters.end(), [&](const HardFilter::FilterRef& filter) { return filter->passFileFilter(it->first); }))
+                        it = cache.erase(it);
+                    else
+                        ++it;
+
+                tryReportingError([&] { saveContentHashCache(item.first, cache); }, callback_); //throw FileError, X
+            }
     }
     return output;
 }
@@ -561,16 +1016,20 @@ public:
         undefinedFiles(undefinedFilesOut),
         undefinedSymlinks(undefinedSymlinksOut) {}
 
-    void execute(const FolderContainer& lhs, const FolderContainer& rhs, HierarchyObject& output)
+    void execute(const FolderContainer& lhs, const FolderContainer& rhs, HierarchyObject& output, MergeThreadBudget& threadBudget);
+
+private:
+    struct Subtree
     {
-        auto it = failedItemReads_.find(Zstring()); //empty path if read-error for whole base directory
+        const FolderContainer* lhs; //nullptr if folder exists on right side only
+        const FolderContainer* rhs; //nullptr if folder exists on left side only
+        const std::wstring* errorMsg;
+        HierarchyObject* output;
+    };
 
-        mergeTwoSides(lhs, rhs,
-                      it != failedItemReads_.end() ? &it->second : nullptr,
-                      output);
-    }
+    void mergeSubtree(const Subtree& subtree);
+    void recurse(const FolderContainer* lhs, const FolderContainer* rhs, const std::wstring* errorMsg, HierarchyObject& output);
 
-private:
     void mergeTwoSides(const FolderContainer& lhs, const FolderContainer& rhs, const std::wstring* errorMsg, HierarchyObject& output);
 
     template <SelectedSide side>
@@ -581,9 +1040,146 @@ private:
     const std::map<Zstring, std::wstring, LessFilePath>& failedItemReads_; //base-relative paths or empty if read-error for whole base directory
     std::vector<FilePair*>& undefinedFiles;
     std::vector<SymlinkPair*>& undefinedSymlinks;
+    std::vector<Subtree>* deferredSubtrees_ = nullptr; //!= nullptr: don't recurse into sub folders, but collect them for merging in parallel
 };
 
 
+size_t countItems(const FolderContainer& folderCont, size_t maxCount) //cost: one step per folder; stop as soon as "maxCount" is reached
+{
+    size_t itemCount = folderCont.files.size() + folderCont.symlinks.size() + folderCont.folders.size();
+    for (const auto& dir : folderCont.folders)
+    {
+        if (itemCount >= maxCount)
+            break;
+        itemCount += countItems(dir.second, maxCount - itemCount);
+    }
+    return itemCount;
+}
+
+
+void MergeSides::execute(const FolderContainer& lhs, const FolderContainer& rhs, HierarchyObject& output, MergeThreadBudget& threadBudget)
+{
+    auto it = failedItemReads_.find(Zstring()); //empty path if read-error for whole base directory
+    const std::wstring* errorMsg = it != failedItemReads_.end() ? &it->second : nullptr;
+
+    const size_t PARALLEL_MERGE_MIN_ITEMS = 100000;    //not worth the threads below
+    const size_t PARALLEL_MERGE_SUBTREES_PER_THREAD = 8; //subtree sizes vary a lot: balance load by handing out many small subtrees
+    const size_t PARALLEL_MERGE_MAX_SPLIT_LEVELS = 8;
+
+    if (std::thread::hardware_concurrency() <= 1)
+        return mergeTwoSides(lhs, rhs, errorMsg, output);
+    {
+        const size_t itemCountLeft = countItems(lhs, PARALLEL_MERGE_MIN_ITEMS);
+        if (itemCountLeft < PARALLEL_MERGE_MIN_ITEMS &&
+            itemCountLeft + countItems(rhs, PARALLEL_MERGE_MIN_ITEMS - itemCountLeft) < PARALLEL_MERGE_MIN_ITEMS)
+            return mergeTwoSides(lhs, rhs, errorMsg, output);
+    }
+
+    const size_t helperCount = threadBudget.acquire(std::thread::hardware_concurrency() - 1);
+    ZEN_ON_SCOPE_EXIT(threadBudget.release(helperCount));
+
+    if (helperCount == 0) //all cores are busy merging other folder pairs
+        return mergeTwoSides(lhs, rhs, errorMsg, output);
+
+    const size_t threadCount = helperCount + 1;
+
+    //merge the top levels on the main thread until there are enough subtrees to keep all threads busy:
+    std::vector<Subtree> subtrees{ { &lhs, &rhs, errorMsg, &output } };
+
+    for (size_t level = 0; level < PARALLEL_MERGE_MAX_SPLIT_LEVELS && subtrees.size() < threadCount * PARALLEL_MERGE_SUBTREES_PER_THREAD; ++level)
+    {
+        std::vector<Subtree> subtreesNext;
+        deferredSubtrees_ = &subtreesNext;
+        ZEN_ON_SCOPE_EXIT(deferredSubtrees_ = nullptr);
+
+        for (const Subtree& subtree : subtrees)
+            mergeSubtree(subtree);
+
+        subtrees.swap(subtreesNext);
+    }
+
+    //subtrees are disjoint: FileSystemObject construction is thread-safe, see ObjectHandleAllocator and FolderPair::notifySyncCfgChanged()
+    std::vector<std::vector<FilePair*>>    undefinedFilesBySubtree   (subtrees.size());
+    std::vector<std::vector<SymlinkPair*>> undefinedSymlinksBySubtree(subtrees.size());
+    std::atomic<size_t> nextSubtree{ 0 };
+    Protected<std::exception_ptr> firstError; //e.g. std::bad_alloc: must not escape a worker thread => rethrow on main thread
+
+    auto mergeSubtrees = [&]
+    {
+        try
+        {
+            for (size_t i = nextSubtree++; i < subtrees.size(); i = nextSubtree++)
+                MergeSides(failedItemReads_, undefinedFilesBySubtree[i], undefinedSymlinksBySubtree[i]).mergeSubtree(subtrees[i]);
+        }
+        catch (...)
+        {
+            nextSubtree = subtrees.size(); //stop handing out subtrees
+            firstError.access([](std::exception_ptr& ep) { if (!ep) ep = std::current_exception(); });
+        }
+    };
+    {
+        FixedList<InterruptibleThread> worker;
+        ZEN_ON_SCOPE_EXIT
+        (
+            for (InterruptibleThread& wt : worker)
+                if (wt.joinable())
+                    wt.join();
+        );
+
+        for (size_t i = 1; i < std::min(threadCount, subtrees.size()); ++i)
+            worker.emplace_back([&mergeSubtrees]
+            {
+#ifdef ZEN_WIN
+                setCurrentThreadName("Merge Sides");
+#endif
+                mergeSubtrees();
+            });
+
+        mergeSubtrees(); //throw ThreadInterruption is caught as "firstError", too
+
+        bool failed = false;
+        firstError.access([&](const std::exception_ptr& ep) { failed = static_cast<bool>(ep); });
+        if (failed)
+            for (InterruptibleThread& wt : worker)
+                wt.interrupt(); //don't finish the subtrees already handed out
+    }
+
+    std::exception_ptr error;
+    firstError.access([&](std::exception_ptr& ep) { error = ep; });
+    if (error)
+        std::rethrow_exception(error);
+
+    //keep result order independent from thread scheduling
+    for (size_t i = 0; i < subtrees.size(); ++i)
+    {
+        append(undefinedFiles,    undefinedFilesBySubtree   [i]);
+        append(undefinedSymlinks, undefinedSymlinksBySubtree[i]);
+    }
+}
+
+
+inline
+void MergeSides::mergeSubtree(const Subtree& subtree)
+{
+    if (subtree.lhs && subtree.rhs)
+        mergeTwoSides(*subtree.lhs, *subtree.rhs, subtree.errorMsg, *subtree.output);
+    else if (subtree.lhs)
+        fillOneSide<LEFT_SIDE>(*subtree.lhs, subtree.errorMsg, *subtree.output);
+    else
+        fillOneSide<RIGHT_SIDE>(*subtree.rhs, subtree.errorMsg, *subtree.output);
+}
+
+
+inline
+void MergeSides::recurse(const FolderContainer* lhs, const FolderContainer* rhs, const std::wstring* errorMsg, HierarchyObject& output)
+{
+    if (deferredSubtrees_)
+        deferredSubtrees_->push_back({ lhs, rhs, errorMsg, &output });
+    else
+        mergeSubtree({ lhs, rhs, errorMsg, &output });
+}
+
+
 inline
 const std::wstring* MergeSides::checkFailedRead(FileSystemObject& fsObj, const std::wstring* errorMsg)
 {
@@ -606,6 +1202,8 @@ const std::wstring* MergeSides::checkFailedRead(FileSystemObject& fsObj, const s
 template <SelectedSide side>
 void MergeSides::fillOneSide(const FolderContainer& folderCont, const std::wstring* errorMsg, HierarchyObject& output)
 {
+    interruptionPoint(); //throw ThreadInterruption; once per folder: no-op on main thread
+
     for (const auto& file : folderCont.files)
     {
         FilePair& newItem = output.addSubFile<side>(file.first, file.second);
@@ -622,7 +1220,8 @@ void MergeSides::fillOneSide(const FolderContainer& folderCont, const std::wstri
     {
         FolderPair& newFolder = output.addSubFolder<side>(dir.first);
         const std::wstring* errorMsgNew = checkFailedRead(newFolder, errorMsg);
-        fillOneSide<side>(dir.second, errorMsgNew, newFolder); //recurse
+        recurse(side == LEFT_SIDE ? &dir.second : nullptr,
+                side == LEFT_SIDE ? nullptr : &dir.second, errorMsgNew, newFolder);
     }
 }
 
@@ -670,6 +1269,15 @@ void linearMerge(const MapType& mapLeft, const MapType& mapRight, ProcessLeftOnl
 
 void MergeSides::mergeTwoSides(const FolderContainer& lhs, const FolderContainer& rhs, const std::wstring* errorMsg, HierarchyObject& output)
 {
+    interruptionPoint(); //throw ThreadInterruption; once per folder: no-op on main thread
+
+    //items usually have the same name on both sides: convert the scanned name only once => FileSystemObject shares a single name table entry
+    auto getItemNames = [](const ItemName& nameLeft, const ItemName& nameRight)
+    {
+        const Zstring itemNameLeft = nameLeft;
+        return std::make_pair(itemNameLeft, nameRight == nameLeft ? itemNameLeft : static_cast<Zstring>(nameRight));
+    };
+
     using FileData = const FolderContainer::FileList::value_type;
 
     linearMerge(lhs.files, rhs.files,
@@ -678,14 +1286,15 @@ void MergeSides::mergeTwoSides(const FolderContainer& lhs, const FolderContainer
 
     [&](const FileData& fileLeft, const FileData& fileRight) //both sides
     {
-        FilePair& newItem = output.addSubFile(fileLeft.first,
+        const auto itemNames = getItemNames(fileLeft.first, fileRight.first);
+        FilePair& newItem = output.addSubFile(itemNames.first,
                                               fileLeft.second,
                                               FILE_EQUAL, //dummy-value until categorization is finished later
-                                              fileRight.first,
+                                              itemNames.second,
                                               fileRight.second);
         if (!checkFailedRead(newItem, errorMsg))
             undefinedFiles.push_back(&newItem);
-        static_assert(IsSameType<HierarchyObject::FileList, FixedList<FilePair>>::value, ""); //HierarchyObject::addSubFile() must NOT invalidate references used in "undefinedFiles"!
+        static_assert(IsSameType<HierarchyObject::FileList, FixedList<FilePair, ObjectPoolAlloc>>::value, ""); //HierarchyObject::addSubFile() must NOT invalidate references used in "undefinedFiles"!
     });
 
     //-----------------------------------------------------------------------------------------------
@@ -697,10 +1306,11 @@ void MergeSides::mergeTwoSides(const FolderContainer& lhs, const FolderContainer
 
     [&](const SymlinkData& symlinkLeft, const SymlinkData& symlinkRight) //both sides
     {
-        SymlinkPair& newItem = output.addSubLink(symlinkLeft.first,
+        const auto itemNames = getItemNames(symlinkLeft.first, symlinkRight.first);
+        SymlinkPair& newItem = output.addSubLink(itemNames.first,
                                                  symlinkLeft.second,
                                                  SYMLINK_EQUAL, //dummy-value until categorization is finished later
-                                                 symlinkRight.first,
+                                                 itemNames.second,
                                                  symlinkRight.second);
         if (!checkFailedRead(newItem, errorMsg))
             undefinedSymlinks.push_back(&newItem);
@@ -714,25 +1324,26 @@ void MergeSides::mergeTwoSides(const FolderContainer& lhs, const FolderContainer
     {
         FolderPair& newFolder = output.addSubFolder<LEFT_SIDE>(dirLeft.first);
         const std::wstring* errorMsgNew = checkFailedRead(newFolder, errorMsg);
-        this->fillOneSide<LEFT_SIDE>(dirLeft.second, errorMsgNew, newFolder); //recurse
+        recurse(&dirLeft.second, nullptr, errorMsgNew, newFolder);
     },
     [&](const FolderData& dirRight) //right only
     {
         FolderPair& newFolder = output.addSubFolder<RIGHT_SIDE>(dirRight.first);
         const std::wstring* errorMsgNew = checkFailedRead(newFolder, errorMsg);
-        this->fillOneSide<RIGHT_SIDE>(dirRight.second, errorMsgNew, newFolder); //recurse
+        recurse(nullptr, &dirRight.second, errorMsgNew, newFolder);
     },
 
     [&](const FolderData& dirLeft, const FolderData& dirRight) //both sides
     {
-        FolderPair& newFolder = output.addSubFolder(dirLeft.first, dirRight.first, DIR_EQUAL);
+        const auto itemNames = getItemNames(dirLeft.first, dirRight.first);
+        FolderPair& newFolder = output.addSubFolder(itemNames.first, itemNames.second, DIR_EQUAL);
         const std::wstring* errorMsgNew = checkFailedRead(newFolder, errorMsg);
 
         if (!errorMsgNew)
             if (dirLeft.first != dirRight.first)
                 newFolder.setCategoryDiffMetadata(getDescrDiffMetaShortnameCase(newFolder));
 
-        mergeTwoSides(dirLeft.second, dirRight.second, errorMsgNew, newFolder); //recurse
+        recurse(&dirLeft.second, &dirRight.second, errorMsgNew, newFolder);
     });
 }
 
@@ -747,7 +1358,7 @@ void stripExcludedDirectories(HierarchyObject& hierObj, const HardFilter& filter
     //remove superfluous directories:
     //   this does not invalidate "std::vector<FilePair*>& undefinedFiles", since we delete folders only
     //   and there is no side-effect for memory positions of FilePair and SymlinkPair thanks to zen::FixedList!
-    static_assert(IsSameType<FixedList<FolderPair>, HierarchyObject::FolderList>::value, "");
+    static_assert(IsSameType<FixedList<FolderPair, ObjectPoolAlloc>, HierarchyObject::FolderList>::value, "");
 
     hierObj.refSubFolders().remove_if([&](FolderPair& folder)
     {
@@ -764,14 +1375,13 @@ void stripExcludedDirectories(HierarchyObject& hierObj, const HardFilter& filter
 }
 
 
-//create comparison result table and fill category except for files existing on both sides: undefinedFiles and undefinedSymlinks are appended!
-std::shared_ptr<BaseFolderPair> ComparisonBuffer::performComparison(const ResolvedFolderPair& fp,
-                                                                    const FolderPairCfg& fpCfg,
-                                                                    std::vector<FilePair*>& undefinedFiles,
-                                                                    std::vector<SymlinkPair*>& undefinedSymlinks) const
+ComparisonBuffer::PreparedComparison ComparisonBuffer::prepareComparison(const ResolvedFolderPair& fp, const FolderPairCfg& fpCfg, bool reportStatus) const
 {
-    callback_.reportStatus(_("Generating file list..."));
-    callback_.forceUiRefresh();
+    if (reportStatus)
+    {
+        callback_.reportStatus(_("Generating file list..."));
+        callback_.forceUiRefresh();
+    }
 
     auto getDirValue = [&](const AbstractPath& folderPath) -> const DirectoryValue*
     {
@@ -779,10 +1389,11 @@ std::shared_ptr<BaseFolderPair> ComparisonBuffer::performComparison(const Resolv
         return it != directoryBuffer.end() ? &it->second : nullptr;
     };
 
-    const DirectoryValue* bufValueLeft  = getDirValue(fp.folderPathLeft);
-    const DirectoryValue* bufValueRight = getDirValue(fp.folderPathRight);
+    PreparedComparison prep;
+    const DirectoryValue* bufValueLeft  = prep.bufValueLeft  = getDirValue(fp.folderPathLeft);
+    const DirectoryValue* bufValueRight = prep.bufValueRight = getDirValue(fp.folderPathRight);
 
-    std::map<Zstring, std::wstring, LessFilePath> failedReads; //base-relative paths or empty if read-error for whole base directory
+    std::map<Zstring, std::wstring, LessFilePath>& failedReads = prep.failedReads;
     {
         //mix failedFolderReads with failedItemReads:
         //mark directory errors already at directory-level (instead for child items only) to show on GUI! See "MergeSides"
@@ -801,19 +1412,40 @@ std::shared_ptr<BaseFolderPair> ComparisonBuffer::performComparison(const Resolv
         for (const auto& item : failedReads)
             excludefilterFailedRead += item.first + Zstr("\n"); //exclude item AND (potential) child items!
 
-    std::shared_ptr<BaseFolderPair> output = std::make_shared<BaseFolderPair>(fp.folderPathLeft,
-                                                                              bufValueLeft != nullptr, //dir existence must be checked only once: available iff buffer entry exists!
-                                                                              fp.folderPathRight,
-                                                                              bufValueRight != nullptr,
-                                                                              fpCfg.filter.nameFilter->copyFilterAddingExclusion(excludefilterFailedRead),
-                                                                              fpCfg.compareVar,
-                                                                              fileTimeTolerance_,
-                                                                              fpCfg.ignoreTimeShiftMinutes);
+    std::unique_ptr<TempFileMapping> rowStorage;
+    if (!outOfCoreFolderPath_.empty())
+        try
+        {
+            rowStorage = std::make_unique<TempFileMapping>(outOfCoreFolderPath_); //throw FileError
+        }
+        catch (const FileError& e) //not an error in this context: keep the rows in RAM
+        {
+            callback_.reportInfo(e.toString()); //may throw!
+        }
+
+    prep.output = std::make_shared<BaseFolderPair>(fp.folderPathLeft,
+                                                   bufValueLeft != nullptr, //dir existence must be checked only once: available iff buffer entry exists!
+                                                   fp.folderPathRight,
+                                                   bufValueRight != nullptr,
+                                                   fpCfg.filter.nameFilter->copyFilterAddingExclusion(excludefilterFailedRead),
+                                                   fpCfg.compareVar,
+                                                   fileTimeTolerance_,
+                                                   fpCfg.ignoreTimeShiftMinutes,
+                                                   std::move(rowStorage));
+    return prep;
+}
+
+
+void ComparisonBuffer::mergeFolders(const PreparedComparison& input, const FolderPairCfg& fpCfg,
+                                    std::vector<FilePair*>& undefinedFiles,
+                                    std::vector<SymlinkPair*>& undefinedSymlinks) const
+{
+    BaseFolderPair& output = *input.output;
 
     //PERF_START;
     FolderContainer emptyFolderCont; //WTF!!! => using a temporary in the ternary conditional would implicitly call the FolderContainer copy-constructor!!!!!!
-    MergeSides(failedReads, undefinedFiles, undefinedSymlinks).execute(bufValueLeft  ? bufValueLeft ->folderCont : emptyFolderCont,
-                                                                       bufValueRight ? bufValueRight->folderCont : emptyFolderCont, *output);
+    MergeSides(input.failedReads, undefinedFiles, undefinedSymlinks).execute(input.bufValueLeft  ? input.bufValueLeft ->folderCont : emptyFolderCont,
+                                                                             input.bufValueRight ? input.bufValueRight->folderCont : emptyFolderCont, output, mergeThreadBudget_);
     //PERF_STOP;
 
     //##################### in/exclude rows according to filtering #####################
@@ -821,13 +1453,23 @@ std::shared_ptr<BaseFolderPair> ComparisonBuffer::performComparison(const Resolv
 
     //attention: some excluded directories are still in the comparison result! (see include filter handling!)
     if (!fpCfg.filter.nameFilter->isNull())
-        stripExcludedDirectories(*output, *fpCfg.filter.nameFilter); //mark excluded directories (see fillBuffer()) + remove superfluous excluded subdirectories
+        stripExcludedDirectories(output, *fpCfg.filter.nameFilter); //mark excluded directories (see fillBuffer()) + remove superfluous excluded subdirectories
 
     //apply soft filtering (hard filter already applied during traversal!)
-    addSoftFiltering(*output, fpCfg.filter.timeSizeFilter);
-
+    addSoftFiltering(output, fpCfg.filter.timeSizeFilter);
     //##################################################################################
-    return output;
+}
+
+
+//create comparison result table and fill category except for files existing on both sides: undefinedFiles and undefinedSymlinks are appended!
+std::shared_ptr<BaseFolderPair> ComparisonBuffer::performComparison(const ResolvedFolderPair& fp,
+                                                                    const FolderPairCfg& fpCfg,
+                                                                    std::vector<FilePair*>& undefinedFiles,
+                                                                    std::vector<SymlinkPair*>& undefinedSymlinks) const
+{
+    const PreparedComparison prep = prepareComparison(fp, fpCfg, true /*reportStatus*/); //throw X
+    mergeFolders(prep, fpCfg, undefinedFiles, undefinedSymlinks);
+    return prep.output;
 }
 }
 
@@ -852,6 +1494,37 @@ void zen::logNonDefaultSettings(const xmlAccess::XmlGlobalSettings& activeSettin
     if (activeSettings.folderAccessTimeout != defaultSettings.folderAccessTimeout)
         changedSettingsMsg += L"\n    " + _("Folder access timeout") + L" - " + numberTo<std::wstring>(activeSettings.folderAccessTimeout);
 
+    if (activeSettings.scanThreadsPerFolder != defaultSettings.scanThreadsPerFolder)
+        changedSettingsMsg += L"\n    " + _("Scan threads per folder") + L" - " + numberTo<std::wstring>(activeSettings.scanThreadsPerFolder);
+
+    if (activeSettings.scanAllowStaleAttributes != defaultSettings.scanAllowStaleAttributes)
+        changedSettingsMsg += L"\n    " + _("Allow cached file attributes") + L" - " + (activeSettings.scanAllowStaleAttributes ? _("Enabled") : _("Disabled"));
+
+    if (activeSettings.scanSnapshotMode != defaultSettings.scanSnapshotMode)
+        changedSettingsMsg += L"\n    " + _("Scan snapshot") + L" - " + (activeSettings.scanSnapshotMode == SCAN_SNAPSHOT_OFF  ? _("Disabled") :
+                                                                         activeSettings.scanSnapshotMode == SCAN_SNAPSHOT_FAST ? _("Fast") : _("Strict"));
+
+    if (activeSettings.scanDeferErrors != defaultSettings.scanDeferErrors)
+        changedSettingsMsg += L"\n    " + _("Defer scan errors") + L" - " + (activeSettings.scanDeferErrors ? _("Enabled") : _("Disabled"));
+
+    if (activeSettings.contentHashCache != defaultSettings.contentHashCache)
+        changedSettingsMsg += L"\n    " + _("Content hash cache") + L" - " + (activeSettings.contentHashCache ? _("Enabled") : _("Disabled"));
+
+    if (activeSettings.trustSyncDatabase != defaultSettings.trustSyncDatabase)
+        changedSettingsMsg += L"\n    " + _("Trust sync database") + L" - " + (activeSettings.trustSyncDatabase ? _("Enabled") : _("Disabled"));
+
+    if (activeSettings.sampledCompareBlocks != defaultSettings.sampledCompareBlocks)
+        changedSettingsMsg += L"\n    " + _("Sampled content comparison: blocks") + L" - " + numberTo<std::wstring>(activeSettings.sampledCompareBlocks);
+
+    if (activeSettings.sampledCompareFullPercent != defaultSettings.sampledCompareFullPercent)
+        changedSettingsMsg += L"\n    " + _("Sampled content comparison: complete comparison") + L" - " + numberTo<std::wstring>(activeSettings.sampledCompareFullPercent) + L"%";
+
+    if (activeSettings.diskOrderedAccess != defaultSettings.diskOrderedAccess)
+        changedSettingsMsg += L"\n    " + _("Disk-ordered file access") + L" - " + (activeSettings.diskOrderedAccess ? _("Enabled") : _("Disabled"));
+
+    if (activeSettings.outOfCoreFolderPath != defaultSettings.outOfCoreFolderPath)
+        changedSettingsMsg += L"\n    " + _("Out-of-core comparison") + L" - " + fmtPath(activeSettings.outOfCoreFolderPath);
+
     if (activeSettings.runWithBackgroundPriority != defaultSettings.runWithBackgroundPriority)
         changedSettingsMsg += L"\n    " + _("Run with background priority") + L" - " + (activeSettings.runWithBackgroundPriority ? _("Enabled") : _("Disabled"));
 
@@ -871,6 +1544,17 @@ FolderComparison zen::compare(xmlAccess::OptionalDialogs& warnings,
                               bool allowUserInteraction,
                               bool runWithBackgroundPriority,
                               int folderAccessTimeout,
+                              size_t scanThreadsPerFolder,
+                              bool allowStaleAttributes,
+                              ScanSnapshotMode scanSnapshotMode,
+                              bool deferScanErrors,
+                              size_t contentCompareThreads,
+                              bool contentHashCache,
+                              bool trustSyncDatabase,
+                              size_t sampledCompareBlocks,
+                              size_t sampledCompareFullPercent,
+                              bool diskOrderedAccess,
+                              const Zstring& outOfCoreFolderPath,
                               bool createDirLocks,
                               std::unique_ptr<LockHolder>& dirLocks,
                               const std::vector<FolderPairCfg>& cfgList,
@@ -959,7 +1643,7 @@ FolderComparison zen::compare(xmlAccess::OptionalDialogs& warnings,
         {
             //------------ traverse/read folders -----------------------------------------------------
             //PERF_START;
-            ComparisonBuffer cmpBuff(dirsToRead, fileTimeTolerance, callback);
+            ComparisonBuffer cmpBuff(dirsToRead, totalWorkLoad, fileTimeTolerance, scanThreadsPerFolder, allowStaleAttributes, scanSnapshotMode, deferScanErrors, outOfCoreFolderPath, callback);
             //PERF_STOP;
 
             //process binary comparison as one junk
@@ -971,22 +1655,24 @@ FolderComparison zen::compare(xmlAccess::OptionalDialogs& warnings,
                     case CompareVariant::SIZE:
                         break;
                     case CompareVariant::CONTENT:
+                    case CompareVariant::CONTENT_SAMPLED:
                         workLoadByContent.push_back(w);
                         break;
                 }
-            std::list<std::shared_ptr<BaseFolderPair>> outputByContent = cmpBuff.compareByContent(workLoadByContent);
+            std::list<std::shared_ptr<BaseFolderPair>> outputByContent = cmpBuff.compareByContent(workLoadByContent, contentCompareThreads, contentHashCache, trustSyncDatabase,
+                                                                                                  sampledCompareBlocks, sampledCompareFullPercent, diskOrderedAccess);
 
             //write output in expected order
-            for (const auto& w : totalWorkLoad)
-                switch (w.second.compareVar)
+            for (size_t i = 0; i < totalWorkLoad.size(); ++i)
+                switch (totalWorkLoad[i].second.compareVar)
                 {
                     case CompareVariant::TIME_SIZE:
-                        output.push_back(cmpBuff.compareByTimeSize(w.first, w.second));
-                        break;
                     case CompareVariant::SIZE:
-                        output.push_back(cmpBuff.compareBySize(w.first, w.second));
+                        assert(cmpBuff.getScanTimeResult(i));
+                        output.push_back(cmpBuff.getScanTimeResult(i));
                         break;
                     case CompareVariant::CONTENT:
+                    case CompareVariant::CONTENT_SAMPLED:
                         assert(!outputByContent.empty());
                         if (!outputByContent.empty())
                         {
@@ -56,6 +56,17 @@ FolderComparison compare(xmlAccess::OptionalDialogs& warnings,
                          bool allowUserInteraction,
                          bool runWithBackgroundPriority,
                          int folderAccessTimeout,
+                         size_t scanThreadsPerFolder,
+                         bool allowStaleAttributes,
+                         ScanSnapshotMode scanSnapshotMode,
+                         bool deferScanErrors,
+                         size_t contentCompareThreads, //per pair of physical devices
+                         bool contentHashCache, //compare by content: don't read files again that are unchanged since they were last compared
+                         bool trustSyncDatabase, //compare by content, two way: don't read files that are unchanged since they were last synchronized
+                         size_t sampledCompareBlocks,      //CompareVariant::CONTENT_SAMPLED: blocks compared between head and tail
+                         size_t sampledCompareFullPercent, //CompareVariant::CONTENT_SAMPLED: share of files compared completely nevertheless
+                         bool diskOrderedAccess, //spinning disks: compare files in the order of their physical location
+                         const Zstring& outOfCoreFolderPath, //keep comparison rows and item names in a memory-mapped temporary file in this folder; empty: RAM
                          bool createDirLocks,
                          std::unique_ptr<LockHolder>& dirLocks, //out
                          const std::vector<FolderPairCfg>& cfgList,
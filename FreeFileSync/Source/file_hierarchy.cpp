@@ -5,6 +5,7 @@
 // *****************************************************************************
 
 #include "file_hierarchy.h"
+#include <unordered_map>
 #include <zen/i18n.h>
 #include <zen/utf.h>
 #include <zen/file_error.h>
@@ -12,9 +13,53 @@
 using namespace zen;
 
 
-#ifndef NDEBUG
-    const std::thread::id ObjectMgr<FileSystemObject>::mainThreadId = std::this_thread::get_id();
-#endif
+ObjectHandleTable::~ObjectHandleTable()
+{
+    for (const std::atomic<std::atomic<Slot*>*>& dirAtomic : dirs_)
+        if (const std::atomic<Slot*>* dir = dirAtomic.load())
+        {
+            for (size_t i = 0; i < DIR_SIZE; ++i)
+                delete[] dir[i].load();
+            delete[] dir;
+        }
+}
+
+
+std::uint32_t ObjectHandleTable::allocateBlock() //throw std::bad_alloc
+{
+    std::lock_guard<std::mutex> dummy(lockBlocks_);
+
+    if (!freeBlocks_.empty())
+    {
+        const std::uint32_t blockStart = freeBlocks_.back();
+        freeBlocks_.pop_back();
+        return blockStart;
+    }
+
+    if (blockCount_ >= (std::uint64_t(1) << 32) / BLOCK_SIZE)
+        throw std::bad_alloc(); //4 billion live items
+
+    const std::uint64_t blockStart = blockCount_ * BLOCK_SIZE;
+    std::atomic<std::atomic<Slot*>*>& dirAtomic = dirs_[blockStart / (BLOCK_SIZE * DIR_SIZE)];
+
+    std::atomic<Slot*>* dir = dirAtomic.load(std::memory_order_relaxed);
+    if (!dir)
+    {
+        dir = new std::atomic<Slot*>[DIR_SIZE](); //zero-initialize
+        dirAtomic.store(dir, std::memory_order_release);
+    }
+    dir[blockCount_ % DIR_SIZE].store(new Slot[BLOCK_SIZE], std::memory_order_release); //throw std::bad_alloc
+
+    ++blockCount_;
+    return static_cast<std::uint32_t>(blockStart);
+}
+
+
+void ObjectHandleTable::freeBlocks(const std::vector<std::uint32_t>& blockStarts)
+{
+    std::lock_guard<std::mutex> dummy(lockBlocks_);
+    freeBlocks_.insert(freeBlocks_.end(), blockStarts.begin(), blockStarts.end()); //slots keep their generation: existing handles remain invalid
+}
 
 
 void HierarchyObject::removeEmptyRec()
@@ -154,11 +199,70 @@ SyncOperation FileSystemObject::testSyncOperation(SyncDirection testSyncDir) con
 
 SyncOperation FileSystemObject::getSyncOperation() const
 {
-    return getIsolatedSyncOperation(!isEmpty<LEFT_SIDE>(), !isEmpty<RIGHT_SIDE>(), getCategory(), selectedForSync, getSyncDir(), syncDirectionConflict.get() != nullptr);
+    return getIsolatedSyncOperation(!isEmpty<LEFT_SIDE>(), !isEmpty<RIGHT_SIDE>(), getCategory(), isActive(), getSyncDir(), hasSyncDirConflict != 0);
     //do *not* make a virtual call to testSyncOperation()! See FilePair::testSyncOperation()! <- better not implement one in terms of the other!!!
 }
 
 
+std::wstring FileSystemObject::getCatExtraDescription() const
+{
+    assert(getCategory() == FILE_CONFLICT || getCategory() == FILE_DIFFERENT_METADATA);
+    std::wstring description;
+    if (hasCmpResultDescr)
+        base().descriptions_.access([&](const FileSystemObjectPool::DescriptionTable& table)
+        {
+            auto it = table.find(this);
+            if (it != table.end())
+                description = it->second.cmpResultDescr;
+        });
+    return description;
+}
+
+
+std::wstring FileSystemObject::getSyncOpConflict() const
+{
+    assert(getSyncOperation() == SO_UNRESOLVED_CONFLICT);
+    std::wstring description;
+    if (hasSyncDirConflict)
+        base().descriptions_.access([&](const FileSystemObjectPool::DescriptionTable& table)
+        {
+            auto it = table.find(this);
+            if (it != table.end())
+                description = it->second.syncDirectionConflict;
+        });
+    return description;
+}
+
+
+void FileSystemObject::setCmpResultDescr(const std::wstring& description)
+{
+    base().descriptions_.access([&](FileSystemObjectPool::DescriptionTable& table) { table[this].cmpResultDescr = description; });
+    hasCmpResultDescr = true;
+}
+
+
+void FileSystemObject::setSyncDirConflictDescr(const std::wstring* description)
+{
+    base().descriptions_.access([&](FileSystemObjectPool::DescriptionTable& table)
+    {
+        if (description)
+            table[this].syncDirectionConflict = *description;
+        else if (hasCmpResultDescr)
+            table[this].syncDirectionConflict.clear();
+        else
+            table.erase(this);
+    });
+    hasSyncDirConflict = description != nullptr;
+}
+
+
+void FileSystemObject::removeDescriptions() //noexcept
+{
+    base().descriptions_.access([&](FileSystemObjectPool::DescriptionTable& table) { table.erase(this); });
+    hasCmpResultDescr = hasSyncDirConflict = false;
+}
+
+
 //SyncOperation FolderPair::testSyncOperation() const -> no recursion: we do NOT want to consider child elements when testing!
 
 
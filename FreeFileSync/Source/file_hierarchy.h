@@ -8,18 +8,22 @@
 #define FILE_HIERARCHY_H_257235289645296
 
 #include <map>
+#include <unordered_map>
+#include <vector>
+#include <algorithm>
 #include <cstddef> //required by GCC 4.8.1 to find ptrdiff_t
 #include <string>
 #include <memory>
 #include <functional>
-#include <unordered_set>
+#include <atomic>
+#include <mutex>
+#include <cstdint>
 #include <zen/zstring.h>
 #include <zen/fixed_list.h>
+#include <zen/slab_allocator.h>
 #include <zen/stl_tools.h>
 #include <zen/file_id_def.h>
-#ifndef NDEBUG
-    #include <zen/thread.h>
-#endif
+#include <zen/thread.h>
 #include "structures.h"
 #include "lib/hard_filter.h"
 #include "fs/abstract.h"
@@ -35,15 +39,18 @@ struct FileDescriptor
     FileDescriptor(std::int64_t lastWriteTimeRawIn,
                    std::uint64_t fileSizeIn,
                    const AFS::FileId& idIn,
+                   std::int64_t changeTimeRawIn,
                    bool isSymlink) :
         lastWriteTimeRaw(lastWriteTimeRawIn),
         fileSize(fileSizeIn),
         fileId(idIn),
+        changeTimeRaw(changeTimeRawIn),
         isFollowedSymlink(isSymlink) {}
 
     std::int64_t lastWriteTimeRaw = 0; //number of seconds since Jan. 1st 1970 UTC, same semantics like time_t (== signed long)
     std::uint64_t fileSize = 0;
     AFS::FileId fileId {}; // optional!
+    std::int64_t changeTimeRaw = 0; //optional: 0 if unknown, see AFS::TraverserCallback::FileInfo
     bool isFollowedSymlink = false;
 };
 
@@ -92,15 +99,140 @@ struct SelectParam<RIGHT_SIDE>
 
 //------------------------------------------------------------------
 
+//item name of a scan result or FileSystemObject: null-terminated string owned by a NameArena or ItemNameTable => no heap allocation and ref-count per item
+class ItemName
+{
+public:
+    using value_type = Zchar; //model a string class for zen string_tools
+
+    ItemName() {}
+    ItemName(const Zchar* str, size_t len) : str_(str), len_(len) {}
+
+    const Zchar* c_str() const { return str_; }
+    size_t length() const { return len_; }
+    bool empty() const { return len_ == 0; }
+
+    operator Zstring() const { return Zstring(str_, len_); } //implicit conversion: FileSystemObject stores Zstring
+
+private:
+    const Zchar* str_ = Zstr("");
+    size_t len_ = 0;
+};
+
+inline bool operator==(const ItemName& lhs, const ItemName& rhs) { return lhs.length() == rhs.length() && std::equal(lhs.c_str(), lhs.c_str() + lhs.length(), rhs.c_str()); }
+inline bool operator!=(const ItemName& lhs, const ItemName& rhs) { return !(lhs == rhs); }
+
+inline bool operator==(const ItemName& lhs, const Zstring&  rhs) { return lhs == ItemName(rhs.c_str(), rhs.length()); }
+inline bool operator==(const Zstring&  lhs, const ItemName& rhs) { return rhs == lhs; }
+inline bool operator!=(const ItemName& lhs, const Zstring&  rhs) { return !(lhs == rhs); }
+inline bool operator!=(const Zstring&  lhs, const ItemName& rhs) { return !(lhs == rhs); }
+
+inline Zstring operator+(const Zstring& lhs, const ItemName& rhs) { return Zstring(lhs).append(rhs.c_str(), rhs.length()); }
+inline Zstring operator+(Zstring&&      lhs, const ItemName& rhs) { return std::move(lhs.append(rhs.c_str(), rhs.length())); }
+
+
+//bump allocator for item names: NOT thread-safe => one per traversing thread; all names are freed at once
+class NameArena
+{
+public:
+    NameArena() {}
+
+    ItemName copyName(const Zstring& name)
+    {
+        const size_t charCount = name.size() + 1; //include 0-termination
+
+        if (chunkPos_ + charCount > chunkSize_)
+        {
+            chunkSize_ = std::max(CHUNK_SIZE, charCount);
+            chunks_.emplace_back(new Zchar[chunkSize_]); //no need for zero-initialization of std::make_unique
+            chunkPos_ = 0;
+        }
+
+        Zchar* const str = chunks_.back().get() + chunkPos_;
+        std::copy(name.c_str(), name.c_str() + charCount, str);
+        chunkPos_ += charCount;
+        return ItemName(str, name.size());
+    }
+
+private:
+    NameArena           (const NameArena&) = delete;
+    NameArena& operator=(const NameArena&) = delete;
+
+    static const size_t CHUNK_SIZE = 64 * 1024; //[Zchar]
+
+    std::vector<std::unique_ptr<Zchar[]>> chunks_;
+    size_t chunkPos_  = 0;
+    size_t chunkSize_ = 0;
+};
+
+
+//flat scan result of a single folder: items are stored contiguously and sorted by finalize() after traversal
 struct FolderContainer
 {
+    template <class Data>
+    class ItemList
+    {
+    public:
+        using value_type     = std::pair<ItemName, Data>;
+        using key_compare    = LessFilePath;
+        using const_iterator = typename std::vector<value_type>::const_iterator;
+
+        const_iterator begin() const { return items_.begin(); }
+        const_iterator end  () const { return items_.end  (); }
+
+        size_t size () const { return items_.size (); }
+        bool   empty() const { return items_.empty(); }
+
+        Data& refData(size_t pos) { return items_[pos].second; } //position of insertion: stable until finalize()
+
+        const_iterator find(const Zstring& itemName) const //requires finalize()
+        {
+            auto it = std::lower_bound(items_.begin(), items_.end(), itemName, [](const value_type& item, const Zstring& name) { return LessFilePath()(item.first, name); });
+            return it != items_.end() && !LessFilePath()(itemName, it->first) ? it : items_.end();
+        }
+
+    private:
+        friend struct FolderContainer;
+
+        Data& add(const ItemName& itemName, Data&& data)
+        {
+            items_.emplace_back(itemName, std::move(data));
+            return items_.back().second;
+        }
+
+        //sort by name; duplicate entries (e.g. after folder traverser "retry") are resolved in favor of the latest one
+        void finalize()
+        {
+            const auto lessItem = [](const value_type& lhs, const value_type& rhs) { return LessFilePath()(lhs.first, rhs.first); };
+
+            if (std::adjacent_find(items_.begin(), items_.end(), [&](const value_type& lhs, const value_type& rhs) { return !lessItem(lhs, rhs); }) == items_.end())
+                return; //already sorted and unique: e.g. scan result derived from another scan result
+
+            std::stable_sort(items_.begin(), items_.end(), lessItem);
+
+            auto itOut = items_.begin();
+            for (auto it = items_.begin(); it != items_.end(); ++it)
+                if (std::next(it) == items_.end() || lessItem(*it, *std::next(it))) //keep last of equal items
+                {
+                    if (itOut != it)
+                        *itOut = std::move(*it);
+                    ++itOut;
+                }
+            items_.erase(itOut, items_.end());
+        }
+
+        std::vector<value_type> items_;
+    };
+
     //------------------------------------------------------------------
-    using FolderList  = std::map<Zstring, FolderContainer, LessFilePath>; //
-    using FileList    = std::map<Zstring, FileDescriptor,  LessFilePath>; //key: file name
-    using SymlinkList = std::map<Zstring, LinkDescriptor,  LessFilePath>; //
+    using FolderList  = ItemList<FolderContainer>; //
+    using FileList    = ItemList<FileDescriptor >; //key: file name
+    using SymlinkList = ItemList<LinkDescriptor >; //
     //------------------------------------------------------------------
 
     FolderContainer() = default;
+    FolderContainer           (FolderContainer&&) = default;
+    FolderContainer& operator=(FolderContainer&&) = default;
     FolderContainer           (const FolderContainer&) = delete; //catch accidental (and unnecessary) copying
     FolderContainer& operator=(const FolderContainer&) = delete; //
 
@@ -109,24 +241,21 @@ struct FolderContainer
     SymlinkList symlinks; //non-followed symlinks
 
     //convenience
-    FolderContainer& addSubFolder(const Zstring& itemName)
-    {
-        return folders[itemName]; //value default-construction is okay here
-        //return dirs.emplace(itemName, FolderContainer()).first->second;
-    }
+    //CAVEAT: returned reference is invalidated by the next call to addSubFolder() on the same container!
+    FolderContainer& addSubFolder(const Zstring& itemName, NameArena& arena) { return folders.add(arena.copyName(itemName), FolderContainer()); }
 
-    void addSubFile(const Zstring& itemName, const FileDescriptor& fileData)
-    {
-        auto rv = files.emplace(itemName, fileData);
-        if (!rv.second) //update entry if already existing (e.g. during folder traverser "retry") => does not handle different item name case (irrelvant!..)
-            rv.first->second = fileData;
-    }
+    void addSubFile(const Zstring& itemName, const FileDescriptor& fileData, NameArena& arena) { files.add(arena.copyName(itemName), FileDescriptor(fileData)); }
+
+    void addSubLink(const Zstring& itemName, const LinkDescriptor& linkData, NameArena& arena) { symlinks.add(arena.copyName(itemName), LinkDescriptor(linkData)); }
 
-    void addSubLink(const Zstring& itemName, const LinkDescriptor& linkData)
+    //call after traversal is complete: sort items, remove duplicates
+    void finalize()
     {
-        auto rv = symlinks.emplace(itemName, linkData);
-        if (!rv.second)
-            rv.first->second = linkData;
+        files   .finalize();
+        symlinks.finalize();
+        folders .finalize();
+        for (auto& item : folders.items_)
+            item.second.finalize();
     }
 };
 
@@ -135,13 +264,11 @@ class FolderPair;
 class FilePair;
 class SymlinkPair;
 class FileSystemObject;
+class SyncStatistics;
 
 /*------------------------------------------------------------------
     inheritance diagram:
 
-                  ObjectMgr
-                     /|\
-                      |
                FileSystemObject         HierarchyObject
                      /|\                      /|\
        _______________|_______________   ______|______
@@ -150,15 +277,257 @@ class FileSystemObject;
 
 ------------------------------------------------------------------*/
 
+//generation-counted index into the ObjectHandleTable: allow safe random access by id instead of unsafe raw pointer
+//similar semantics like std::weak_ptr without having to use std::shared_ptr
+class ObjectHandleConst
+{
+public:
+    ObjectHandleConst() {}
+    ObjectHandleConst(std::nullptr_t) {} //null handle
+    ObjectHandleConst(std::uint32_t index, std::uint32_t generation) : index_(index), generation_(generation) {}
+
+    std::uint32_t getIndex     () const { return index_; }
+    std::uint32_t getGeneration() const { return generation_; }
+
+    explicit operator bool() const { return generation_ != 0; }
+
+    inline friend bool operator==(const ObjectHandleConst& lhs, const ObjectHandleConst& rhs) { return lhs.index_ == rhs.index_ && lhs.generation_ == rhs.generation_; }
+    inline friend bool operator!=(const ObjectHandleConst& lhs, const ObjectHandleConst& rhs) { return !(lhs == rhs); }
+
+private:
+    std::uint32_t index_      = 0;
+    std::uint32_t generation_ = 0; //0: null handle
+};
+
+class ObjectHandle : public ObjectHandleConst //grants non-const access
+{
+public:
+    using ObjectHandleConst::ObjectHandleConst;
+};
+
+
+//process-wide slots for all FileSystemObjects: validating a handle is O(1) without hashing
+//slots are handed out in blocks to one BaseFolderPair at a time and returned in bulk when it is destroyed
+class ObjectHandleTable
+{
+public:
+    static ObjectHandleTable& instance() //external linkage (even in header file!)
+    {
+        static ObjectHandleTable inst;
+        return inst;
+    }
+
+    static const size_t BLOCK_SIZE = 1024; //[slots]
+
+    const void* retrieve(ObjectHandleConst handle) const //returns nullptr if object is not valid anymore
+    {
+        if (!handle)
+            return nullptr;
+        const Slot& slot = getSlot(handle.getIndex());
+        return slot.generation == handle.getGeneration() ? slot.object : nullptr;
+    }
+
+    ObjectHandleConst getHandle(std::uint32_t index) const { return ObjectHandleConst(index, getSlot(index).generation); }
+
+    void setObject(std::uint32_t index, const void* object) { getSlot(index).object = object; }
+
+    void releaseSlot(std::uint32_t index) //invalidate all existing handles; slot is reused only after its block was freed
+    {
+        Slot& slot = getSlot(index);
+        slot.object = nullptr;
+        if (++slot.generation == 0) //reserved for null handle
+            slot.generation = 1;
+    }
+
+    std::uint32_t allocateBlock(); //throw std::bad_alloc; returns index of the first slot
+    void freeBlocks(const std::vector<std::uint32_t>& blockStarts); //all slots must be released
+
+private:
+    ObjectHandleTable() {}
+    ~ObjectHandleTable();
+    ObjectHandleTable           (const ObjectHandleTable&) = delete;
+    ObjectHandleTable& operator=(const ObjectHandleTable&) = delete;
+
+    struct Slot
+    {
+        const void* object = nullptr;
+        std::uint32_t generation = 1;
+    };
+
+    static const size_t DIR_SIZE = 4096; //[blocks]: two-level lookup => slots never move, no locking for readers
+
+    Slot& getSlot(std::uint32_t index) const
+    {
+        const std::atomic<Slot*>* dir = dirs_[index / (BLOCK_SIZE * DIR_SIZE)].load(std::memory_order_acquire);
+        Slot* block = dir[index / BLOCK_SIZE % DIR_SIZE].load(std::memory_order_acquire);
+        return block[index % BLOCK_SIZE];
+    }
+
+    std::atomic<std::atomic<Slot*>*> dirs_[(std::uint64_t(1) << 32) / (BLOCK_SIZE * DIR_SIZE)] {};
+
+    std::mutex lockBlocks_;
+    std::uint64_t blockCount_ = 0;
+    std::vector<std::uint32_t> freeBlocks_; //blocks are never deallocated: handles of destroyed objects may still be validated
+};
+
+
+//handles of all FileSystemObjects of a BaseFolderPair: thread-safe, MergeSides creates objects concurrently
+class ObjectHandleAllocator
+{
+public:
+    ObjectHandleAllocator() {}
+
+    ~ObjectHandleAllocator() //bulk free: all objects are already destroyed
+    {
+        std::vector<std::uint32_t> blockStarts;
+        for (const auto& block : blocks_)
+            blockStarts.push_back(block->firstIndex);
+        ObjectHandleTable::instance().freeBlocks(blockStarts);
+    }
+
+    std::uint32_t allocate() //throw std::bad_alloc
+    {
+        for (;;)
+        {
+            Block* block = current_.load(std::memory_order_acquire);
+            if (block)
+            {
+                const size_t pos = block->used.fetch_add(1, std::memory_order_relaxed);
+                if (pos < ObjectHandleTable::BLOCK_SIZE)
+                    return block->firstIndex + static_cast<std::uint32_t>(pos);
+            }
+
+            std::lock_guard<std::mutex> dummy(lockBlocks_);
+            if (current_.load(std::memory_order_relaxed) == block) //not yet replaced by another thread
+            {
+                blocks_.push_back(std::make_unique<Block>(ObjectHandleTable::instance().allocateBlock())); //throw std::bad_alloc
+                current_.store(blocks_.back().get(), std::memory_order_release);
+            }
+        }
+    }
+
+private:
+    ObjectHandleAllocator           (const ObjectHandleAllocator&) = delete;
+    ObjectHandleAllocator& operator=(const ObjectHandleAllocator&) = delete;
+
+    struct Block
+    {
+        explicit Block(std::uint32_t first) : firstIndex(first) {}
+
+        const std::uint32_t firstIndex;
+        std::atomic<size_t> used { 0 }; //may exceed BLOCK_SIZE after failed allocations
+    };
+
+    std::mutex lockBlocks_;
+    std::vector<std::unique_ptr<Block>> blocks_;
+    std::atomic<Block*> current_ { nullptr };
+};
+
+
+//item names of all FileSystemObjects of a BaseFolderPair: rows store 4-byte ids instead of two Zstrings
+//append-only and thread-safe: MergeSides creates objects concurrently while other threads may already compare them
+//names and index are taken from the BaseFolderPair's SlabAllocator => kept in the memory-mapped file for out-of-core comparisons, too
+class ItemNameTable
+{
+public:
+    using NameId = std::uint32_t; //0: empty name = "not existing"
+
+    explicit ItemNameTable(SlabAllocator& storage) : storage_(storage) {}
+
+    NameId add(const Zstring& itemName) //throw std::bad_alloc
+    {
+        if (itemName.empty())
+            return 0;
+
+        const std::uint64_t id = nextId_.fetch_add(1, std::memory_order_relaxed);
+        if (id >= (std::uint64_t(1) << 32))
+            throw std::bad_alloc();
+
+        //length-prefixed and null-terminated: ItemName::c_str()
+        auto entry = static_cast<std::uint32_t*>(storage_.allocate(sizeof(std::uint32_t) + (itemName.size() + 1) * sizeof(Zchar), alignof(std::uint32_t))); //throw std::bad_alloc
+        *entry = static_cast<std::uint32_t>(itemName.size());
+        std::copy(itemName.c_str(), itemName.c_str() + itemName.size() + 1, reinterpret_cast<Zchar*>(entry + 1));
+
+        const size_t segIdx = getSegmentIdx(static_cast<NameId>(id));
+        getOrCreateSegment(segIdx)[id - getSegmentStart(segIdx)] = entry; //throw std::bad_alloc
+        return static_cast<NameId>(id);
+    }
+
+    ItemName getName(NameId id) const //valid until the table is destroyed
+    {
+        if (id == 0)
+            return ItemName();
+
+        const size_t segIdx = getSegmentIdx(id);
+        const std::uint32_t* entry = segments_[segIdx].load(std::memory_order_acquire)[id - getSegmentStart(segIdx)];
+        return ItemName(reinterpret_cast<const Zchar*>(entry + 1), *entry);
+    }
+
+private:
+    ItemNameTable           (const ItemNameTable&) = delete;
+    ItemNameTable& operator=(const ItemNameTable&) = delete;
+
+    //segment n holds FIRST_SEGMENT_SIZE * 2^n names => entries never move, no locking for readers, little overhead for small comparisons
+    static const size_t FIRST_SEGMENT_SIZE = 256;
+    static const size_t SEGMENT_COUNT = 25; //FIRST_SEGMENT_SIZE * (2^SEGMENT_COUNT - 1) >= 2^32
+
+    static size_t getSegmentIdx(NameId id)
+    {
+        size_t segIdx = 0;
+        for (std::uint32_t n = id / FIRST_SEGMENT_SIZE + 1; n > 1; n >>= 1)
+            ++segIdx;
+        return segIdx;
+    }
+
+    static std::uint64_t getSegmentStart(size_t segIdx) { return FIRST_SEGMENT_SIZE * ((std::uint64_t(1) << segIdx) - 1); }
+
+    const std::uint32_t** getOrCreateSegment(size_t segIdx) //throw std::bad_alloc
+    {
+        if (const std::uint32_t** seg = segments_[segIdx].load(std::memory_order_acquire))
+            return seg;
+
+        std::lock_guard<std::mutex> dummy(lockSegments_);
+        if (const std::uint32_t** seg = segments_[segIdx].load(std::memory_order_relaxed)) //created by another thread
+            return seg;
+
+        //entries are written before their id is handed out: no initialization needed
+        auto seg = static_cast<const std::uint32_t**>(storage_.allocate((FIRST_SEGMENT_SIZE << segIdx) * sizeof(const std::uint32_t*), alignof(const std::uint32_t*))); //throw std::bad_alloc
+        segments_[segIdx].store(seg, std::memory_order_release);
+        return seg;
+    }
+
+    SlabAllocator& storage_; //owns names and segments
+    std::atomic<std::uint64_t> nextId_ { 1 };
+
+    std::mutex lockSegments_;
+    std::atomic<const std::uint32_t**> segments_[SEGMENT_COUNT] {};
+};
+
+
+//node allocation for the child lists of a HierarchyObject: all FileSystemObjects of a BaseFolderPair share one pool
+class ObjectPoolAlloc
+{
+public:
+    explicit ObjectPoolAlloc(SlabAllocator& pool) : pool_(&pool) {}
+
+    void* allocate(size_t bytes, size_t alignment) { return pool_->allocate(bytes, alignment); } //throw std::bad_alloc
+    void deallocate(void* ptr, size_t bytes) { pool_->deallocate(ptr, bytes); }
+
+private:
+    SlabAllocator* pool_;
+};
+
+
 class HierarchyObject
 {
     friend class FolderPair;
     friend class FileSystemObject;
+    friend class SyncStatistics; //buffered statistics
 
 public:
-    using FileList    = FixedList<FilePair>;    //MergeSides::execute() requires a structure that doesn't invalidate pointers after push_back()
-    using SymlinkList = FixedList<SymlinkPair>; //Note: deque<> has circular dependency in VCPP!
-    using FolderList  = FixedList<FolderPair>;
+    using FileList    = FixedList<FilePair,    ObjectPoolAlloc>; //MergeSides::execute() requires a structure that doesn't invalidate pointers after push_back()
+    using SymlinkList = FixedList<SymlinkPair, ObjectPoolAlloc>; //Note: deque<> has circular dependency in VCPP!
+    using FolderList  = FixedList<FolderPair,  ObjectPoolAlloc>;
 
     FolderPair& addSubFolder(const Zstring& itemNameLeft,
                              const Zstring& itemNameRight,
@@ -203,18 +572,32 @@ public:
 
 protected:
     HierarchyObject(const Zstring& relPathPf,
-                    BaseFolderPair& baseFolder) :
+                    BaseFolderPair& baseFolder,
+                    const ObjectPoolAlloc& alloc) :
+        subFiles(alloc),
+        subLinks(alloc),
+        subFolders(alloc),
         pairRelPathPf(relPathPf),
         base_(baseFolder) {}
 
-    virtual ~HierarchyObject() {} //don't need polymorphic deletion, but we have a vtable anyway
+    virtual ~HierarchyObject() //don't need polymorphic deletion, but we have a vtable anyway
+    {
+        //destroy child items while all members are still alive: ~FileSystemObject() removes descriptions via getBase()
+        subFolders.clear();
+        subLinks  .clear();
+        subFiles  .clear();
+    }
 
     virtual void flip();
 
     void removeEmptyRec();
 
 private:
-    virtual void notifySyncCfgChanged() {}
+    virtual void notifySyncCfgChanged()
+    {
+        if (haveBufferedStats.load(std::memory_order_relaxed)) //don't write unless needed: MergeSides adds child items of the same parents from multiple threads
+            haveBufferedStats = false;
+    }
 
     HierarchyObject           (const HierarchyObject&) = delete; //this class is referenced by it's child elements => make it non-copyable/movable!
     HierarchyObject& operator=(const HierarchyObject&) = delete;
@@ -225,12 +608,54 @@ private:
 
     Zstring pairRelPathPf; //postfixed or empty
     BaseFolderPair& base_;
+
+    //SyncStatistics of all child elements (recursively): invalidated up to the base folder by notifySyncCfgChanged() => a single change doesn't require a full tree walk
+    struct SyncStatsBuffer
+    {
+        int createLeft    = 0;
+        int createRight   = 0;
+        int updateLeft    = 0;
+        int updateRight   = 0;
+        int deleteLeft    = 0;
+        int deleteRight   = 0;
+        int conflictCount = 0;
+        std::int64_t dataToProcess = 0;
+        size_t rowsTotal = 0;
+    };
+    mutable SyncStatsBuffer statsBuffered;
+    mutable std::atomic<bool> haveBufferedStats{ false }; //class invariant: "haveBufferedStats" implies the same for all child folders
 };
 
 //------------------------------------------------------------------
 
-class BaseFolderPair : public HierarchyObject //synchronization base directory
+//memory, handles and item names of all FileSystemObjects below a BaseFolderPair: 25 million rows are no exception => avoid a heap allocation per row
+//base class of BaseFolderPair: the pool must be constructed before and destroyed after the HierarchyObject using it
+class FileSystemObjectPool
+{
+protected:
+    explicit FileSystemObjectPool(std::unique_ptr<TempFileMapping> rowStorage) : objectPool_(std::move(rowStorage)), itemNames_(objectPool_) {}
+
+    SlabAllocator objectPool_; //out-of-core comparison: rows and item names are kept in a memory-mapped temporary file; handles stay in RAM
+    ObjectHandleAllocator objectHandles_;
+    ItemNameTable itemNames_;
+
+    struct ObjectDescriptions
+    {
+        std::wstring cmpResultDescr;        //FileSystemObject::hasCmpResultDescr
+        std::wstring syncDirectionConflict; //FileSystemObject::hasSyncDirConflict
+    };
+    using DescriptionTable = std::unordered_map<const FileSystemObject*, ObjectDescriptions>;
+    mutable Protected<DescriptionTable> descriptions_; //descriptions are rare: side table instead of two pointers per row; thread-safe: MergeSides categorizes items concurrently
+
+private:
+    friend class FileSystemObject; //DescriptionTable
+};
+
+
+class BaseFolderPair : private FileSystemObjectPool, public HierarchyObject //synchronization base directory
 {
+    friend class FileSystemObject; //objectHandles_, itemNames_, descriptions_
+
 public:
     BaseFolderPair(const AbstractPath& folderPathLeft,
                    bool dirExistsLeft,
@@ -239,8 +664,10 @@ public:
                    const HardFilter::FilterRef& filter,
                    CompareVariant cmpVar,
                    int fileTimeTolerance,
-                   const std::vector<unsigned int>& ignoreTimeShiftMinutes) :
-        HierarchyObject(Zstring(), *this),
+                   const std::vector<unsigned int>& ignoreTimeShiftMinutes,
+                   std::unique_ptr<TempFileMapping> rowStorage = nullptr) : //optional: rows and item names in a memory-mapped file for huge comparisons
+        FileSystemObjectPool(std::move(rowStorage)),
+        HierarchyObject(Zstring(), *this, ObjectPoolAlloc(objectPool_)),
         filter_(filter), cmpVar_(cmpVar), fileTimeTolerance_(fileTimeTolerance), ignoreTimeShiftMinutes_(ignoreTimeShiftMinutes),
         dirExistsLeft_ (dirExistsLeft),
         dirExistsRight_(dirExistsRight),
@@ -260,6 +687,8 @@ public:
     int  getFileTimeTolerance() const { return fileTimeTolerance_; }
     const std::vector<unsigned int>& getIgnoredTimeShift() const { return ignoreTimeShiftMinutes_; }
 
+    std::uint64_t getObjectPoolSize() const { return objectPool_.getBytesReserved(); } //memory report
+
     void flip() override;
 
 private:
@@ -323,73 +752,41 @@ struct FSObjectVisitor
 };
 
 
-//inherit from this class to allow safe random access by id instead of unsafe raw pointer
-//allow for similar semantics like std::weak_ptr without having to use std::shared_ptr
-template <class T>
-class ObjectMgr
+//------------------------------------------------------------------
+
+class FileSystemObject
 {
 public:
-    using ObjectId      = ObjectMgr* ;
-    using ObjectIdConst = const ObjectMgr*;
+    using ObjectId      = ObjectHandle;
+    using ObjectIdConst = ObjectHandleConst;
 
-    ObjectIdConst  getId() const { return this; }
-    /**/  ObjectId getId()       { return this; }
+    ObjectIdConst getId() const { return ObjectHandleTable::instance().getHandle(handleIdx_); }
+    ObjectId      getId()       { const ObjectIdConst id = ObjectHandleTable::instance().getHandle(handleIdx_); return ObjectId(id.getIndex(), id.getGeneration()); }
 
-    static const T* retrieve(ObjectIdConst id) //returns nullptr if object is not valid anymore
-    {
-        auto it = activeObjects().find(id);
-        return static_cast<const T*>(it == activeObjects().end() ? nullptr : *it);
-    }
-    static T* retrieve(ObjectId id) { return const_cast<T*>(retrieve(static_cast<ObjectIdConst>(id))); }
-
-protected:
-    ObjectMgr () { activeObjects().insert(this); }
-    ~ObjectMgr() { activeObjects().erase (this); }
-
-private:
-    ObjectMgr           (const ObjectMgr& rhs) = delete;
-    ObjectMgr& operator=(const ObjectMgr& rhs) = delete; //it's not well-defined what copying an objects means regarding object-identity in this context
-
-    static std::unordered_set<const ObjectMgr*>& activeObjects()
-    {
-#ifndef NDEBUG
-        assert(std::this_thread::get_id() == mainThreadId); //our global ObjectMgr is not thread-safe (and currently does not need to be!)
-#endif
-        static std::unordered_set<const ObjectMgr*> inst;
-        return inst; //external linkage (even in header file!)
-    }
-
-#ifndef NDEBUG
-    static const std::thread::id mainThreadId;
-#endif
-};
-
-//------------------------------------------------------------------
+    static const FileSystemObject* retrieve(ObjectIdConst id) { return static_cast<const FileSystemObject*>(ObjectHandleTable::instance().retrieve(id)); } //returns nullptr if object is not valid anymore
+    static       FileSystemObject* retrieve(ObjectId      id) { return const_cast<FileSystemObject*>(retrieve(static_cast<ObjectIdConst>(id))); }
 
-class FileSystemObject : public ObjectMgr<FileSystemObject>
-{
-public:
     virtual void accept(FSObjectVisitor& visitor) const = 0;
 
     Zstring getPairItemName    () const; //like getItemName() but also returns value if either side is empty
     Zstring getPairRelativePath() const; //like getRelativePath() but also returns value if either side is empty
     template <SelectedSide side>           bool isEmpty()         const;
-    template <SelectedSide side> const Zstring& getItemName()     const; //case sensitive!
+    template <SelectedSide side>      ItemName  getItemName()     const; //case sensitive! valid while the BaseFolderPair exists
     template <SelectedSide side>       Zstring  getRelativePath() const; //get path relative to base sync dir without FILE_NAME_SEPARATOR prefix
 
 public:
     template <SelectedSide side> AbstractPath getAbstractPath() const; //precondition: !isEmpty<side>()
 
     //comparison result
-    CompareFilesResult getCategory() const { return cmpResult; }
+    CompareFilesResult getCategory() const { return static_cast<CompareFilesResult>(cmpResult); }
     std::wstring getCatExtraDescription() const; //only filled if getCategory() == FILE_CONFLICT or FILE_DIFFERENT_METADATA
 
     //sync settings
-    SyncDirection getSyncDir() const { return syncDir_; }
+    SyncDirection getSyncDir() const { return static_cast<SyncDirection>(syncDir_); }
     void setSyncDir(SyncDirection newDir);
     void setSyncDirConflict(const std::wstring& description); //set syncDir = SyncDirection::NONE + fill conflict description
 
-    bool isActive() const { return selectedForSync; }
+    bool isActive() const { return selectedForSync != 0; }
     void setActive(bool active);
 
     //sync operation
@@ -416,17 +813,29 @@ protected:
                      const Zstring& itemNameRight,
                      HierarchyObject& parentObj,
                      CompareFilesResult defaultCmpResult) :
+        nameIdLeft_ (parentObj.getBase().itemNames_.add(itemNameLeft)), //throw std::bad_alloc
+        nameIdRight_(itemNameRight == itemNameLeft ? nameIdLeft_ : parentObj.getBase().itemNames_.add(itemNameRight)), //share the common case
+        parent_(parentObj),
         cmpResult(defaultCmpResult),
-        itemNameLeft_(itemNameLeft),
-        itemNameRight_(itemNameRight),
-        //itemNameRight_(itemNameRight == itemNameLeft ? itemNameLeft : itemNameRight), -> strangely doesn't seem to shrink peak memory consumption at all!
-        parent_(parentObj)
+        selectedForSync(true),
+        hasCmpResultDescr(false),
+        syncDir_(static_cast<unsigned int>(SyncDirection::NONE)),
+        hasSyncDirConflict(false),
+        handleIdx_(parentObj.getBase().objectHandles_.allocate()) //throw std::bad_alloc
     {
+        static_assert(FILE_CONFLICT < (1 << 4) && static_cast<unsigned int>(SyncDirection::NONE) < (1 << 2), "bit field too small");
+        ObjectHandleTable::instance().setObject(handleIdx_, this);
         parent_.notifySyncCfgChanged();
     }
 
-    virtual ~FileSystemObject() {} //don't need polymorphic deletion, but we have a vtable anyway
-    //mustn't call parent here, it is already partially destroyed and nothing more than a pure HierarchyObject!
+    virtual ~FileSystemObject() //don't need polymorphic deletion, but we have a vtable anyway
+    {
+        //mustn't call parent's virtual functions here, it is already partially destroyed and nothing more than a pure HierarchyObject!
+        //=> base() is fine: ~HierarchyObject() destroys its child items before its members and base folder pool
+        ObjectHandleTable::instance().releaseSlot(handleIdx_);
+        if (hasCmpResultDescr || hasSyncDirConflict)
+            removeDescriptions();
+    }
 
     virtual void flip();
     virtual void notifySyncCfgChanged() { parent().notifySyncCfgChanged(); /*propagate!*/ }
@@ -440,21 +849,25 @@ private:
     virtual void removeObjectL() = 0;
     virtual void removeObjectR() = 0;
 
-    //categorization
-    std::unique_ptr<std::wstring> cmpResultDescr; //only filled if getCategory() == FILE_CONFLICT or FILE_DIFFERENT_METADATA
-    CompareFilesResult cmpResult; //although this uses 4 bytes there is currently *no* space wasted in class layout!
+    //descriptions are rare: keep them in a side table of the BaseFolderPair, see FileSystemObjectPool
+    void setCmpResultDescr(const std::wstring& description);
+    void setSyncDirConflictDescr(const std::wstring* description); //nullptr: remove
+    void removeDescriptions(); //noexcept
 
-    bool selectedForSync = true;
+    ItemNameTable::NameId nameIdLeft_;  //slightly redundant under linux, but on windows the "same" filepaths can differ in case
+    ItemNameTable::NameId nameIdRight_; //use as indicator: id 0 = empty name means: not existing!
 
-    //Note: we model *four* states with following two variables => "syncDirectionConflict is empty or syncDir == NONE" is a class invariant!!!
-    SyncDirection syncDir_ = SyncDirection::NONE; //1 byte: optimize memory layout!
-    std::unique_ptr<std::wstring> syncDirectionConflict; //non-empty if we have a conflict setting sync-direction
-    //get rid of std::wstring small string optimization (consumes 32/48 byte on VS2010 x86/x64!)
+    HierarchyObject& parent_;
 
-    Zstring itemNameLeft_;  //slightly redundant under linux, but on windows the "same" filepaths can differ in case
-    Zstring itemNameRight_; //use as indicator: an empty name means: not existing!
+    //categorization and sync settings packed into a single word; shares 8 bytes with handleIdx_
+    unsigned int cmpResult          : 4; //CompareFilesResult
+    unsigned int selectedForSync    : 1;
+    unsigned int hasCmpResultDescr  : 1; //only set if getCategory() == FILE_CONFLICT or FILE_DIFFERENT_METADATA
+    //Note: we model *four* states with following two variables => "no conflict description or syncDir == NONE" is a class invariant!!!
+    unsigned int syncDir_           : 2; //SyncDirection
+    unsigned int hasSyncDirConflict : 1; //conflict setting sync-direction
 
-    HierarchyObject& parent_;
+    const std::uint32_t handleIdx_; //slot in ObjectHandleTable
 };
 
 //------------------------------------------------------------------
@@ -473,7 +886,7 @@ public:
                HierarchyObject& parentObj,
                CompareDirResult defaultCmpResult) :
         FileSystemObject(itemNameLeft, itemNameRight, parentObj, static_cast<CompareFilesResult>(defaultCmpResult)),
-        HierarchyObject(getPairRelativePath() + FILE_NAME_SEPARATOR, parentObj.getBase())  {}
+        HierarchyObject(getPairRelativePath() + FILE_NAME_SEPARATOR, parentObj.getBase(), parentObj.subFolders.get_allocator())  {}
 
     SyncOperation getSyncOperation() const override;
 
@@ -483,10 +896,16 @@ private:
     void flip         () override;
     void removeObjectL() override;
     void removeObjectR() override;
-    void notifySyncCfgChanged() override { haveBufferedSyncOp = false; FileSystemObject::notifySyncCfgChanged(); HierarchyObject::notifySyncCfgChanged(); }
+    void notifySyncCfgChanged() override
+    {
+        if (haveBufferedSyncOp.load(std::memory_order_relaxed)) //don't write unless needed: MergeSides adds child items of the same parents from multiple threads
+            haveBufferedSyncOp = false;
+        FileSystemObject::notifySyncCfgChanged();
+        HierarchyObject::notifySyncCfgChanged();
+    }
 
-    mutable SyncOperation syncOpBuffered = SO_DO_NOTHING; //determining sync-op for directory may be expensive as it depends on child-objects -> buffer it
-    mutable bool haveBufferedSyncOp      = false;         //
+    mutable SyncOperation syncOpBuffered = SO_DO_NOTHING;  //determining sync-op for directory may be expensive as it depends on child-objects -> buffer it
+    mutable std::atomic<bool> haveBufferedSyncOp{ false }; //
 };
 
 //------------------------------------------------------------------
@@ -505,15 +924,18 @@ public:
              const FileDescriptor& right,
              HierarchyObject& parentObj) :
         FileSystemObject(itemNameLeft, itemNameRight, parentObj, defaultCmpResult),
+        isFollowedSymlinkLeft_ (left .isFollowedSymlink),
+        isFollowedSymlinkRight_(right.isFollowedSymlink),
         dataLeft(left),
         dataRight(right) {}
 
     template <SelectedSide side> std::int64_t getLastWriteTime() const;
     template <SelectedSide side> std::uint64_t     getFileSize() const;
     template <SelectedSide side> AFS::FileId       getFileId  () const;
+    template <SelectedSide side> std::int64_t    getChangeTime() const;
     template <SelectedSide side> bool        isFollowedSymlink() const;
 
-    void setMoveRef(ObjectId refId) { moveFileRef = refId; } //reference to corresponding renamed file
+    void setMoveRef(ObjectId refId) { moveFileRef = refId; notifySyncCfgChanged(); } //reference to corresponding renamed file
     ObjectId getMoveRef() const { return moveFileRef; } //may be nullptr
 
     CompareFilesResult getFileCategory() const;
@@ -535,11 +957,36 @@ private:
     SyncOperation applyMoveOptimization(SyncOperation op) const;
 
     void flip         () override;
-    void removeObjectL() override { dataLeft  = FileDescriptor(); }
-    void removeObjectR() override { dataRight = FileDescriptor(); }
+    void removeObjectL() override { dataLeft  = FileData(); isFollowedSymlinkLeft_  = false; }
+    void removeObjectR() override { dataRight = FileData(); isFollowedSymlinkRight_ = false; }
+    void notifySyncCfgChanged() override
+    {
+        FileSystemObject::notifySyncCfgChanged();
+        if (moveFileRef) //sync operation of the renamed file depends on ours: see applyMoveOptimization()
+            if (auto refFile = dynamic_cast<FilePair*>(FileSystemObject::retrieve(moveFileRef)))
+                refFile->FileSystemObject::notifySyncCfgChanged(); //no virtual call: don't bounce back!
+    }
+
+    struct FileData //FileDescriptor without isFollowedSymlink: saves the padding, 8 bytes per side => both flags share one padding
+    {
+        FileData() {}
+        explicit FileData(const FileDescriptor& descr) :
+            lastWriteTimeRaw(descr.lastWriteTimeRaw),
+            fileSize(descr.fileSize),
+            fileId(descr.fileId),
+            changeTimeRaw(descr.changeTimeRaw) {}
 
-    FileDescriptor dataLeft;
-    FileDescriptor dataRight;
+        std::int64_t lastWriteTimeRaw = 0;
+        std::uint64_t fileSize = 0;
+        AFS::FileId fileId {};
+        std::int64_t changeTimeRaw = 0;
+    };
+
+    bool isFollowedSymlinkLeft_;
+    bool isFollowedSymlinkRight_;
+
+    FileData dataLeft;
+    FileData dataRight;
 
     ObjectId moveFileRef = nullptr; //optional, filled by redetermineSyncDirection()
 };
@@ -657,21 +1104,12 @@ CompareDirResult FolderPair::getDirCategory() const
 }
 
 
-inline
-std::wstring FileSystemObject::getCatExtraDescription() const
-{
-    assert(getCategory() == FILE_CONFLICT || getCategory() == FILE_DIFFERENT_METADATA);
-    if (cmpResultDescr) //avoid ternary-WTF! (implicit copy-constructor call!!!!!!)
-        return *cmpResultDescr;
-    return std::wstring();
-}
-
-
 inline
 void FileSystemObject::setSyncDir(SyncDirection newDir)
 {
-    syncDir_ = newDir;
-    syncDirectionConflict.reset();
+    syncDir_ = static_cast<unsigned int>(newDir);
+    if (hasSyncDirConflict)
+        setSyncDirConflictDescr(nullptr);
 
     notifySyncCfgChanged();
 }
@@ -680,23 +1118,13 @@ void FileSystemObject::setSyncDir(SyncDirection newDir)
 inline
 void FileSystemObject::setSyncDirConflict(const std::wstring& description)
 {
-    syncDir_ = SyncDirection::NONE;
-    syncDirectionConflict = std::make_unique<std::wstring>(description);
+    syncDir_ = static_cast<unsigned int>(SyncDirection::NONE);
+    setSyncDirConflictDescr(&description);
 
     notifySyncCfgChanged();
 }
 
 
-inline
-std::wstring FileSystemObject::getSyncOpConflict() const
-{
-    assert(getSyncOperation() == SO_UNRESOLVED_CONFLICT);
-    if (syncDirectionConflict) //avoid ternary-WTF! (implicit copy-constructor call!!!!!!)
-        return *syncDirectionConflict;
-    return std::wstring();
-}
-
-
 inline
 void FileSystemObject::setActive(bool active)
 {
@@ -708,7 +1136,7 @@ void FileSystemObject::setActive(bool active)
 template <SelectedSide side> inline
 bool FileSystemObject::isEmpty() const
 {
-    return SelectParam<side>::ref(itemNameLeft_, itemNameRight_).empty();
+    return SelectParam<side>::ref(nameIdLeft_, nameIdRight_) == 0;
 }
 
 
@@ -720,9 +1148,9 @@ bool FileSystemObject::isEmpty() const
 
 
 template <SelectedSide side> inline
-const Zstring& FileSystemObject::getItemName() const
+ItemName FileSystemObject::getItemName() const
 {
-    return SelectParam<side>::ref(itemNameLeft_, itemNameRight_); //empty if not existing
+    return base().itemNames_.getName(SelectParam<side>::ref(nameIdLeft_, nameIdRight_)); //empty if not existing
 }
 
 
@@ -754,7 +1182,7 @@ template <SelectedSide side> inline
 AbstractPath FileSystemObject::getAbstractPath() const
 {
     assert(!isEmpty<side>());
-    const Zstring& itemName = isEmpty<side>() ? getItemName<OtherSide<side>::result>() : getItemName<side>();
+    const ItemName itemName = isEmpty<side>() ? getItemName<OtherSide<side>::result>() : getItemName<side>();
     return AFS::appendRelPath(base().getAbstractPath<side>(), parent_.getPairRelativePathPf() + itemName);
 }
 
@@ -763,7 +1191,7 @@ template <> inline
 void FileSystemObject::removeObject<LEFT_SIDE>()
 {
     cmpResult = isEmpty<RIGHT_SIDE>() ? FILE_EQUAL : FILE_RIGHT_SIDE_ONLY;
-    itemNameLeft_.clear();
+    nameIdLeft_ = 0;
     removeObjectL();
 
     setSyncDir(SyncDirection::NONE); //calls notifySyncCfgChanged()
@@ -774,7 +1202,7 @@ template <> inline
 void FileSystemObject::removeObject<RIGHT_SIDE>()
 {
     cmpResult = isEmpty<LEFT_SIDE>() ? FILE_EQUAL : FILE_LEFT_SIDE_ONLY;
-    itemNameRight_.clear();
+    nameIdRight_ = 0;
     removeObjectR();
 
     setSyncDir(SyncDirection::NONE); //calls notifySyncCfgChanged()
@@ -785,7 +1213,10 @@ inline
 void FileSystemObject::setSynced(const Zstring& itemName)
 {
     assert(!isEmpty());
-    itemNameRight_ = itemNameLeft_ = itemName;
+    //usually unchanged: reuse the existing entry instead of growing the name table
+    nameIdRight_ = nameIdLeft_ = itemName == getItemName<LEFT_SIDE >() ? nameIdLeft_  :
+                                 itemName == getItemName<RIGHT_SIDE>() ? nameIdRight_ :
+                                 base().itemNames_.add(itemName); //throw std::bad_alloc
     cmpResult = FILE_EQUAL;
     setSyncDir(SyncDirection::NONE);
 }
@@ -805,22 +1236,22 @@ inline
 void FileSystemObject::setCategoryConflict(const std::wstring& description)
 {
     cmpResult = FILE_CONFLICT;
-    cmpResultDescr = std::make_unique<std::wstring>(description);
+    setCmpResultDescr(description);
 }
 
 inline
 void FileSystemObject::setCategoryDiffMetadata(const std::wstring& description)
 {
     cmpResult = FILE_DIFFERENT_METADATA;
-    cmpResultDescr = std::make_unique<std::wstring>(description);
+    setCmpResultDescr(description);
 }
 
 inline
 void FileSystemObject::flip()
 {
-    std::swap(itemNameLeft_, itemNameRight_);
+    std::swap(nameIdLeft_, nameIdRight_);
 
-    switch (cmpResult)
+    switch (getCategory())
     {
         case FILE_LEFT_SIDE_ONLY:
             cmpResult = FILE_RIGHT_SIDE_ONLY;
@@ -999,6 +1430,7 @@ void FilePair::flip()
 {
     FileSystemObject::flip(); //call base class version
     std::swap(dataLeft, dataRight);
+    std::swap(isFollowedSymlinkLeft_, isFollowedSymlinkRight_);
 }
 
 
@@ -1023,10 +1455,17 @@ AFS::FileId FilePair::getFileId() const
 }
 
 
+template <SelectedSide side> inline
+std::int64_t FilePair::getChangeTime() const
+{
+    return SelectParam<side>::ref(dataLeft, dataRight).changeTimeRaw;
+}
+
+
 template <SelectedSide side> inline
 bool FilePair::isFollowedSymlink() const
 {
-    return SelectParam<side>::ref(dataLeft, dataRight).isFollowedSymlink;
+    return SelectParam<side>::ref(isFollowedSymlinkLeft_, isFollowedSymlinkRight_);
 }
 
 
@@ -1043,8 +1482,11 @@ void FilePair::setSyncedTo(const Zstring& itemName,
     //FILE_EQUAL is only allowed for same short name and file size: enforced by this method!
     static const SelectedSide sideSrc = OtherSide<sideTrg>::result;
 
-    SelectParam<sideTrg>::ref(dataLeft, dataRight) = FileDescriptor(lastWriteTimeTrg, fileSize, fileIdTrg, isSymlinkTrg);
-    SelectParam<sideSrc>::ref(dataLeft, dataRight) = FileDescriptor(lastWriteTimeSrc, fileSize, fileIdSrc, isSymlinkSrc);
+    //change time is unknown after sync: e.g. setting the modification time changes it
+    SelectParam<sideTrg>::ref(dataLeft, dataRight) = FileData(FileDescriptor(lastWriteTimeTrg, fileSize, fileIdTrg, 0, isSymlinkTrg));
+    SelectParam<sideSrc>::ref(dataLeft, dataRight) = FileData(FileDescriptor(lastWriteTimeSrc, fileSize, fileIdSrc, 0, isSymlinkSrc));
+    SelectParam<sideTrg>::ref(isFollowedSymlinkLeft_, isFollowedSymlinkRight_) = isSymlinkTrg;
+    SelectParam<sideSrc>::ref(isFollowedSymlinkLeft_, isFollowedSymlinkRight_) = isSymlinkSrc;
 
     moveFileRef = nullptr;
     FileSystemObject::setSynced(itemName); //set FileSystemObject specific part
@@ -1094,4 +1536,15 @@ void SymlinkPair::flip()
 }
 }
 
+
+namespace std
+{
+template <> struct hash<zen::ObjectHandleConst> //e.g. std::unordered_map<FileSystemObject::ObjectIdConst, ...>
+{
+    size_t operator()(const zen::ObjectHandleConst& handle) const { return handle.getIndex(); } //unique among live objects
+};
+
+template <> struct hash<zen::ObjectHandle> : hash<zen::ObjectHandleConst> {};
+}
+
 #endif //FILE_HIERARCHY_H_257235289645296
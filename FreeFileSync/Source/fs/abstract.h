@@ -115,6 +115,7 @@ struct AbstractFileSystem //THREAD-SAFETY: "const" member functions must model t
         virtual ~InputStream() {}
         virtual size_t getBlockSize() const = 0; //non-zero block size is AFS contract! it's implementers job to always give a reasonable buffer size!
         virtual size_t tryRead(void* buffer, size_t bytesToRead) = 0; //throw FileError; may return short, only 0 means EOF! => CONTRACT: bytesToRead > 0
+        virtual void   seek(std::uint64_t offset) = 0; //throw FileError; absolute position for the next read
         virtual FileId        getFileId          () = 0; //throw FileError
         virtual std::int64_t  getModificationTime() = 0; //throw FileError
         virtual std::uint64_t getFileSize        () = 0; //throw FileError
@@ -169,6 +170,7 @@ struct AbstractFileSystem //THREAD-SAFETY: "const" member functions must model t
             std::uint64_t fileSize;      //unit: bytes!
             std::int64_t  lastWriteTime; //number of seconds since Jan. 1st 1970 UTC
             const FileId  id;            //optional: empty if not supported!
+            std::int64_t  changeTime;    //optional: 0 if not supported! status change time (ctime) in an unspecified unit: compare for equality only
             const SymlinkInfo* symlinkInfo; //only filled if file is a followed symlink
         };
 
@@ -196,6 +198,45 @@ struct AbstractFileSystem //THREAD-SAFETY: "const" member functions must model t
 
         virtual HandleError reportDirError (const std::wstring& msg, size_t retryNumber) = 0; //failed directory traversal -> consider directory data at current level as incomplete!
         virtual HandleError reportItemError(const std::wstring& msg, size_t retryNumber, const Zstring& itemName) = 0; //failed to get data for single file/dir/symlink only!
+
+        //hint: accept file attributes which may be slightly out of date, e.g. cached attributes of network file systems; may be ignored by the implementation
+        virtual bool allowStaleAttributes() const { return false; }
+
+        //------------ optional: reuse folder content of an earlier traversal; may be ignored by the implementation ------------
+        struct FolderStamp //changes whenever an item is added, removed or renamed inside the folder
+        {
+            std::int64_t modTimeNs    = 0; //nanoseconds since Jan. 1st 1970 UTC
+            std::int64_t changeTimeNs = 0; //0 if not available
+        };
+
+        enum FolderItemType
+        {
+            FOLDER_ITEM_FILE,
+            FOLDER_ITEM_FOLDER,
+            FOLDER_ITEM_SYMLINK
+        };
+
+        struct FolderItem //raw folder content before following symlinks
+        {
+            Zstring itemName;
+            FolderItemType type = FOLDER_ITEM_FILE;
+            std::uint64_t fileSize      = 0; //files only
+            std::int64_t  lastWriteTime = 0; //files and symlinks
+            FileId        id;                //files only; optional
+        };
+
+        enum FolderCacheMode
+        {
+            FOLDER_CACHE_OFF,
+            FOLDER_CACHE_FAST,   //unchanged folder: reuse item names and attributes
+            FOLDER_CACHE_STRICT, //unchanged folder: reuse item names, but read file and symlink attributes
+        };
+
+        virtual FolderCacheMode getFolderCacheMode() const { return FOLDER_CACHE_OFF; }
+        //called before enumerating the folder this callback represents: return nullptr to enumerate the folder
+        virtual const std::vector<FolderItem>* getCachedFolderContent(const FolderStamp& stamp) { return nullptr; }
+        //called after the folder this callback represents was enumerated completely and without item errors
+        virtual void onFolderContent(const FolderStamp& stamp, std::vector<FolderItem>& items) {}
     };
 
     //- client needs to handle duplicate file reports! (FilePlusTraverser fallback, retrying to read directory contents, ...)
@@ -239,6 +280,22 @@ struct AbstractFileSystem //THREAD-SAFETY: "const" member functions must model t
 
     static std::uint64_t getFreeDiskSpace(const AbstractPath& ap) { return ap.afs->getFreeDiskSpace(ap.itemPathImpl); } //throw FileError, returns 0 if not available
 
+    struct StorageDeviceInfo
+    {
+        Zstring deviceId; //empty if unknown; items with the same id are located on the same physical device
+        bool rotational = false; //spinning disk: concurrent access results in seek thrashing
+    };
+    static StorageDeviceInfo getStorageDeviceInfo(const AbstractPath& ap) { return ap.afs->getStorageDeviceInfo(ap.itemPathImpl); } //noexcept
+
+    //content is identical without reading it:
+    //- same physical file, e.g. hard link, bind mount: file ids as found during traversal
+    static bool isSameFile(const AbstractPath& ap1, const FileId& fileId1, const AbstractPath& ap2, const FileId& fileId2); //noexcept
+    //- distinct files referencing the same data extents, e.g. reflink copy, snapshot on a copy-on-write file system; false if unknown
+    static bool haveSharedExtents(const AbstractPath& ap1, const AbstractPath& ap2); //noexcept
+
+    //sort key for reading files with little seeking: physical offset of the first data extent, or inode number as a rough fallback; 0 if unknown
+    static std::uint64_t getDiskLocation(const AbstractPath& ap) { return ap.afs->getDiskLocation(ap.itemPathImpl); } //noexcept
+
     static bool supportsRecycleBin(const AbstractPath& ap, const std::function<void ()>& onUpdateGui) { return ap.afs->supportsRecycleBin(ap.itemPathImpl, onUpdateGui); } //throw FileError
 
     struct RecycleSession
@@ -339,6 +396,9 @@ private:
     //----------------------------------------------------------------------------------------------------------------
 
     virtual std::uint64_t getFreeDiskSpace(const Zstring& itemPathImpl) const = 0; //throw FileError, returns 0 if not available
+    virtual StorageDeviceInfo getStorageDeviceInfo(const Zstring& itemPathImpl) const = 0; //noexcept
+    virtual bool haveSharedExtentsSameAfsType(const Zstring& itemPathImpl1, const AbstractPath& ap2) const = 0; //noexcept
+    virtual std::uint64_t getDiskLocation(const Zstring& itemPathImpl) const = 0; //noexcept
     virtual bool supportsRecycleBin(const Zstring& itemPathImpl, const std::function<void ()>& onUpdateGui) const  = 0; //throw FileError
     virtual std::unique_ptr<RecycleSession> createRecyclerSession(const Zstring& itemPathImpl) const = 0; //throw FileError, return value must be bound!
     virtual void recycleItemDirectly(const Zstring& itemPathImpl) const = 0; //throw FileError
@@ -422,6 +482,21 @@ bool AbstractFileSystem::havePathDependency(const AbstractPath& lhs, const Abstr
 };
 
 
+inline
+bool AbstractFileSystem::isSameFile(const AbstractPath& ap1, const FileId& fileId1, const AbstractPath& ap2, const FileId& fileId2)
+{
+    //file ids are only meaningful within the same AFS type
+    return typeid(*ap1.afs) == typeid(*ap2.afs) && !fileId1.empty() && fileId1 == fileId2;
+}
+
+
+inline
+bool AbstractFileSystem::haveSharedExtents(const AbstractPath& ap1, const AbstractPath& ap2)
+{
+    return typeid(*ap1.afs) != typeid(*ap2.afs) ? false : ap1.afs->haveSharedExtentsSameAfsType(ap1.itemPathImpl, ap2);
+}
+
+
 inline
 Zstring AbstractFileSystem::appendPaths(const Zstring& basePath, const Zstring& relPath, Zchar pathSep)
 {
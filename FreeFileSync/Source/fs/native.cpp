@@ -23,6 +23,13 @@
     #include <fcntl.h> //fallocate, fcntl
 #endif
 
+#ifdef ZEN_LINUX
+    #include <sys/sysmacros.h> //major, minor
+    #include <sys/ioctl.h>
+    #include <linux/fs.h> //FS_IOC_FIEMAP, FS_IOC_GETFSUUID
+    #include <linux/fiemap.h>
+#endif
+
 using namespace zen;
 
 
@@ -46,6 +53,160 @@ void initComForThread() //throw FileError
 }
 
 
+#ifdef ZEN_LINUX
+//find the block device behind a path via sysfs: https://www.kernel.org/doc/Documentation/block/queue-sysfs.txt
+AbstractFileSystem::StorageDeviceInfo getStorageDeviceInfoImpl(const Zstring& itemPath) //noexcept
+{
+    struct ::stat fileInfo = {};
+    if (::stat(itemPath.c_str(), &fileInfo) != 0)
+        return {};
+
+    auto readSysFile = [](const Zstring& filePath) -> Opt<std::string>
+    {
+        try { return trimCpy(loadBinContainer<std::string>(filePath, nullptr)); } //throw FileError
+        catch (FileError&) { return NoValue(); }
+    };
+
+    const Zstring devId = numberTo<Zstring>(major(fileInfo.st_dev)) + Zstr(":") + numberTo<Zstring>(minor(fileInfo.st_dev));
+    const Zstring sysDevPath = Zstr("/sys/dev/block/") + devId;
+
+    AbstractFileSystem::StorageDeviceInfo info;
+    info.deviceId = devId; //no sysfs entry for NFS, CIFS, tmpfs, ... (major == 0): treat as distinct non-rotational device
+
+    //partitions (e.g. sda1) share the disk's (sda) request queue => group by the whole disk
+    const Zstring sysDiskPath = somethingExists(appendSeparator(sysDevPath) + Zstr("partition")) ? appendSeparator(sysDevPath) + Zstr("..") : sysDevPath;
+
+    if (Opt<std::string> diskId = readSysFile(sysDiskPath + Zstr("/dev")))
+        info.deviceId = utfCvrtTo<Zstring>(*diskId);
+
+    if (Opt<std::string> rotational = readSysFile(sysDiskPath + Zstr("/queue/rotational")))
+        info.rotational = *rotational == "1";
+
+    return info;
+}
+
+
+struct FileExtent
+{
+    std::uint64_t logical;
+    std::uint64_t physical;
+    std::uint64_t length;
+};
+inline bool operator==(const FileExtent& lhs, const FileExtent& rhs) { return lhs.logical == rhs.logical && lhs.physical == rhs.physical && lhs.length == rhs.length; }
+
+
+//shared data extents via FIEMAP: https://www.kernel.org/doc/Documentation/filesystems/fiemap.txt
+//return none if some extent is not shared or if the physical location does not uniquely identify the data: not supported, inline, compressed, ...
+Opt<std::vector<FileExtent>> getSharedFileExtents(int fd)
+{
+    const size_t extentCountMax = 256;
+    std::vector<char> buffer(sizeof(struct ::fiemap) + extentCountMax * sizeof(struct ::fiemap_extent));
+    auto& fm = *reinterpret_cast<struct ::fiemap*>(&buffer[0]);
+
+    std::vector<FileExtent> extents;
+    for (;;)
+    {
+        const std::uint64_t startPos = extents.empty() ? 0 : extents.back().logical + extents.back().length;
+        std::fill(buffer.begin(), buffer.end(), 0);
+        fm.fm_start        = startPos;
+        fm.fm_length       = FIEMAP_MAX_OFFSET - startPos;
+        fm.fm_flags        = FIEMAP_FLAG_SYNC; //write back dirty pages first: they are not yet part of any extent
+        fm.fm_extent_count = extentCountMax;
+
+        if (::ioctl(fd, FS_IOC_FIEMAP, &fm) != 0)
+            return NoValue();
+        if (fm.fm_mapped_extents == 0)
+            return extents;
+
+        for (size_t i = 0; i < fm.fm_mapped_extents; ++i)
+        {
+            const struct ::fiemap_extent& fe = fm.fm_extents[i];
+            if (fe.fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_ENCODED | FIEMAP_EXTENT_DATA_ENCRYPTED |
+                               FIEMAP_EXTENT_NOT_ALIGNED | FIEMAP_EXTENT_DATA_INLINE | FIEMAP_EXTENT_DATA_TAIL | FIEMAP_EXTENT_UNWRITTEN))
+                return NoValue();
+            if (!(fe.fe_flags & FIEMAP_EXTENT_SHARED)) //e.g. ext4: fail fast without looking at the other file
+                return NoValue();
+
+            //normalize: the file system may split a contiguous range differently for each file
+            if (!extents.empty() &&
+                extents.back().logical  + extents.back().length == fe.fe_logical &&
+                extents.back().physical + extents.back().length == fe.fe_physical)
+                extents.back().length += fe.fe_length;
+            else
+                extents.push_back({ fe.fe_logical, fe.fe_physical, fe.fe_length });
+
+            if (fe.fe_flags & FIEMAP_EXTENT_LAST)
+                return extents;
+        }
+    }
+}
+
+
+bool haveSharedExtentsImpl(const Zstring& filePath1, const Zstring& filePath2) //noexcept
+{
+    const int fd1 = ::open(filePath1.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd1 == -1)
+        return false; //let content comparison report the error
+    ZEN_ON_SCOPE_EXIT(::close(fd1));
+
+    const int fd2 = ::open(filePath2.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd2 == -1)
+        return false;
+    ZEN_ON_SCOPE_EXIT(::close(fd2));
+
+    struct ::stat fileInfo1 = {};
+    struct ::stat fileInfo2 = {};
+    if (::fstat(fd1, &fileInfo1) != 0 || ::fstat(fd2, &fileInfo2) != 0 ||
+        fileInfo1.st_size != fileInfo2.st_size || fileInfo1.st_size == 0)
+        return false;
+
+    //physical addresses are comparable within the same file system only
+    if (fileInfo1.st_dev != fileInfo2.st_dev)
+    {
+#ifdef FS_IOC_GETFSUUID //Linux 6.5+: btrfs subvolumes (e.g. snapshots) have distinct device ids, but share their file system's address space
+        struct ::fsuuid2 fsId1 = {};
+        struct ::fsuuid2 fsId2 = {};
+        if (::ioctl(fd1, FS_IOC_GETFSUUID, &fsId1) != 0 || ::ioctl(fd2, FS_IOC_GETFSUUID, &fsId2) != 0 ||
+            fsId1.len == 0 || fsId1.len != fsId2.len || std::memcmp(fsId1.uuid, fsId2.uuid, fsId1.len) != 0)
+            return false;
+#else
+        return false;
+#endif
+    }
+
+    const Opt<std::vector<FileExtent>> extents1 = getSharedFileExtents(fd1);
+    if (!extents1 || extents1->empty())
+        return false;
+    const Opt<std::vector<FileExtent>> extents2 = getSharedFileExtents(fd2);
+    return extents2 && *extents1 == *extents2; //holes at the same positions read as zeros on both sides
+}
+
+
+std::uint64_t getDiskLocationImpl(const Zstring& filePath) //noexcept
+{
+    const int fd = ::open(filePath.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1)
+        return 0;
+    ZEN_ON_SCOPE_EXIT(::close(fd));
+
+    std::vector<char> buffer(sizeof(struct ::fiemap) + sizeof(struct ::fiemap_extent));
+    auto& fm = *reinterpret_cast<struct ::fiemap*>(&buffer[0]);
+    fm.fm_length       = FIEMAP_MAX_OFFSET;
+    fm.fm_extent_count = 1; //no FIEMAP_FLAG_SYNC: don't write back dirty pages just for sorting
+
+    if (::ioctl(fd, FS_IOC_FIEMAP, &fm) == 0 && fm.fm_mapped_extents == 1 &&
+        !(fm.fm_extents[0].fe_flags & (FIEMAP_EXTENT_UNKNOWN | FIEMAP_EXTENT_DELALLOC | FIEMAP_EXTENT_NOT_ALIGNED | FIEMAP_EXTENT_DATA_INLINE)))
+        return fm.fm_extents[0].fe_physical;
+
+    //no extents (e.g. NFS, empty or inline file): file systems tend to place data close to its inode
+    struct ::stat fileInfo = {};
+    if (::fstat(fd, &fileInfo) == 0)
+        return fileInfo.st_ino;
+    return 0;
+}
+#endif
+
+
 class RecycleSessionNative : public AbstractFileSystem::RecycleSession
 {
 public:
@@ -147,6 +308,7 @@ struct InputStreamNative : public AbstractFileSystem::InputStream
 
     size_t        getBlockSize()  const override { return fi.getBlockSize(); } //non-zero block size is AFS contract!
     size_t        tryRead(void* buffer, size_t bytesToRead) override { return fi.tryRead(buffer, bytesToRead); } //throw FileError; may return short, only 0 means EOF! => CONTRACT: bytesToRead > 0
+    void          seek(std::uint64_t offset)                override { fi.seek(offset); }                      //throw FileError
     AFS::FileId   getFileId          () override; //throw FileError
     std::int64_t  getModificationTime() override; //throw FileError
     std::uint64_t getFileSize        () override; //throw FileError
@@ -473,6 +635,33 @@ private:
         return zen::getFreeDiskSpace(itemPathImpl); //throw FileError
     }
 
+    StorageDeviceInfo getStorageDeviceInfo(const Zstring& itemPathImpl) const override //noexcept
+    {
+#ifdef ZEN_LINUX
+        return getStorageDeviceInfoImpl(itemPathImpl); //noexcept
+#else
+        return {}; //unknown: don't limit concurrent access
+#endif
+    }
+
+    bool haveSharedExtentsSameAfsType(const Zstring& itemPathImpl1, const AbstractPath& ap2) const override //noexcept
+    {
+#ifdef ZEN_LINUX
+        return haveSharedExtentsImpl(itemPathImpl1, getItemPathImpl(ap2)); //noexcept
+#else
+        return false;
+#endif
+    }
+
+    std::uint64_t getDiskLocation(const Zstring& itemPathImpl) const override //noexcept
+    {
+#ifdef ZEN_LINUX
+        return getDiskLocationImpl(itemPathImpl); //noexcept
+#else
+        return 0; //unknown: keep hierarchy order
+#endif
+    }
+
     bool supportsRecycleBin(const Zstring& itemPathImpl, const std::function<void ()>& onUpdateGui) const override //throw FileError
     {
 #ifdef ZEN_WIN
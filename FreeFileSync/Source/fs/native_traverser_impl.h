@@ -6,10 +6,15 @@
 
 #include <zen/sys_error.h>
 #include <zen/symlink_target.h>
+#include <deque>
 
-#include <cstddef> //offsetof
+#include <atomic>
 #include <sys/stat.h>
+#include <sys/sysmacros.h> //makedev
+#include <sys/syscall.h> //SYS_getdents64
 #include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
 
 //implementation header for native.cpp, not for reuse!!!
 
@@ -31,6 +36,57 @@ AFS::FileId convertToAbstractFileId(const zen::FileId& fid)
 }
 
 
+struct ItemAttributes
+{
+    mode_t        type = 0; //S_IFMT bits of st_mode only
+    std::uint64_t fileSize = 0;
+    std::int64_t  modTime  = 0; //number of seconds since Jan. 1st 1970 UTC
+    zen::FileId   fileId;
+    std::int64_t  changeTime = 0; //[ns]: ctime changes with every write *and* metadata change, and can't be set by user space
+};
+
+//get the minimal set of attributes needed for traversal: file type, size, modification time and file id
+//=> statx() allows the file system to skip everything else, e.g. expensive attribute revalidation on NFS/CIFS
+//returns false on error with errno set
+inline
+bool getItemAttributes(int dirFd, const char* itemName, bool followSymlinks, bool allowStaleAttributes, ItemAttributes& attr)
+{
+#ifdef STATX_BASIC_STATS //glibc 2.28+
+    static std::atomic<bool> statxUnsupported(false); //Linux kernel < 4.11
+    if (!statxUnsupported)
+    {
+        struct ::statx sx = {};
+        if (::statx(dirFd, itemName,
+                    (followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW) | (allowStaleAttributes ? AT_STATX_DONT_SYNC : AT_STATX_SYNC_AS_STAT),
+                    STATX_TYPE | STATX_SIZE | STATX_MTIME | STATX_INO | STATX_CTIME, &sx) == 0)
+        {
+            const dev_t devId = makedev(sx.stx_dev_major, sx.stx_dev_minor); //same encoding as stat::st_dev => file ids stay comparable with extractFileId()
+
+            attr.type     = sx.stx_mode & S_IFMT;
+            attr.fileSize = sx.stx_size;
+            attr.modTime  = sx.stx_mtime.tv_sec;
+            attr.fileId   = devId != 0 && sx.stx_ino != 0 ? zen::FileId(devId, sx.stx_ino) : zen::FileId();
+            attr.changeTime = sx.stx_mask & STATX_CTIME ? sx.stx_ctime.tv_sec * 1000000000LL + sx.stx_ctime.tv_nsec : 0;
+            return true;
+        }
+        if (errno != ENOSYS)
+            return false;
+        statxUnsupported = true;
+    }
+#endif
+    struct ::stat statData = {};
+    if (::fstatat(dirFd, itemName, &statData, followSymlinks ? 0 : AT_SYMLINK_NOFOLLOW) != 0)
+        return false;
+
+    attr.type     = statData.st_mode & S_IFMT;
+    attr.fileSize = makeUnsigned(statData.st_size);
+    attr.modTime  = statData.st_mtime;
+    attr.fileId   = extractFileId(statData);
+    attr.changeTime = statData.st_ctim.tv_sec * 1000000000LL + statData.st_ctim.tv_nsec;
+    return true;
+}
+
+
 class DirTraverser
 {
 public:
@@ -42,123 +98,229 @@ public:
 private:
     DirTraverser(const Zstring& baseDirectory, AFS::TraverserCallback& sink)
     {
-        /* quote: "Since POSIX.1 does not specify the size of the d_name field, and other nonstandard fields may precede
-                   that field within the dirent structure, portable applications that use readdir_r() should allocate
-                   the buffer whose address is passed in entry as follows:
-                       len = offsetof(struct dirent, d_name) + pathconf(dirPath, _PC_NAME_MAX) + 1
-                       entryp = malloc(len); */
-        const size_t nameMax = std::max<long>(::pathconf(baseDirectory.c_str(), _PC_NAME_MAX), 10000); //::pathconf may return long(-1)
-        buffer.resize(offsetof(struct ::dirent, d_name) + nameMax + 1);
-
-        traverse(baseDirectory, sink);
+        traverse(baseDirectory, sink, 0);
     }
 
     DirTraverser           (const DirTraverser&) = delete;
     DirTraverser& operator=(const DirTraverser&) = delete;
 
-    void traverse(const Zstring& dirPath, AFS::TraverserCallback& sink)
+    void traverse(const Zstring& dirPath, AFS::TraverserCallback& sink, size_t level)
     {
         tryReportingDirError([&]
         {
-            traverseWithException(dirPath, sink); //throw FileError
+            traverseWithException(dirPath, sink, level); //throw FileError
         }, sink);
     }
 
-    void traverseWithException(const Zstring& dirPath, AFS::TraverserCallback& sink) //throw FileError
+    using FolderItem = AFS::TraverserCallback::FolderItem;
+
+    struct FolderContext
+    {
+        const int dirFd;
+        const Zstring& dirPath;
+        AFS::TraverserCallback& sink;
+        const size_t level;
+        const bool allowStaleAttributes;
+        std::vector<FolderItem>* folderItems; //optional: record raw folder content for AFS::TraverserCallback::onFolderContent()
+        bool folderItemsComplete;
+    };
+
+    /*
+    perf: read directory entries in large batches via getdents64() and get attributes via statx() relative to the open directory handle:
+        - no full item path is built per entry: kernel does not need to resolve the path from root for each item
+        - d_type lets us skip the stat() call for directories, whose attributes we don't need
+    */
+    void traverseWithException(const Zstring& dirPath, AFS::TraverserCallback& sink, size_t level) //throw FileError
     {
         //no need to check for endless recursion: Linux has a fixed limit on the number of symbolic links in a path
 
-        DIR* dirObj = ::opendir(dirPath.c_str()); //directory must NOT end with path separator, except "/"
-        if (!dirObj)
-            THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot open directory %x."), L"%x", fmtPath(dirPath)), L"opendir");
-        ZEN_ON_SCOPE_EXIT(::closedir(dirObj)); //never close nullptr handles! -> crash
+        const int dirFd = ::open(dirPath.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC); //directory must NOT end with path separator, except "/"
+        if (dirFd == -1)
+            THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot open directory %x."), L"%x", fmtPath(dirPath)), L"open");
+        ZEN_ON_SCOPE_EXIT(::close(dirFd));
+
+        const AFS::TraverserCallback::FolderCacheMode cacheMode = sink.getFolderCacheMode();
+        AFS::TraverserCallback::FolderStamp folderStamp;
+        std::vector<FolderItem> folderItems;
+
+        FolderContext ctx = { dirFd, dirPath, sink, level, sink.allowStaleAttributes(), cacheMode != AFS::TraverserCallback::FOLDER_CACHE_OFF ? &folderItems : nullptr, true };
+
+        if (cacheMode != AFS::TraverserCallback::FOLDER_CACHE_OFF)
+        {
+            //get stamp *before* reading the folder: concurrent changes will invalidate the recorded folder content
+            struct ::stat dirInfo = {};
+            if (::fstat(dirFd, &dirInfo) != 0)
+                THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot read file attributes of %x."), L"%x", fmtPath(dirPath)), L"fstat");
+
+            folderStamp.modTimeNs    = static_cast<std::int64_t>(dirInfo.st_mtim.tv_sec) * 1000000000 + dirInfo.st_mtim.tv_nsec;
+            folderStamp.changeTimeNs = static_cast<std::int64_t>(dirInfo.st_ctim.tv_sec) * 1000000000 + dirInfo.st_ctim.tv_nsec;
+
+            if (const std::vector<FolderItem>* cachedItems = sink.getCachedFolderContent(folderStamp))
+            {
+                //folder is unchanged => skip getdents64()
+                for (const FolderItem& item : *cachedItems)
+                    if (item.type == AFS::TraverserCallback::FOLDER_ITEM_FOLDER)
+                        processItem(ctx, item.itemName.c_str(), item.itemName, true /*isFolder*/);
+                    else if (cacheMode == AFS::TraverserCallback::FOLDER_CACHE_STRICT)
+                        processItem(ctx, item.itemName.c_str(), item.itemName, false /*isFolder*/); //read file attributes again
+                    else
+                        processCachedItem(ctx, item);
+
+                if (ctx.folderItemsComplete)
+                    sink.onFolderContent(folderStamp, folderItems);
+                return;
+            }
+        }
+
+        //we're recursing while evaluating a batch => one buffer per level
+        if (buffers.size() <= level)
+            buffers.resize(level + 1);
+        std::vector<char>& buffer = buffers[level];
+        buffer.resize(DIR_BATCH_BUFFER_SIZE);
 
         for (;;)
         {
-            struct ::dirent* dirEntry = nullptr;
-            if (::readdir_r(dirObj, reinterpret_cast< ::dirent*>(&buffer[0]), &dirEntry) != 0)
-                THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot enumerate directory %x."), L"%x", fmtPath(dirPath)), L"readdir_r");
+            const long bytesRead = ::syscall(SYS_getdents64, dirFd, &buffer[0], buffer.size());
+            if (bytesRead < 0)
+                THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot enumerate directory %x."), L"%x", fmtPath(dirPath)), L"getdents64");
             //don't retry but restart dir traversal on error! http://blogs.msdn.com/b/oldnewthing/archive/2014/06/12/10533529.aspx
 
-            if (!dirEntry) //no more items
-                return;
+            if (bytesRead == 0) //no more items
+                break;
+
+            for (long pos = 0; pos < bytesRead;)
+            {
+                const auto& dirEntry = *reinterpret_cast<const struct ::dirent64*>(&buffer[pos]); //struct dirent64 has same layout as the kernel's linux_dirent64
+                pos += dirEntry.d_reclen;
+
+                //don't return "." and ".."
+                const char* itemNameRaw = dirEntry.d_name;
+
+                if (itemNameRaw[0] == 0) throw FileError(replaceCpy(_("Cannot enumerate directory %x."), L"%x", fmtPath(dirPath)), L"getdents64: Data corruption; item is missing a name.");
+                if (itemNameRaw[0] == '.' &&
+                    (itemNameRaw[1] == 0 || (itemNameRaw[1] == '.' && itemNameRaw[2] == 0)))
+                    continue;
+
+                //we don't need any attributes for directories => skip statx()
+                //else: DT_REG, DT_LNK, DT_UNKNOWN (e.g. not supported by file system), ...
+                processItem(ctx, itemNameRaw, itemNameRaw, dirEntry.d_type == DT_DIR);
+            }
+        }
 
-            //don't return "." and ".."
-            const char* itemName = dirEntry->d_name; //evaluate dirEntry *before* going into recursion => we use a single "buffer"!
+        if (ctx.folderItems && ctx.folderItemsComplete)
+            sink.onFolderContent(folderStamp, folderItems);
+    }
 
-            if (itemName[0] == 0) throw FileError(replaceCpy(_("Cannot enumerate directory %x."), L"%x", fmtPath(dirPath)), L"readdir_r: Data corruption; item is missing a name.");
-            if (itemName[0] == '.' &&
-                (itemName[1] == 0 || (itemName[1] == '.' && itemName[2] == 0)))
-                continue;
+    void processItem(FolderContext& ctx, const char* itemNameRaw, const Zstring& itemName, bool isFolder)
+    {
+        if (isFolder)
+        {
+            if (ctx.folderItems)
+                ctx.folderItems->push_back({ itemName, AFS::TraverserCallback::FOLDER_ITEM_FOLDER });
+
+            if (std::unique_ptr<AFS::TraverserCallback> trav = ctx.sink.onDir({ itemName }))
+                traverse(appendSeparator(ctx.dirPath) + itemName, *trav, ctx.level + 1);
+            return;
+        }
 
-			const Zstring& itemPath = appendSeparator(dirPath) + itemName;
+        ItemAttributes attr;
+        if (!tryReportingItemError([&]
+    {
+        if (!getItemAttributes(ctx.dirFd, itemNameRaw, false /*followSymlinks*/, ctx.allowStaleAttributes, attr))
+                THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot read file attributes of %x."), L"%x", fmtPath(appendSeparator(ctx.dirPath) + itemName)), L"statx");
+        }, ctx.sink, itemName))
+        {
+            ctx.folderItemsComplete = false;
+            return; //ignore error: skip file
+        }
 
-            struct ::stat statData = {};
-            if (!tryReportingItemError([&]
+        if (S_ISLNK(attr.type)) //on Linux there is no distinction between file and directory symlinks!
         {
-            if (::lstat(itemPath.c_str(), &statData) != 0) //lstat() does not resolve symlinks
-                    THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot read file attributes of %x."), L"%x", fmtPath(itemPath)), L"lstat");
-            }, sink, itemName))
-            continue; //ignore error: skip file
+            if (ctx.folderItems)
+                ctx.folderItems->push_back({ itemName, AFS::TraverserCallback::FOLDER_ITEM_SYMLINK, 0, attr.modTime });
+
+            processSymlink(ctx, itemNameRaw, { itemName, attr.modTime });
+        }
+        else if (S_ISDIR(attr.type)) //a directory (d_type == DT_UNKNOWN)
+        {
+            if (ctx.folderItems)
+                ctx.folderItems->push_back({ itemName, AFS::TraverserCallback::FOLDER_ITEM_FOLDER });
+
+            if (std::unique_ptr<AFS::TraverserCallback> trav = ctx.sink.onDir({ itemName }))
+                traverse(appendSeparator(ctx.dirPath) + itemName, *trav, ctx.level + 1);
+        }
+        else //a file or named pipe, ect.
+        {
+            AFS::TraverserCallback::FileInfo fi = { itemName, attr.fileSize, attr.modTime, convertToAbstractFileId(attr.fileId), attr.changeTime, nullptr /*symlinkInfo*/ };
+
+            if (ctx.folderItems)
+                ctx.folderItems->push_back({ itemName, AFS::TraverserCallback::FOLDER_ITEM_FILE, fi.fileSize, fi.lastWriteTime, fi.id });
+
+            ctx.sink.onFile(fi);
+        }
+        /*
+        It may be a good idea to not check "S_ISREG(statData.st_mode)" explicitly and to not issue an error message on other types to support these scenarios:
+        - RTS setup watch (essentially wants to read directories only)
+        - removeDirectory (wants to delete everything; pipes can be deleted just like files via "unlink")
+
+        However an "open" on a pipe will block (https://sourceforge.net/p/freefilesync/bugs/221/), so the copy routines need to be smarter!!
+        */
+    }
 
-            if (S_ISLNK(statData.st_mode)) //on Linux there is no distinction between file and directory symlinks!
+    //FOLDER_CACHE_FAST: reuse attributes of an unchanged folder
+    void processCachedItem(FolderContext& ctx, const FolderItem& item)
+    {
+        if (ctx.folderItems)
+            ctx.folderItems->push_back(item);
+
+        if (item.type == AFS::TraverserCallback::FOLDER_ITEM_SYMLINK)
+            processSymlink(ctx, item.itemName.c_str(), { item.itemName, item.lastWriteTime }); //symlink target is not cached: resolve again if needed
+        else
+        {
+            AFS::TraverserCallback::FileInfo fi = { item.itemName, item.fileSize, item.lastWriteTime, item.id, 0 /*changeTime: not cached => unknown*/, nullptr /*symlinkInfo*/ };
+            ctx.sink.onFile(fi);
+        }
+    }
+
+    void processSymlink(FolderContext& ctx, const char* itemNameRaw, const AFS::TraverserCallback::SymlinkInfo& linkInfo)
+    {
+        switch (ctx.sink.onSymlink(linkInfo))
+        {
+            case AFS::TraverserCallback::LINK_FOLLOW:
             {
-                const AFS::TraverserCallback::SymlinkInfo linkInfo = { itemName, statData.st_mtime };
+                //try to resolve symlink (and report error on failure!!!)
+                ItemAttributes attrTrg;
+
+                bool validLink = tryReportingItemError([&]
+                {
+                    if (!getItemAttributes(ctx.dirFd, itemNameRaw, true /*followSymlinks*/, ctx.allowStaleAttributes, attrTrg))
+                        THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot resolve symbolic link %x."), L"%x", fmtPath(appendSeparator(ctx.dirPath) + linkInfo.itemName)), L"statx");
+                }, ctx.sink, linkInfo.itemName);
 
-                switch (sink.onSymlink(linkInfo))
+                if (validLink)
                 {
-                    case AFS::TraverserCallback::LINK_FOLLOW:
+                    if (S_ISDIR(attrTrg.type)) //a directory
                     {
-                        //try to resolve symlink (and report error on failure!!!)
-                        struct ::stat statDataTrg = {};
-
-                        bool validLink = tryReportingItemError([&]
-                        {
-                            if (::stat(itemPath.c_str(), &statDataTrg) != 0)
-                                THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot resolve symbolic link %x."), L"%x", fmtPath(itemPath)), L"stat");
-                        }, sink, itemName);
-
-                        if (validLink)
-                        {
-                            if (S_ISDIR(statDataTrg.st_mode)) //a directory
-                            {
-                                if (std::unique_ptr<AFS::TraverserCallback> trav = sink.onDir({ itemName }))
-                                    traverse(itemPath, *trav);
-                            }
-                            else //a file or named pipe, ect.
-                            {
-                                AFS::TraverserCallback::FileInfo fi = { itemName, makeUnsigned(statDataTrg.st_size), statDataTrg.st_mtime, convertToAbstractFileId(extractFileId(statDataTrg)), &linkInfo };
-                                sink.onFile(fi);
-                            }
-                        }
-                        // else //broken symlink -> ignore: it's client's responsibility to handle error!
+                        if (std::unique_ptr<AFS::TraverserCallback> trav = ctx.sink.onDir({ linkInfo.itemName }))
+                            traverse(appendSeparator(ctx.dirPath) + linkInfo.itemName, *trav, ctx.level + 1);
+                    }
+                    else //a file or named pipe, ect.
+                    {
+                        AFS::TraverserCallback::FileInfo fi = { linkInfo.itemName, attrTrg.fileSize, attrTrg.modTime, convertToAbstractFileId(attrTrg.fileId), attrTrg.changeTime, &linkInfo };
+                        ctx.sink.onFile(fi);
                     }
-                    break;
-
-                    case AFS::TraverserCallback::LINK_SKIP:
-                        break;
                 }
+                // else //broken symlink -> ignore: it's client's responsibility to handle error!
             }
-            else if (S_ISDIR(statData.st_mode)) //a directory
-            {
-                if (std::unique_ptr<AFS::TraverserCallback> trav = sink.onDir({ itemName }))
-                    traverse(itemPath, *trav);
-            }
-            else //a file or named pipe, ect.
-            {
-                AFS::TraverserCallback::FileInfo fi = { itemName, makeUnsigned(statData.st_size), statData.st_mtime, convertToAbstractFileId(extractFileId(statData)), nullptr /*symlinkInfo*/ };
-                sink.onFile(fi);
-            }
-            /*
-            It may be a good idea to not check "S_ISREG(statData.st_mode)" explicitly and to not issue an error message on other types to support these scenarios:
-            - RTS setup watch (essentially wants to read directories only)
-            - removeDirectory (wants to delete everything; pipes can be deleted just like files via "unlink")
+            break;
 
-            However an "open" on a pipe will block (https://sourceforge.net/p/freefilesync/bugs/221/), so the copy routines need to be smarter!!
-            */
+            case AFS::TraverserCallback::LINK_SKIP:
+                break;
         }
     }
 
-    std::vector<char> buffer;
+    static const size_t DIR_BATCH_BUFFER_SIZE = 128 * 1024; //number of directory entries read per getdents64() call: ~ 4000 for short names
+
+    std::deque<std::vector<char>> buffers; //one per recursion level: reused for all directories on the same level; deque: growing must not invalidate references of parent levels
 };
 }
@@ -7,6 +7,9 @@
 #include "binary.h"
 #include <vector>
 #include <chrono>
+#include <cstring>
+#include <zen/thread.h>
+#include <zen/optional.h>
 //#include <zen/tick_count.h>
 
 using namespace zen;
@@ -35,28 +38,66 @@ buffer  MB/s
 
 const size_t BLOCK_SIZE_MAX =  16 * 1024 * 1024;
 
+const size_t SAMPLE_BLOCK_SIZE = 1024 * 1024; //sampled comparison: large enough for reading not to be dominated by seeking
 
-struct StreamReader
+//read-ahead pays only if reading waits for the device: page-cached data is copied faster than a thread is started
+const std::chrono::milliseconds READ_AHEAD_MIN_READ_TIME(1);
+
+
+//reads into reused buffers: the next chunk is handed out only after all bytes of the previous one were consumed => no memmove, no allocation per chunk
+//read-ahead: once a full block took READ_AHEAD_MIN_READ_TIME to read, a reader thread fills a second buffer while the caller compares the first
+//=> small files and files in the page cache are read without creating a thread
+class StreamReader
 {
-    StreamReader(const AbstractPath& filePath, const std::function<void(std::int64_t bytesDelta)>& notifyProgress, size_t& unevenBytes) :
+public:
+    StreamReader(const AbstractPath& filePath, const std::function<void(std::int64_t bytesDelta)>& notifyProgress, size_t& unevenBytes, Blake2bHash128* hasher) :
         stream(AFS::getInputStream(filePath)), //throw FileError, (ErrorFileLocked)
         defaultBlockSize(stream->getBlockSize()),
         dynamicBlockSize(defaultBlockSize),
         notifyProgress_(notifyProgress),
-        unevenBytes_(unevenBytes) {}
+        unevenBytes_(unevenBytes),
+        hasher_(hasher) {}
 
-    void appendChunk(std::vector<char>& buffer) //throw FileError
+    ~StreamReader()
     {
-        assert(!eof);
-        if (eof) return;
+        if (readAheadThread.joinable()) //= precondition of thread::join(), which throws an exception if violated!
+        {
+            readAheadThread.interrupt();
+            readAheadThread.join(); //a read already in progress is completed
+        }
+    }
 
-        const auto startTime = std::chrono::steady_clock::now();
+    void readChunk() //throw FileError
+    {
+        assert(!eof && bytesAvailable() == 0);
+        if (eof) return;
 
-        buffer.resize(buffer.size() + dynamicBlockSize);
-        const size_t bytesRead = stream->tryRead(&*(buffer.end() - dynamicBlockSize), dynamicBlockSize); //throw FileError; may return short, only 0 means EOF! => CONTRACT: bytesToRead > 0
-        buffer.resize(buffer.size() - dynamicBlockSize + bytesRead); //caveat: unsigned arithmetics
+        size_t bytesRead = 0;
+        if (!readAheadThread.joinable())
+        {
+            const size_t bytesRequested = dynamicBlockSize;
+            bytesRead = readBlock(buffer); //throw FileError
 
-        const auto stopTime = std::chrono::steady_clock::now();
+            //file continues beyond this block and reading is I/O-bound: overlap reading the next chunk with comparing this one
+            if (bytesRead == bytesRequested && lastReadTime >= READ_AHEAD_MIN_READ_TIME)
+                readAheadThread = InterruptibleThread([this] { readAhead(); });
+        }
+        else
+        {
+            {
+                std::unique_lock<std::mutex> dummy(lockBackBuffer);
+                conditionBackBuffer.wait(dummy, [this] { return backBufferReady; }); //reader thread finishes each read
+
+                if (backBufferError)
+                    throw FileError(*backBufferError);
+                buffer.swap(backBuffer);
+                bytesRead = backBufferSize;
+                backBufferReady = false;
+            }
+            conditionBackBuffer.notify_all();
+        }
+        bufferPos  = 0;
+        bufferSize = bytesRead;
 
         //report bytes processed
         if (notifyProgress_)
@@ -67,85 +108,163 @@ struct StreamReader
         }
 
         if (bytesRead == 0)
-        {
             eof = true;
-            return;
-        }
+    }
 
-        size_t proposedBlockSize = 0;
-        const auto loopTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(stopTime - startTime).count();
+    const char* data() const { return &buffer[0] + bufferPos; }
+    size_t bytesAvailable() const { return bufferSize - bufferPos; }
+    void consume(size_t bytes) { assert(bytes <= bytesAvailable()); bufferPos += bytes; }
 
-        if (loopTimeMs >= 100)
-            lastDelayViolation = stopTime;
+    bool isEof() const { return eof; }
 
-        //avoid "flipping back": e.g. DVD-ROMs read 32MB at once, so first read may be > 500 ms, but second one will be 0ms!
-        if (stopTime >= lastDelayViolation + std::chrono::seconds(2))
+    void readToEof() //throw FileError; e.g. continue hashing after a difference was found
+    {
+        bufferPos = bufferSize;
+        while (!eof)
         {
-            lastDelayViolation = stopTime;
-            proposedBlockSize = dynamicBlockSize * 2;
+            readChunk(); //throw FileError
+            bufferPos = bufferSize;
         }
-        if (loopTimeMs > 500)
-            proposedBlockSize = dynamicBlockSize / 2;
+    }
+
+private:
+    StreamReader           (const StreamReader&) = delete;
+    StreamReader& operator=(const StreamReader&) = delete;
+
+    //context of calling thread before read-ahead is started, reader thread afterwards
+    size_t readBlock(std::vector<char>& buf) //throw FileError
+    {
+        if (buf.size() < dynamicBlockSize)
+            buf.resize(dynamicBlockSize); //grows with the block size only
+
+        const auto startTime = std::chrono::steady_clock::now();
 
-        if (defaultBlockSize <= proposedBlockSize && proposedBlockSize <= BLOCK_SIZE_MAX)
-            dynamicBlockSize = proposedBlockSize;
+        const size_t bytesRead = stream->tryRead(&buf[0], dynamicBlockSize); //throw FileError; may return short, only 0 means EOF! => CONTRACT: bytesToRead > 0
+
+        const auto stopTime = std::chrono::steady_clock::now();
+        lastReadTime = stopTime - startTime;
+
+        if (hasher_)
+            hasher_->update(&buf[0], bytesRead);
+
+        if (bytesRead > 0)
+        {
+            size_t proposedBlockSize = 0;
+            const auto loopTimeMs = std::chrono::duration_cast<std::chrono::milliseconds>(stopTime - startTime).count();
+
+            if (loopTimeMs >= 100)
+                lastDelayViolation = stopTime;
+
+            //avoid "flipping back": e.g. DVD-ROMs read 32MB at once, so first read may be > 500 ms, but second one will be 0ms!
+            if (stopTime >= lastDelayViolation + std::chrono::seconds(2))
+            {
+                lastDelayViolation = stopTime;
+                proposedBlockSize = dynamicBlockSize * 2;
+            }
+            if (loopTimeMs > 500)
+                proposedBlockSize = dynamicBlockSize / 2;
+
+            if (defaultBlockSize <= proposedBlockSize && proposedBlockSize <= BLOCK_SIZE_MAX)
+                dynamicBlockSize = proposedBlockSize;
+        }
+        return bytesRead;
     }
 
-    bool isEof() const { return eof; }
+    void readAhead() //throw ThreadInterruption; context of reader thread
+    {
+        for (;;)
+        {
+            {
+                std::unique_lock<std::mutex> dummy(lockBackBuffer);
+                interruptibleWait(conditionBackBuffer, dummy, [this] { return !backBufferReady; }); //throw ThreadInterruption
+            }
+
+            size_t bytesRead = 0;
+            Opt<FileError> error;
+            try
+            {
+                bytesRead = readBlock(backBuffer); //throw FileError
+            }
+            catch (const FileError& e) { error = e; }
+
+            {
+                std::lock_guard<std::mutex> dummy(lockBackBuffer);
+                backBufferSize  = bytesRead;
+                backBufferError = error;
+                backBufferReady = true;
+            }
+            conditionBackBuffer.notify_all();
+
+            if (error || bytesRead == 0)
+                return;
+        }
+    }
 
-private:
     const std::unique_ptr<AFS::InputStream> stream;
     const size_t defaultBlockSize;
     size_t dynamicBlockSize;
     const std::function<void(std::int64_t bytesDelta)> notifyProgress_;
     size_t& unevenBytes_;
+    Blake2bHash128* const hasher_; //optional
     std::chrono::steady_clock::time_point lastDelayViolation = std::chrono::steady_clock::now();
+    std::chrono::steady_clock::duration lastReadTime{}; //of the most recent readBlock()
     bool eof = false;
+
+    std::vector<char> buffer; //owned by calling thread
+    size_t bufferPos  = 0; //bytes consumed
+    size_t bufferSize = 0; //bytes read
+
+    //read-ahead: back buffer is owned by the reader thread while backBufferReady == false
+    std::mutex lockBackBuffer;
+    std::condition_variable conditionBackBuffer;
+    std::vector<char> backBuffer;
+    size_t backBufferSize = 0;
+    Opt<FileError> backBufferError;
+    bool backBufferReady = false;
+
+    InterruptibleThread readAheadThread; //joined by destructor: accesses all of the above
 };
-}
 
 
-bool zen::filesHaveSameContent(const AbstractPath& filePath1, const AbstractPath& filePath2, const std::function<void(std::int64_t bytesDelta)>& notifyProgress) //throw FileError
+bool filesHaveSameContentImpl(const AbstractPath& filePath1, const AbstractPath& filePath2, const std::function<void(std::int64_t bytesDelta)>& notifyProgress,
+                              Blake2bHash128* hasher1, Blake2bHash128* hasher2) //throw FileError
 {
     size_t unevenBytes = 0;
-    StreamReader reader1(filePath1, notifyProgress, unevenBytes); //throw FileError, (ErrorFileLocked)
-    StreamReader reader2(filePath2, notifyProgress, unevenBytes); //
+    StreamReader reader1(filePath1, notifyProgress, unevenBytes, hasher1); //throw FileError, (ErrorFileLocked)
+    StreamReader reader2(filePath2, notifyProgress, unevenBytes, hasher2); //
 
-    StreamReader* readerLow  = &reader1;
-    StreamReader* readerHigh = &reader2;
-
-    std::vector<char> bufferLow;
-    std::vector<char> bufferHigh;
-
-    for (;;)
+    auto haveDifferentContent = [&]
     {
-        const size_t bytesChecked = bufferLow.size();
-
-        readerLow->appendChunk(bufferLow); //throw FileError
-
-        if (bufferLow.size() > bufferHigh.size())
+        if (hasher1) //hashes are requested for the complete content
         {
-            bufferLow.swap(bufferHigh);
-            std::swap(readerLow, readerHigh);
+            reader1.readToEof(); //throw FileError
+            reader2.readToEof(); //
         }
+        return false;
+    };
 
-        if (!std::equal(bufferLow. begin() + bytesChecked, bufferLow.end(),
-                        bufferHigh.begin() + bytesChecked))
-            return false;
-
-        if (readerLow->isEof())
+    for (;;)
+    {
+        //streams may return short reads of different sizes: refill only the side that ran dry, compare the overlap in place
+        if (reader1.bytesAvailable() == 0 && !reader1.isEof())
+            reader1.readChunk(); //throw FileError
+        if (reader2.bytesAvailable() == 0 && !reader2.isEof())
+            reader2.readChunk(); //throw FileError
+
+        const size_t bytesToCompare = std::min(reader1.bytesAvailable(), reader2.bytesAvailable());
+        if (bytesToCompare == 0) //at least one stream is at EOF
         {
-            if (bufferLow.size() < bufferHigh.size())
-                return false;
-            if (readerHigh->isEof())
-                break;
-            //bufferLow.swap(bufferHigh); not needed
-            std::swap(readerLow, readerHigh);
+            if (reader1.bytesAvailable() != reader2.bytesAvailable())
+                return haveDifferentContent(); //throw FileError
+            break;
         }
 
-        //don't let sliding buffer grow too large
-        bufferHigh.erase(bufferHigh.begin(), bufferHigh.begin() + bufferLow.size());
-        bufferLow.clear();
+        //memcmp() is vectorized by the C runtime and stops at the first differing block
+        if (std::memcmp(reader1.data(), reader2.data(), bytesToCompare) != 0)
+            return haveDifferentContent(); //throw FileError
+
+        reader1.consume(bytesToCompare);
+        reader2.consume(bytesToCompare);
     }
 
     if (unevenBytes != 0)
@@ -153,3 +272,110 @@ bool zen::filesHaveSameContent(const AbstractPath& filePath1, const AbstractPath
 
     return true;
 }
+
+
+//empty if the file is small enough to be compared completely
+std::vector<std::uint64_t> getSampleOffsets(std::uint64_t fileSize, size_t sampleBlocks)
+{
+    std::vector<std::uint64_t> offsets;
+    if (fileSize > (sampleBlocks + 2) * SAMPLE_BLOCK_SIZE)
+    {
+        offsets.push_back(0);
+        for (size_t i = 1; i <= sampleBlocks; ++i) //evenly spaced, aligned to SAMPLE_BLOCK_SIZE
+            offsets.push_back((fileSize - SAMPLE_BLOCK_SIZE) * i / (sampleBlocks + 1) / SAMPLE_BLOCK_SIZE * SAMPLE_BLOCK_SIZE);
+        offsets.push_back(fileSize - SAMPLE_BLOCK_SIZE); //tail: detect truncation
+    }
+    return offsets;
+}
+
+
+size_t readBlock(AFS::InputStream& stream, char* buffer, size_t bytesToRead) //throw FileError; returns short only at EOF
+{
+    size_t bytesRead = 0;
+    while (bytesRead < bytesToRead)
+    {
+        const size_t bytesDelta = stream.tryRead(buffer + bytesRead, bytesToRead - bytesRead); //throw FileError; may return short, only 0 means EOF!
+        if (bytesDelta == 0)
+            break;
+        bytesRead += bytesDelta;
+    }
+    return bytesRead;
+}
+}
+
+
+bool zen::filesHaveSameContent(const AbstractPath& filePath1, const AbstractPath& filePath2, const std::function<void(std::int64_t bytesDelta)>& notifyProgress) //throw FileError
+{
+    return filesHaveSameContentImpl(filePath1, filePath2, notifyProgress, nullptr, nullptr); //throw FileError
+}
+
+
+bool zen::filesHaveSameContent(const AbstractPath& filePath1, const AbstractPath& filePath2, const std::function<void(std::int64_t bytesDelta)>& notifyProgress,
+                               Hash128& hash1, Hash128& hash2) //throw FileError
+{
+    Blake2bHash128 hasher1;
+    Blake2bHash128 hasher2;
+    const bool sameContent = filesHaveSameContentImpl(filePath1, filePath2, notifyProgress, &hasher1, &hasher2); //throw FileError
+
+    hash1 = hasher1.finalize();
+    hash2 = hasher2.finalize();
+    return sameContent;
+}
+
+
+Hash128 zen::getFileContentHash(const AbstractPath& filePath, const std::function<void(std::int64_t bytesDelta)>& notifyProgress) //throw FileError
+{
+    //a single sequential stream: no need for dynamic block sizes to limit seeking between two files
+    const std::unique_ptr<AFS::InputStream> stream = AFS::getInputStream(filePath); //throw FileError, (ErrorFileLocked)
+    std::vector<char> buffer(stream->getBlockSize());
+
+    Blake2bHash128 hasher;
+    for (;;)
+    {
+        const size_t bytesRead = stream->tryRead(&buffer[0], buffer.size()); //throw FileError; may return short, only 0 means EOF! => CONTRACT: bytesToRead > 0
+        if (notifyProgress)
+            notifyProgress(bytesRead); //throw X!
+        if (bytesRead == 0)
+            return hasher.finalize();
+
+        hasher.update(&buffer[0], bytesRead);
+    }
+}
+
+
+bool zen::filesHaveSameSampledContent(const AbstractPath& filePath1, const AbstractPath& filePath2, std::uint64_t fileSize, size_t sampleBlocks,
+                                      const std::function<void(std::int64_t bytesDelta)>& notifyProgress) //throw FileError
+{
+    const std::vector<std::uint64_t> offsets = getSampleOffsets(fileSize, sampleBlocks);
+    if (offsets.empty())
+        return filesHaveSameContent(filePath1, filePath2, notifyProgress); //throw FileError
+
+    const std::unique_ptr<AFS::InputStream> stream1 = AFS::getInputStream(filePath1); //throw FileError, (ErrorFileLocked)
+    const std::unique_ptr<AFS::InputStream> stream2 = AFS::getInputStream(filePath2); //
+
+    std::vector<char> buffer1(SAMPLE_BLOCK_SIZE);
+    std::vector<char> buffer2(SAMPLE_BLOCK_SIZE);
+
+    for (const std::uint64_t offset : offsets)
+    {
+        stream1->seek(offset); //throw FileError
+        stream2->seek(offset); //
+        const size_t bytesRead1 = readBlock(*stream1, &buffer1[0], SAMPLE_BLOCK_SIZE); //throw FileError
+        const size_t bytesRead2 = readBlock(*stream2, &buffer2[0], SAMPLE_BLOCK_SIZE); //
+
+        if (notifyProgress)
+            notifyProgress((bytesRead1 + bytesRead2) / 2); //throw X!
+
+        if (bytesRead1 != bytesRead2 || //file size changed since scanning
+            std::memcmp(&buffer1[0], &buffer2[0], bytesRead1) != 0)
+            return false;
+    }
+    return true;
+}
+
+
+std::uint64_t zen::getSampledContentSize(std::uint64_t fileSize, size_t sampleBlocks)
+{
+    const std::vector<std::uint64_t> offsets = getSampleOffsets(fileSize, sampleBlocks);
+    return offsets.empty() ? fileSize : offsets.size() * SAMPLE_BLOCK_SIZE;
+}
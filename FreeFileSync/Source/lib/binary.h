@@ -7,6 +7,7 @@
 #ifndef BINARY_H_3941281398513241134
 #define BINARY_H_3941281398513241134
 
+#include <zen/blake2b.h>
 #include "../fs/abstract.h"
 
 
@@ -15,6 +16,26 @@ namespace zen
 bool filesHaveSameContent(const AbstractPath& filePath1, //throw FileError
                           const AbstractPath& filePath2,
                           const std::function<void(std::int64_t bytesDelta)>& notifyProgress); //may be nullptr
+
+//same, but also hash both files: reads the complete content even if a difference is found early
+bool filesHaveSameContent(const AbstractPath& filePath1, //throw FileError
+                          const AbstractPath& filePath2,
+                          const std::function<void(std::int64_t bytesDelta)>& notifyProgress, //may be nullptr
+                          Hash128& hash1,  //out
+                          Hash128& hash2); //
+
+Hash128 getFileContentHash(const AbstractPath& filePath, //throw FileError
+                           const std::function<void(std::int64_t bytesDelta)>& notifyProgress); //may be nullptr
+
+//quick check for huge files: compare head, tail and "sampleBlocks" evenly spaced blocks in between => detects truncation and most cases of bit rot
+//small files are compared completely
+bool filesHaveSameSampledContent(const AbstractPath& filePath1, //throw FileError
+                                 const AbstractPath& filePath2,
+                                 std::uint64_t fileSize, //both files have the same size
+                                 size_t sampleBlocks,
+                                 const std::function<void(std::int64_t bytesDelta)>& notifyProgress); //may be nullptr
+
+std::uint64_t getSampledContentSize(std::uint64_t fileSize, size_t sampleBlocks); //bytes read per file
 }
 
 #endif //BINARY_H_3941281398513241134
@@ -0,0 +1,154 @@
+// *****************************************************************************
+// * This file is part of the FreeFileSync project. It is distributed under    *
+// * GNU General Public License: http://www.gnu.org/licenses/gpl-3.0           *
+// * Copyright (C) Zenju (zenju AT freefilesync DOT org) - All Rights Reserved *
+// *****************************************************************************
+
+#include "content_hash_cache.h"
+#include <zen/file_access.h>
+#include <zen/file_io.h>
+#include <zen/scope_guard.h>
+#include <wx+/zlib_wrap.h>
+#include "ffs_paths.h"
+
+using namespace zen;
+using AFS = AbstractFileSystem;
+
+
+namespace
+{
+//-------------------------------------------------------------------------------------------------------------------------------
+const char FILE_FORMAT_DESCR[] = "FreeFileSync";
+const int HASH_CACHE_FORMAT_VER = 2; //2: BLAKE2b instead of MurmurHash3
+//-------------------------------------------------------------------------------------------------------------------------------
+
+using MemStreamOut = MemoryStreamOut<ByteArray>;
+using MemStreamIn  = MemoryStreamIn <ByteArray>;
+
+//-----------------------------------------------------------------------------------
+//| ensure 32/64 bit portability: use fixed size data types only e.g. std::uint32_t |
+//-----------------------------------------------------------------------------------
+
+Zstring getCacheFilePath(const AbstractPath& baseFolderPath)
+{
+    const std::string pathPhrase = utfCvrtTo<std::string>(AFS::getInitPathPhrase(baseFolderPath));
+
+    Blake2bHash128 hasher;
+    hasher.update(pathPhrase.c_str(), pathPhrase.size());
+    const std::uint64_t hash = hasher.finalize().low; //collisions are detected when loading
+
+    Zstring fileName;
+    for (int i = 60; i >= 0; i -= 4)
+        fileName += "0123456789abcdef"[(hash >> i) & 0xf];
+
+    return getConfigDir() + Zstr("ContentHashes") + FILE_NAME_SEPARATOR + fileName + CONTENT_HASH_FILE_ENDING;
+}
+
+
+void writeUtf8(MemStreamOut& output, const Zstring& str) { writeContainer(output, utfCvrtTo<Zbase<char>>(str)); }
+
+Zstring readUtf8(MemStreamIn& input) { return utfCvrtTo<Zstring>(readContainer<Zbase<char>>(input)); } //throw UnexpectedEndOfStreamError
+}
+
+
+void zen::saveContentHashCache(const AbstractPath& baseFolderPath, const ContentHashCache& cache) //throw FileError
+{
+    const Zstring filePath = getCacheFilePath(baseFolderPath);
+
+    MemStreamOut streamFiles;
+    writeNumber<std::uint32_t>(streamFiles, static_cast<std::uint32_t>(cache.size()));
+    for (const auto& file : cache)
+    {
+        writeUtf8(streamFiles, file.first);
+        writeContainer(streamFiles, file.second.fileId);
+        static_assert(IsSameType<decltype(file.second.fileId), Zbase<char>>::value, "");
+        writeNumber<std::uint64_t>(streamFiles, file.second.fileSize);
+        writeNumber<std::int64_t >(streamFiles, file.second.lastWriteTime);
+        writeNumber<std::uint64_t>(streamFiles, file.second.hash.low);
+        writeNumber<std::uint64_t>(streamFiles, file.second.hash.high);
+    }
+
+    ByteArray fileData;
+    try
+    {
+        fileData = compress(streamFiles.ref(), 3); //throw ZlibInternalError; level 3: see db_file.cpp
+    }
+    catch (ZlibInternalError&)
+    {
+        throw FileError(replaceCpy(_("Cannot write file %x."), L"%x", fmtPath(filePath)), L"zlib internal error");
+    }
+
+    MemStreamOut streamOut;
+    writeArray(streamOut, FILE_FORMAT_DESCR, sizeof(FILE_FORMAT_DESCR));
+    writeNumber<std::int32_t>(streamOut, HASH_CACHE_FORMAT_VER);
+    writeUtf8(streamOut, AFS::getInitPathPhrase(baseFolderPath));
+    writeContainer<ByteArray>(streamOut, fileData);
+
+    makeDirectoryRecursively(beforeLast(filePath, FILE_NAME_SEPARATOR, IF_MISSING_RETURN_NONE)); //throw FileError
+
+    //write as a transaction: don't leave a truncated cache behind
+    const Zstring tmpFilePath = filePath + Zstr(".tmp");
+
+    saveBinContainer(tmpFilePath, streamOut.ref(), nullptr); //throw FileError
+    ZEN_ON_SCOPE_FAIL(try { removeFile(tmpFilePath); }
+    catch (FileError&) {});
+
+    removeFile(filePath); //throw FileError
+    renameFile(tmpFilePath, filePath); //throw FileError, ErrorDifferentVolume, ErrorTargetExisting
+}
+
+
+ContentHashCache zen::loadContentHashCache(const AbstractPath& baseFolderPath) //throw FileError
+{
+    const Zstring filePath = getCacheFilePath(baseFolderPath);
+
+    if (!fileExists(filePath))
+        return ContentHashCache();
+
+    try
+    {
+        const ByteArray buffer = loadBinContainer<ByteArray>(filePath, nullptr); //throw FileError
+        MemStreamIn streamIn(buffer);
+
+        char formatDescr[sizeof(FILE_FORMAT_DESCR)] = {};
+        readArray(streamIn, formatDescr, sizeof(formatDescr)); //throw UnexpectedEndOfStreamError
+
+        if (!std::equal(FILE_FORMAT_DESCR, FILE_FORMAT_DESCR + sizeof(FILE_FORMAT_DESCR), formatDescr) ||
+            readNumber<std::int32_t>(streamIn) != HASH_CACHE_FORMAT_VER) //throw UnexpectedEndOfStreamError
+            return ContentHashCache(); //outdated cache: just read all files once
+
+        if (readUtf8(streamIn) != AFS::getInitPathPhrase(baseFolderPath)) //throw UnexpectedEndOfStreamError
+            return ContentHashCache(); //hash collision
+
+        ByteArray fileData;
+        try
+        {
+            fileData = decompress(readContainer<ByteArray>(streamIn)); //throw UnexpectedEndOfStreamError, ZlibInternalError
+        }
+        catch (ZlibInternalError&)
+        {
+            throw FileError(replaceCpy(_("Cannot read file %x."), L"%x", fmtPath(filePath)), L"zlib internal error");
+        }
+        MemStreamIn streamFiles(fileData);
+
+        ContentHashCache cache;
+
+        size_t fileCount = readNumber<std::uint32_t>(streamFiles); //throw UnexpectedEndOfStreamError
+        while (fileCount-- != 0)
+        {
+            const Zstring relPath = readUtf8(streamFiles);
+            CachedContentHash& file = cache[relPath];
+
+            file.fileId        = readContainer<Zbase<char>>(streamFiles);
+            file.fileSize      = readNumber<std::uint64_t>(streamFiles);
+            file.lastWriteTime = readNumber<std::int64_t >(streamFiles);
+            file.hash.low      = readNumber<std::uint64_t>(streamFiles);
+            file.hash.high     = readNumber<std::uint64_t>(streamFiles);
+        }
+        return cache;
+    }
+    catch (UnexpectedEndOfStreamError&)
+    {
+        throw FileError(replaceCpy(_("Cannot read file %x."), L"%x", fmtPath(filePath)), L"Unexpected end of stream.");
+    }
+}
@@ -0,0 +1,49 @@
+// *****************************************************************************
+// * This file is part of the FreeFileSync project. It is distributed under    *
+// * GNU General Public License: http://www.gnu.org/licenses/gpl-3.0           *
+// * Copyright (C) Zenju (zenju AT freefilesync DOT org) - All Rights Reserved *
+// *****************************************************************************
+
+#ifndef CONTENT_HASH_CACHE_H_2093847502938475023
+#define CONTENT_HASH_CACHE_H_2093847502938475023
+
+#include <map>
+#include <zen/optional.h>
+#include <zen/blake2b.h>
+#include <zen/file_error.h>
+#include "../fs/abstract.h"
+
+
+namespace zen
+{
+const Zchar CONTENT_HASH_FILE_ENDING[] = Zstr(".ffs_hash"); //don't use Zstring as global constant: avoid static initialization order problem in global namespace!
+
+//hash of the file content as of the last comparison by content: valid as long as file id, size and modification time are unchanged
+struct CachedContentHash
+{
+    AbstractFileSystem::FileId fileId; //optional: empty if not supported!
+    std::uint64_t fileSize = 0;
+    std::int64_t lastWriteTime = 0;
+    Hash128 hash;
+};
+
+using ContentHashCache = std::map<Zstring, CachedContentHash, LessFilePath>; //key: file path relative to base folder
+
+inline
+Opt<Hash128> getCachedContentHash(const ContentHashCache& cache, const Zstring& relPath, const AbstractFileSystem::FileId& fileId, std::uint64_t fileSize, std::int64_t lastWriteTime)
+{
+    auto it = cache.find(relPath);
+    if (it != cache.end() &&
+        it->second.fileId        == fileId   && //file replaced, e.g. by a copy preserving size and modification time
+        it->second.fileSize      == fileSize &&
+        it->second.lastWriteTime == lastWriteTime)
+        return it->second.hash;
+    return NoValue();
+}
+
+//caches are stored in the config folder, one per base folder
+ContentHashCache loadContentHashCache(const AbstractPath& baseFolderPath); //throw FileError; return empty cache if not existing
+void             saveContentHashCache(const AbstractPath& baseFolderPath, const ContentHashCache& cache); //throw FileError
+}
+
+#endif //CONTENT_HASH_CACHE_H_2093847502938475023
@@ -5,6 +5,7 @@
 // *****************************************************************************
 
 #include "db_file.h"
+#include <unordered_set>
 #include <zen/guid.h>
 #include <wx+/zlib_wrap.h>
 
@@ -21,7 +22,7 @@ namespace
 //-------------------------------------------------------------------------------------------------------------------------------
 const char FILE_FORMAT_DESCR[] = "FreeFileSync";
 const int DB_FORMAT_CONTAINER = 9;
-const int DB_FORMAT_STREAM    = 2; //since 2015-05-02
+const int DB_FORMAT_STREAM    = 3; //since 2026-10-16: file change time
 //-------------------------------------------------------------------------------------------------------------------------------
 
 using UniqueId  = std::string;
@@ -263,6 +264,7 @@ private:
         writeNumber<std:: int64_t>(output, descr.lastWriteTimeRaw);
         writeContainer(output, descr.fileId);
         static_assert(IsSameType<decltype(descr.fileId), Zbase<char>>::value, "");
+        writeNumber<std:: int64_t>(output, descr.changeTimeRaw);
     }
 
     static void writeLink(MemStreamOut& output, const InSyncDescrLink& descr)
@@ -309,6 +311,7 @@ public:
 
             warn_static("remove check for stream version 1 after migration! 2015-05-02")
             if (streamVersionL != 1 &&
+                streamVersionL != 2 &&
                 streamVersionL != DB_FORMAT_STREAM)
                 throw FileError(replaceCpy(_("Database file %x is incompatible."), L"%x", fmtPath(displayFilePathL)), L"unknown stream format");
 
@@ -418,7 +421,11 @@ private:
 
             fileId = readContainer<Zbase<char>>(input);
 
-        return InSyncDescrFile(lastWriteTimeRaw, fileId);
+        std::int64_t changeTimeRaw = 0; //unknown for older streams
+        if (streamVersion_ >= 3)
+            changeTimeRaw = readNumber<std::int64_t>(input);
+
+        return InSyncDescrFile(lastWriteTimeRaw, fileId, changeTimeRaw);
     }
 
     static InSyncDescrLink readLink(MemStreamIn& input)
@@ -521,9 +528,11 @@ private:
                     //create or update new "in-sync" state
                     InSyncFile& dbFile = updateItem(dbFiles, file.getPairItemName(),
                                                     InSyncFile(InSyncDescrFile(file.getLastWriteTime< LEFT_SIDE>(),
-                                                                               file.getFileId       < LEFT_SIDE>()),
+                                                                               file.getFileId       < LEFT_SIDE>(),
+                                                                               file.getChangeTime   < LEFT_SIDE>()),
                                                                InSyncDescrFile(file.getLastWriteTime<RIGHT_SIDE>(),
-                                                                               file.getFileId       <RIGHT_SIDE>()),
+                                                                               file.getFileId       <RIGHT_SIDE>(),
+                                                                               file.getChangeTime   <RIGHT_SIDE>()),
                                                                activeCmpVar_,
                                                                file.getFileSize<LEFT_SIDE>()));
                     toPreserve.insert(&dbFile);
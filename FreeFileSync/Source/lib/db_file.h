@@ -17,12 +17,14 @@ const Zchar SYNC_DB_FILE_ENDING[] = Zstr(".ffs_db"); //don't use Zstring as glob
 
 struct InSyncDescrFile //subset of FileDescriptor
 {
-    InSyncDescrFile(std::int64_t lastWriteTimeRawIn, const AFS::FileId& idIn) :
+    InSyncDescrFile(std::int64_t lastWriteTimeRawIn, const AFS::FileId& idIn, std::int64_t changeTimeRawIn) :
         lastWriteTimeRaw(lastWriteTimeRawIn),
-        fileId(idIn) {}
+        fileId(idIn),
+        changeTimeRaw(changeTimeRawIn) {}
 
     std::int64_t lastWriteTimeRaw;
     AFS::FileId fileId; // == file id: optional! (however, always set on Linux, and *generally* available on Windows)
+    std::int64_t changeTimeRaw; //optional: 0 if unknown
 };
 
 struct InSyncDescrLink
@@ -0,0 +1,91 @@
+// *****************************************************************************
+// * This file is part of the FreeFileSync project. It is distributed under    *
+// * GNU General Public License: http://www.gnu.org/licenses/gpl-3.0           *
+// * Copyright (C) Zenju (zenju AT freefilesync DOT org) - All Rights Reserved *
+// *****************************************************************************
+
+#ifndef DISK_ORDER_H_2389475023984752
+#define DISK_ORDER_H_2389475023984752
+
+#include <vector>
+#include <numeric>
+#include <algorithm>
+#include <chrono>
+#include <cassert>
+#include <zen/i18n.h>
+#include <zen/string_tools.h>
+
+
+namespace zen
+{
+//spinning disks: access files in the order of their physical location (AFS::getDiskLocation()) instead of hierarchy order to avoid seeking back and forth
+
+//permutation of indexes into "locations": stable, items of unknown location (0) keep their relative order
+std::vector<size_t> getDiskOrder(const std::vector<std::uint64_t>& locations);
+
+template <class T>
+void applyDiskOrder(std::vector<T>& items, const std::vector<size_t>& order);
+
+//log message: estimated seek distance of disk order compared to hierarchy order
+std::wstring getDiskOrderReport(const std::vector<std::uint64_t>& locations, const std::vector<size_t>& order, std::chrono::milliseconds lookupTime);
+
+
+
+
+
+
+
+
+//------------------------------------ implementation -----------------------------------------
+inline
+std::vector<size_t> getDiskOrder(const std::vector<std::uint64_t>& locations)
+{
+    std::vector<size_t> order(locations.size());
+    std::iota(order.begin(), order.end(), 0);
+    std::stable_sort(order.begin(), order.end(), [&](size_t lhs, size_t rhs) { return locations[lhs] < locations[rhs]; });
+    return order;
+}
+
+
+template <class T> inline
+void applyDiskOrder(std::vector<T>& items, const std::vector<size_t>& order)
+{
+    assert(items.size() == order.size());
+    std::vector<T> output;
+    output.reserve(items.size());
+    for (size_t i : order)
+        output.push_back(std::move(items[i]));
+    items.swap(output);
+}
+
+
+inline
+std::wstring getDiskOrderReport(const std::vector<std::uint64_t>& locations, const std::vector<size_t>& order, std::chrono::milliseconds lookupTime)
+{
+    //sum of distances between consecutive known locations: rough estimate of the head movement
+    auto getSeekDistance = [&](auto getLocation)
+    {
+        double distance = 0; //double: sum may exceed 64 bit
+        std::uint64_t lastLocation = 0;
+        for (size_t i = 0; i < locations.size(); ++i)
+            if (const std::uint64_t location = getLocation(i))
+            {
+                if (lastLocation != 0)
+                    distance += location > lastLocation ? location - lastLocation : lastLocation - location;
+                lastLocation = location;
+            }
+        return distance;
+    };
+    const double distHierarchy = getSeekDistance([&](size_t i) { return locations[i]; });
+    const double distDiskOrder = getSeekDistance([&](size_t i) { return locations[order[i]]; });
+
+    const int percent = distHierarchy > 0 ? static_cast<int>(distDiskOrder * 100 / distHierarchy + 0.5) : 100;
+
+    return replaceCpy(replaceCpy(replaceCpy(_("Ordered %x files by disk location in %y ms: estimated seek distance %z% of hierarchy order"),
+                                            L"%x", numberTo<std::wstring>(locations.size())),
+                                 L"%y", numberTo<std::wstring>(lookupTime.count())),
+                      L"%z", numberTo<std::wstring>(percent));
+}
+}
+
+#endif //DISK_ORDER_H_2389475023984752
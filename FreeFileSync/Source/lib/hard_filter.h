@@ -9,6 +9,7 @@
 
 #include <vector>
 #include <memory>
+#include <algorithm>
 #include <zen/zstring.h>
 
 namespace zen
@@ -21,11 +22,11 @@ Semantics of HardFilter:
 
     class hierarchy:
 
-           HardFilter (interface)
-               /|\
-       _________|_____________
-      |         |             |
-NullFilter  NameFilter  CombinedFilter
+                 HardFilter (interface)
+                        /|\
+       __________________|__________________
+      |             |             |          |
+NullFilter     NameFilter   CombinedFilter  UnionFilter
 */
 
 class HardFilter //interface for filtering
@@ -116,6 +117,23 @@ private:
 };
 
 
+class UnionFilter : public HardFilter  //combine filters to match if and only if at least one matches, e.g. traverse a folder once for multiple folder pairs
+{
+public:
+    UnionFilter(const std::vector<FilterRef>& filters) : filters_(filters) { assert(filters.size() >= 2); } //use unionFilters() for construction
+
+    bool passFileFilter(const Zstring& relFilePath) const override;
+    bool passDirFilter(const Zstring& relDirPath, bool* childItemMightMatch) const override;
+    bool isNull() const override;
+    FilterRef copyFilterAddingExclusion(const Zstring& excludePhrase) const override;
+
+private:
+    bool cmpLessSameType(const HardFilter& other) const override;
+
+    const std::vector<FilterRef> filters_; //always bound!
+};
+
+
 
 
 
@@ -234,6 +252,79 @@ HardFilter::FilterRef constructFilter(const Zstring& includePhrase,
 }
 
 
+inline
+bool UnionFilter::passFileFilter(const Zstring& relFilePath) const
+{
+    return std::any_of(filters_.begin(), filters_.end(), [&](const FilterRef& filter) { return filter->passFileFilter(relFilePath); });
+}
+
+
+inline
+bool UnionFilter::passDirFilter(const Zstring& relDirPath, bool* childItemMightMatch) const
+{
+    assert(!childItemMightMatch || *childItemMightMatch == true); //check correct usage
+
+    bool anyChildItemMightMatch = false;
+    for (const FilterRef& filter : filters_)
+    {
+        bool childItemMightMatchTmp = true;
+        if (filter->passDirFilter(relDirPath, childItemMightMatch ? &childItemMightMatchTmp : nullptr))
+            return true;
+        anyChildItemMightMatch |= childItemMightMatchTmp;
+    }
+
+    if (childItemMightMatch)
+        *childItemMightMatch = anyChildItemMightMatch;
+    return false;
+}
+
+
+inline
+bool UnionFilter::isNull() const
+{
+    return std::any_of(filters_.begin(), filters_.end(), [](const FilterRef& filter) { return filter->isNull(); });
+}
+
+
+inline
+HardFilter::FilterRef UnionFilter::copyFilterAddingExclusion(const Zstring& excludePhrase) const
+{
+    std::vector<FilterRef> filtersTmp;
+    for (const FilterRef& filter : filters_)
+        filtersTmp.push_back(filter->copyFilterAddingExclusion(excludePhrase));
+
+    return std::make_shared<UnionFilter>(filtersTmp);
+}
+
+
+inline
+bool UnionFilter::cmpLessSameType(const HardFilter& other) const
+{
+    assert(typeid(*this) == typeid(other)); //always given in this context!
+
+    const UnionFilter& otherUnionFilt = static_cast<const UnionFilter&>(other);
+
+    return std::lexicographical_compare(filters_.begin(), filters_.end(),
+                                        otherUnionFilt.filters_.begin(), otherUnionFilt.filters_.end(),
+                                        [](const FilterRef& lhs, const FilterRef& rhs) { return *lhs < *rhs; });
+}
+
+
+inline
+HardFilter::FilterRef unionFilters(const std::vector<HardFilter::FilterRef>& filters) //filters: unique items, at least one
+{
+    assert(!filters.empty());
+
+    if (std::any_of(filters.begin(), filters.end(), [](const HardFilter::FilterRef& filter) { return filter->isNull(); }))
+        return std::make_shared<NullFilter>();
+
+    if (filters.size() == 1)
+        return filters[0];
+
+    return std::make_shared<UnionFilter>(filters);
+}
+
+
 std::vector<Zstring> splitByDelimiter(const Zstring& filterString); //keep external linkage for unit test
 }
 
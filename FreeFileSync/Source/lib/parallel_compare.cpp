@@ -0,0 +1,345 @@
+// *****************************************************************************
+// * This file is part of the FreeFileSync project. It is distributed under    *
+// * GNU General Public License: http://www.gnu.org/licenses/gpl-3.0           *
+// * Copyright (C) Zenju (zenju AT freefilesync DOT org) - All Rights Reserved *
+// *****************************************************************************
+
+#include "parallel_compare.h"
+#include <deque>
+#include <atomic>
+#include <zen/thread.h>
+#include <zen/fixed_list.h>
+#include "binary.h"
+
+using namespace zen;
+
+
+namespace
+{
+//large files are read in BLOCK_SIZE_MAX-sized chunks by filesHaveSameContent(): a few streams suffice to keep the device busy
+const std::uint64_t LARGE_FILE_SIZE = 16 * 1024 * 1024;
+
+//smaller files: reading them costs about as much as querying their data extents
+const std::uint64_t SHARED_EXTENTS_MIN_SIZE = 64 * 1024;
+
+
+inline
+std::uint64_t getBytesToRead(const ContentCompareJob& job) //per file, if both are equal
+{
+    return job.sampleBlocks > 0 ? getSampledContentSize(job.fileSize, job.sampleBlocks) : job.fileSize;
+}
+
+
+struct CompletedJob
+{
+    size_t jobIdx = 0;
+    bool haveSameContent = false;
+    Opt<std::wstring> errorMsg;
+    Opt<Hash128> hash1;
+    Opt<Hash128> hash2;
+    bool sharedExtents = false;
+    std::int64_t bytesReported = 0; //by the attempt that completed
+};
+
+
+class JobScheduler //shared by worker threads and the main thread
+{
+public:
+    JobScheduler(const std::vector<ContentCompareJob>& jobs, const std::vector<ContentCompareDevice>& devices) :
+        jobs_(jobs),
+        devices_(devices),
+        deviceStatus(devices.size())
+    {
+        for (size_t jobIdx = 0; jobIdx < jobs.size(); ++jobIdx)
+            pushJob(jobIdx);
+    }
+
+    //context of worker thread: wait until some device has capacity for one of its pending jobs; return false if all jobs are done
+    bool popJob(size_t& jobIdx) //throw ThreadInterruption
+    {
+        std::unique_lock<std::mutex> dummy(lockJobs);
+        for (;;)
+        {
+            //round-robin: don't let the first device pair starve the others
+            for (size_t i = 0; i < deviceStatus.size(); ++i)
+            {
+                const size_t deviceIdx = (nextDevice + i) % deviceStatus.size();
+                DeviceStatus& ds = deviceStatus[deviceIdx];
+                const ContentCompareDevice& dev = devices_[deviceIdx];
+
+                if (ds.activeJobs < dev.maxJobs)
+                {
+                    //prefer large files: start long-running jobs early, fill the remaining capacity with small files
+                    std::deque<size_t>* queue = !ds.pendingLarge.empty() && ds.activeLargeJobs < dev.maxLargeJobs ? &ds.pendingLarge :
+                                                !ds.pendingSmall.empty() ? &ds.pendingSmall : nullptr;
+                    if (queue)
+                    {
+                        jobIdx = queue->front();
+                        queue->pop_front();
+
+                        ++ds.activeJobs;
+                        if (isLargeJob(jobIdx))
+                            ++ds.activeLargeJobs;
+
+                        nextDevice = (deviceIdx + 1) % deviceStatus.size();
+                        lastStartedJob = jobIdx;
+                        return true;
+                    }
+                }
+            }
+
+            if (jobsOutstanding == 0)
+                return false;
+
+            //wait for another job to finish (device capacity) or for a "retry" from the main thread
+            interruptibleWait(conditionJobsChanged, dummy, [this, changeCount = changeCount_] { return changeCount_ != changeCount; }); //throw ThreadInterruption
+        }
+    }
+
+    //context of worker thread
+    void jobDone(CompletedJob&& result)
+    {
+        {
+            std::lock_guard<std::mutex> dummy(lockJobs);
+
+            DeviceStatus& ds = deviceStatus[jobs_[result.jobIdx].deviceIdx];
+            assert(ds.activeJobs > 0);
+            --ds.activeJobs;
+            if (isLargeJob(result.jobIdx))
+                --ds.activeLargeJobs;
+
+            completedJobs.push_back(std::move(result));
+            ++changeCount_;
+        }
+        conditionJobsChanged.notify_all();
+    }
+
+    void reportBytes(std::int64_t bytesDelta) { bytesProcessed += bytesDelta; } //context of worker thread
+
+    //context of main thread
+    std::vector<CompletedJob> waitForCompletedJobs(size_t maxWaitMs)
+    {
+        std::unique_lock<std::mutex> dummy(lockJobs);
+        conditionJobsChanged.wait_for(dummy, std::chrono::milliseconds(maxWaitMs), [this] { return !completedJobs.empty(); });
+
+        std::vector<CompletedJob> output;
+        output.swap(completedJobs);
+        return output;
+    }
+
+    //context of main thread: either retry a failed job or declare it done
+    void retryJob(size_t jobIdx)
+    {
+        {
+            std::lock_guard<std::mutex> dummy(lockJobs);
+            pushJob(jobIdx);
+            ++changeCount_;
+        }
+        conditionJobsChanged.notify_all();
+    }
+
+    void finishJob()
+    {
+        {
+            std::lock_guard<std::mutex> dummy(lockJobs);
+            assert(jobsOutstanding > 0);
+            if (--jobsOutstanding != 0)
+                return;
+            ++changeCount_;
+        }
+        conditionJobsChanged.notify_all(); //last job: let idle workers exit
+    }
+
+    std::int64_t getBytesProcessed() const { return bytesProcessed; }
+
+    size_t getLastStartedJob() const
+    {
+        std::lock_guard<std::mutex> dummy(lockJobs);
+        return lastStartedJob;
+    }
+
+private:
+    JobScheduler           (const JobScheduler&) = delete;
+    JobScheduler& operator=(const JobScheduler&) = delete;
+
+    struct DeviceStatus
+    {
+        std::deque<size_t> pendingSmall;
+        std::deque<size_t> pendingLarge;
+        size_t activeJobs      = 0;
+        size_t activeLargeJobs = 0;
+    };
+
+    bool isLargeJob(size_t jobIdx) const { return getBytesToRead(jobs_[jobIdx]) >= LARGE_FILE_SIZE; }
+
+    void pushJob(size_t jobIdx) //lockJobs must be held
+    {
+        DeviceStatus& ds = deviceStatus[jobs_[jobIdx].deviceIdx];
+        (isLargeJob(jobIdx) ? ds.pendingLarge : ds.pendingSmall).push_back(jobIdx);
+    }
+
+    const std::vector<ContentCompareJob>& jobs_;
+    const std::vector<ContentCompareDevice>& devices_;
+
+    mutable std::mutex lockJobs;
+    std::condition_variable conditionJobsChanged;
+    std::vector<DeviceStatus> deviceStatus;
+    size_t nextDevice = 0;
+    size_t jobsOutstanding = jobs_.size(); //pending, running, or waiting for a response to an error
+    size_t changeCount_ = 0;
+    size_t lastStartedJob = 0;
+    std::vector<CompletedJob> completedJobs;
+
+    std::atomic<std::int64_t> bytesProcessed { 0 };
+};
+
+
+void compareWorker(JobScheduler& scheduler, const std::vector<ContentCompareJob>& jobs) //throw ThreadInterruption
+{
+    for (size_t jobIdx = 0; scheduler.popJob(jobIdx); ) //throw ThreadInterruption
+    {
+        const ContentCompareJob& job = jobs[jobIdx];
+
+        CompletedJob result;
+        result.jobIdx = jobIdx;
+
+        auto notifyProgress = [&](std::int64_t bytesDelta)
+        {
+            interruptionPoint(); //throw ThreadInterruption
+            result.bytesReported += bytesDelta;
+            scheduler.reportBytes(bytesDelta);
+        };
+
+        try
+        {
+            assert(!job.knownHash1 || !job.knownHash2);
+            assert(job.sampleBlocks == 0 || (!job.computeHashes && !job.knownHash1 && !job.knownHash2));
+            if (job.fileSize >= SHARED_EXTENTS_MIN_SIZE && AbstractFileSystem::haveSharedExtents(job.filePath1, job.filePath2)) //noexcept; reflink copy, snapshot, ...
+            {
+                result.haveSameContent = true;
+                result.sharedExtents   = true;
+            }
+            else if (job.sampleBlocks > 0)
+                result.haveSameContent = filesHaveSameSampledContent(job.filePath1, job.filePath2, job.fileSize, job.sampleBlocks, notifyProgress); //throw FileError, ThreadInterruption
+            else if (job.knownHash1)
+            {
+                result.hash2 = getFileContentHash(job.filePath2, notifyProgress); //throw FileError, ThreadInterruption
+                result.haveSameContent = *result.hash2 == *job.knownHash1;
+            }
+            else if (job.knownHash2)
+            {
+                result.hash1 = getFileContentHash(job.filePath1, notifyProgress); //throw FileError, ThreadInterruption
+                result.haveSameContent = *result.hash1 == *job.knownHash2;
+            }
+            else if (job.computeHashes)
+            {
+                Hash128 hash1;
+                Hash128 hash2;
+                result.haveSameContent = filesHaveSameContent(job.filePath1, job.filePath2, notifyProgress, hash1, hash2); //throw FileError, ThreadInterruption
+                result.hash1 = hash1;
+                result.hash2 = hash2;
+            }
+            else
+                result.haveSameContent = filesHaveSameContent(job.filePath1, job.filePath2, notifyProgress); //throw FileError, ThreadInterruption
+        }
+        catch (const FileError& e) { result.errorMsg = e.toString(); }
+
+        scheduler.jobDone(std::move(result));
+    }
+}
+}
+
+
+std::vector<ContentCompareResult> zen::compareContentParallel(const std::vector<ContentCompareJob>& jobs,
+                                                              const std::vector<ContentCompareDevice>& devices,
+                                                              const std::function<std::wstring(size_t jobIdx)>& getStatusText,
+                                                              ProcessCallback& callback,
+                                                              size_t updateIntervalMs)
+{
+    std::vector<ContentCompareResult> results(jobs.size());
+    if (jobs.empty())
+        return results;
+
+    JobScheduler scheduler(jobs, devices);
+
+    size_t threadCount = 0;
+    for (const ContentCompareDevice& dev : devices)
+        threadCount += std::max<size_t>(dev.maxJobs, 1);
+    threadCount = std::min(threadCount, jobs.size());
+
+    FixedList<InterruptibleThread> worker;
+    ZEN_ON_SCOPE_EXIT
+    (
+        for (InterruptibleThread& wt : worker)
+            wt.interrupt(); //interrupt all at once first, then join
+        for (InterruptibleThread& wt : worker)
+            if (wt.joinable()) //= precondition of thread::join(), which throws an exception if violated!
+                wt.join();
+    );
+
+    for (size_t i = 0; i < threadCount; ++i)
+        worker.emplace_back([&scheduler, &jobs]
+        {
+#ifdef ZEN_WIN
+            setCurrentThreadName("Compare Content");
+#endif
+            compareWorker(scheduler, jobs); //throw ThreadInterruption
+        });
+
+    std::vector<size_t> retryCount(jobs.size());
+    std::int64_t bytesReported = 0;
+    size_t lastStatusJob = jobs.size(); //none yet
+
+    for (size_t jobsOutstanding = jobs.size(); jobsOutstanding > 0; )
+    {
+        std::vector<CompletedJob> completedJobs = scheduler.waitForCompletedJobs(updateIntervalMs);
+
+        //report bytes first: includes everything read by the completed jobs
+        const std::int64_t bytesProcessed = scheduler.getBytesProcessed();
+        callback.updateProcessedData(0, bytesProcessed - bytesReported); //noexcept
+        bytesReported = bytesProcessed;
+
+        for (CompletedJob& cj : completedJobs)
+            if (cj.errorMsg)
+            {
+                callback.updateTotalData(0, cj.bytesReported); //failed attempt: same as StatisticsReporter for a cancelled task
+
+                switch (callback.reportError(*cj.errorMsg, retryCount[cj.jobIdx])) //throw X
+                {
+                    case ProcessCallback::IGNORE_ERROR:
+                        results[cj.jobIdx].errorMsg = std::move(cj.errorMsg);
+                        scheduler.finishJob();
+                        --jobsOutstanding;
+                        break;
+
+                    case ProcessCallback::RETRY:
+                        ++retryCount[cj.jobIdx];
+                        scheduler.retryJob(cj.jobIdx);
+                        break;
+                }
+            }
+            else
+            {
+                //binary comparison stops at the first difference, or the file size changed since scanning: consider the real amount of data
+                callback.updateProcessedData(1, 0);
+                callback.updateTotalData(0, cj.bytesReported - static_cast<std::int64_t>(getBytesToRead(jobs[cj.jobIdx])));
+
+                results[cj.jobIdx].haveSameContent = cj.haveSameContent;
+                results[cj.jobIdx].hash1 = cj.hash1;
+                results[cj.jobIdx].hash2 = cj.hash2;
+                results[cj.jobIdx].sharedExtents = cj.sharedExtents;
+                scheduler.finishJob();
+                --jobsOutstanding;
+            }
+
+        const size_t statusJob = scheduler.getLastStartedJob();
+        if (statusJob != lastStatusJob)
+        {
+            lastStatusJob = statusJob;
+            callback.reportStatus(getStatusText(statusJob)); //throw X
+        }
+        else
+            callback.requestUiRefresh(); //throw X
+    }
+    return results;
+}
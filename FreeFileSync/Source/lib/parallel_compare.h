@@ -0,0 +1,60 @@
+// *****************************************************************************
+// * This file is part of the FreeFileSync project. It is distributed under    *
+// * GNU General Public License: http://www.gnu.org/licenses/gpl-3.0           *
+// * Copyright (C) Zenju (zenju AT freefilesync DOT org) - All Rights Reserved *
+// *****************************************************************************
+
+#ifndef PARALLEL_COMPARE_H_0347518934751093457
+#define PARALLEL_COMPARE_H_0347518934751093457
+
+#include <vector>
+#include <zen/optional.h>
+#include <zen/blake2b.h>
+#include "../fs/abstract.h"
+#include "../process_callback.h"
+
+
+namespace zen
+{
+//concurrency limits for a group of content comparisons, e.g. all files of a folder pair located on the same pair of devices
+struct ContentCompareDevice
+{
+    size_t maxJobs      = 1; //files compared concurrently
+    size_t maxLargeJobs = 1; //... of which are large files: a few sequential streams saturate the device, more would only compete for bandwidth
+};
+
+struct ContentCompareJob
+{
+    AbstractPath filePath1;
+    AbstractPath filePath2;
+    std::uint64_t fileSize; //both files have the same size
+    size_t deviceIdx;       //index into "devices"
+
+    size_t sampleBlocks = 0; //> 0: compare head, tail and sampleBlocks blocks in between only (CompareVariant::CONTENT_SAMPLED); no hashes
+
+    //optional: content hash cache
+    bool computeHashes = false; //return the hashes of all files read
+    Opt<Hash128> knownHash1;    //file is unchanged since it was hashed: only the other file is read and hashed
+    Opt<Hash128> knownHash2;    //(not both)
+};
+
+struct ContentCompareResult
+{
+    bool haveSameContent = false;
+    Opt<std::wstring> errorMsg; //error was ignored by the user
+    Opt<Hash128> hash1; //ContentCompareJob::computeHashes: set for files that were read
+    Opt<Hash128> hash2; //
+    bool sharedExtents = false; //equal without reading: both files reference the same data extents
+};
+
+//compare file content of several jobs concurrently:
+//- statistics: call ProcessCallback::initNewPhase() before; errors, status and progress are reported in the context of the calling thread
+//- each job is reported as one item; bytes according to StatisticsReporter
+std::vector<ContentCompareResult> compareContentParallel(const std::vector<ContentCompareJob>& jobs,
+                                                         const std::vector<ContentCompareDevice>& devices,
+                                                         const std::function<std::wstring(size_t jobIdx)>& getStatusText, //e.g. "Comparing content of files %x"
+                                                         ProcessCallback& callback, //throw X
+                                                         size_t updateIntervalMs); //unit: [ms]
+}
+
+#endif //PARALLEL_COMPARE_H_0347518934751093457
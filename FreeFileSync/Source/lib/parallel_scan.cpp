@@ -5,113 +5,23 @@
 // *****************************************************************************
 
 #include "parallel_scan.h"
+#include <deque>
+#include <functional>
 #include <zen/file_error.h>
 #include <zen/thread.h>
 #include <zen/scope_guard.h>
 #include <zen/fixed_list.h>
 #include <zen/tick_count.h>
+#include <zen/format_unit.h>
 #include "db_file.h"
 #include "lock_holder.h"
+#include "scan_snapshot.h"
 
 using namespace zen;
 
 
 namespace
 {
-/*
-#ifdef ZEN_WIN
-
-struct DiskInfo
-{
-    DiskInfo() :
-        driveType(DRIVE_UNKNOWN),
-        diskID(-1) {}
-
-    UINT driveType;
-    int diskID; // -1 if id could not be determined, this one is filled if driveType == DRIVE_FIXED or DRIVE_REMOVABLE;
-};
-
-inline
-bool operator<(const DiskInfo& lhs, const DiskInfo& rhs)
-{
-    if (lhs.driveType != rhs.driveType)
-        return lhs.driveType < rhs.driveType;
-
-    if (lhs.diskID < 0 || rhs.diskID < 0)
-        return false;
-    //consider "same", reason: one volume may be uniquely associated with one disk, while the other volume is associated to the same disk AND another one!
-    //volume <-> disk is 0..N:1..N
-
-    return lhs.diskID < rhs.diskID ;
-}
-
-
-DiskInfo retrieveDiskInfo(const Zstring& itemPath)
-{
-    std::vector<wchar_t> volName(std::max(pathName.size(), static_cast<size_t>(10000)));
-
-    DiskInfo output;
-
-    //full pathName need not yet exist!
-    if (!::GetVolumePathName(itemPath.c_str(),  //__in   LPCTSTR lpszFileName,
-                             &volName[0],       //__out  LPTSTR lpszVolumePathName,
-                             static_cast<DWORD>(volName.size()))) //__in   DWORD cchBufferLength
-        return output;
-
-    const Zstring rootPathName = &volName[0];
-
-    output.driveType = ::GetDriveType(rootPathName.c_str());
-
-    if (output.driveType == DRIVE_NO_ROOT_DIR) //these two should be the same error category
-        output.driveType = DRIVE_UNKNOWN;
-
-    if (output.driveType != DRIVE_FIXED && output.driveType != DRIVE_REMOVABLE)
-        return output; //no reason to get disk ID
-
-    //go and find disk id:
-
-    //format into form: "\\.\C:"
-    Zstring volnameFmt = rootPathName;
-    if (endsWith(volnameFmt, FILE_NAME_SEPARATOR))
-        volnameFmt.pop_back();
-    volnameFmt = L"\\\\.\\" + volnameFmt;
-
-    HANDLE hVolume = ::CreateFile(volnameFmt.c_str(),
-                                  0,
-                                  FILE_SHARE_READ | FILE_SHARE_WRITE,
-                                  nullptr,
-                                  OPEN_EXISTING,
-                                  0,
-                                  nullptr);
-    if (hVolume == INVALID_HANDLE_VALUE)
-        return output;
-    ZEN_ON_SCOPE_EXIT(::CloseHandle(hVolume));
-
-    std::vector<char> buffer(sizeof(VOLUME_DISK_EXTENTS) + sizeof(DISK_EXTENT)); //reserve buffer for at most one disk! call below will then fail if volume spans multiple disks!
-
-    DWORD bytesReturned = 0;
-    if (!::DeviceIoControl(hVolume,                              //_In_         HANDLE hDevice,
-                           IOCTL_VOLUME_GET_VOLUME_DISK_EXTENTS, //_In_         DWORD dwIoControlCode,
-                           nullptr,                              //_In_opt_     LPVOID lpInBuffer,
-                           0,                                    //_In_         DWORD nInBufferSize,
-                           &buffer[0],                           //_Out_opt_    LPVOID lpOutBuffer,
-                           static_cast<DWORD>(buffer.size()),    //_In_         DWORD nOutBufferSize,
-                           &bytesReturned,                       //_Out_opt_    LPDWORD lpBytesReturned
-                           nullptr))                             //_Inout_opt_  LPOVERLAPPED lpOverlapped
-        return output;
-
-    const VOLUME_DISK_EXTENTS& volDisks = *reinterpret_cast<VOLUME_DISK_EXTENTS*>(&buffer[0]);
-
-    if (volDisks.NumberOfDiskExtents != 1)
-        return output;
-
-    output.diskID = volDisks.Extents[0].DiskNumber;
-
-    return output;
-}
-#endif
-*/
-
 /*
 PERF NOTE
 
@@ -135,29 +45,152 @@ Windows 7:                                        Windows XP:
 
 => Traversing does not take any advantage of file locality so that even multiple threads operating on the same disk impose no performance overhead! (even faster on XP)
 
-std::vector<std::set<DirectoryKey>> separateByDistinctDisk(const std::set<DirectoryKey>& dirkeys)
-{
-    //use one thread per physical disk:
-    using DiskKeyMapping = std::map<DiskInfo, std::set<DirectoryKey>>;
-    DiskKeyMapping tmp;
-    std::for_each(dirkeys.begin(), dirkeys.end(),
-    [&](const DirectoryKey& key) { tmp[retrieveDiskInfo(key.dirpathFull_)].insert(key); });
-
-    std::vector<std::set<DirectoryKey>> buckets;
-    std::transform(tmp.begin(), tmp.end(), std::back_inserter(buckets),
-    [&](const DiskKeyMapping::value_type& diskToKey) { return diskToKey.second; });
-    return buckets;
-}
+=> Linux, spinning disks: concurrent traversals of the same disk *do* compete for the read head once folder metadata is not cached,
+   while SSD/NVMe and network shares scale with concurrent requests
+
+=> reproducible measurements (synthetic folder tree, cold/warm page cache, entries/sec, syscalls, peak memory): ScanBenchmark/, "make run"
 */
+const size_t MAX_TRAVERSALS_PER_ROTATIONAL_DISK = 1;
+
+
+//limit number of concurrent folder traversals per physical device (AFS::StorageDeviceInfo)
+class DeviceAccessScheduler
+{
+public:
+    //context of worker thread
+    void acquire(const Zstring& deviceId, int threadID) //throw ThreadInterruption
+    {
+        std::unique_lock<std::mutex> dummy(lockDevices);
+        DeviceStatus& dev = devices[deviceId];
+
+        dev.waitingThreads.insert(threadID);
+        ZEN_ON_SCOPE_EXIT(dev.waitingThreads.erase(threadID));
+
+        //grant access in order of thread ID: main thread is waiting for worker threads (and reports their status) in this order, too!
+        interruptibleWait(conditionAccessChanged, dummy, [&] { return dev.activeCount < MAX_TRAVERSALS_PER_ROTATIONAL_DISK && *dev.waitingThreads.begin() == threadID; }); //throw ThreadInterruption
+        ++dev.activeCount;
+    }
+
+    //context of worker thread
+    void release(const Zstring& deviceId)
+    {
+        {
+            std::lock_guard<std::mutex> dummy(lockDevices);
+            assert(devices[deviceId].activeCount > 0);
+            --devices[deviceId].activeCount;
+        }
+        conditionAccessChanged.notify_all();
+    }
+
+private:
+    struct DeviceStatus
+    {
+        size_t activeCount = 0;
+        std::set<int> waitingThreads;
+    };
+
+    std::mutex lockDevices;
+    std::condition_variable conditionAccessChanged;
+    std::map<Zstring, DeviceStatus> devices;
+};
 
 //------------------------------------------------------------------------------------------
 using BasicWString = Zbase<wchar_t, StorageRefCountThreadSafe>; //thread-safe string class for UI texts
 
+const size_t MAX_STATUS_PATH_LEN = 260; //[Zchar]
+const size_t CACHE_LINE_SIZE = 64;
+
+
+//progress of a single WorkerThread: written by the thread(s) traversing one base folder, sampled by the main thread without locking
+class WorkerStatus
+{
+public:
+    void incItemsScanned() { itemsScanned_.fetch_add(1, std::memory_order_relaxed); }
+    int getItemsScanned() const { return itemsScanned_.load(std::memory_order_relaxed); }
+
+    void incActiveThreads() { ++activeThreads_; }
+    void decActiveThreads() { --activeThreads_; }
+    int getActiveThreads() const { return activeThreads_; }
+
+    //context of worker thread: seqlock writer
+    void setCurrentPath(const Zstring& relPath)
+    {
+        unsigned int seq = pathSeq_.load(std::memory_order_relaxed);
+        if (seq % 2 != 0 || !pathSeq_.compare_exchange_strong(seq, seq + 1, std::memory_order_relaxed))
+            return; //another thread of the same base folder is just writing: skip this sample, status is updated regularly anyway
+        std::atomic_thread_fence(std::memory_order_release);
+
+        //keep the end of overlong paths: item name is most significant
+        size_t startPos = relPath.size() > MAX_STATUS_PATH_LEN ? relPath.size() - MAX_STATUS_PATH_LEN : 0;
+        while (startPos < relPath.size() && startPos > 0 && isContinuationChar(relPath[startPos])) //don't start in the middle of a UTF-8 sequence/UTF-16 surrogate pair
+            ++startPos;
+
+        const size_t pathLen = relPath.size() - startPos;
+        for (size_t i = 0; i < pathLen; ++i)
+            currentPath_[i].store(relPath[startPos + i], std::memory_order_relaxed);
+        pathLen_     .store(pathLen,       std::memory_order_relaxed);
+        pathTrimmed_ .store(startPos != 0, std::memory_order_relaxed);
+
+        pathSeq_.store(seq + 2, std::memory_order_release);
+    }
+
+    //context of main thread: seqlock reader; returns false if no consistent value could be read
+    bool getCurrentPath(Zstring& relPath, bool& trimmed) const
+    {
+        for (int i = 0; i < 10; ++i) //a writer never blocks for long
+        {
+            const unsigned int seq = pathSeq_.load(std::memory_order_acquire);
+            if (seq % 2 != 0)
+                continue;
+
+            const size_t pathLen = std::min(pathLen_.load(std::memory_order_relaxed), MAX_STATUS_PATH_LEN);
+            Zchar pathBuf[MAX_STATUS_PATH_LEN];
+            for (size_t j = 0; j < pathLen; ++j)
+                pathBuf[j] = currentPath_[j].load(std::memory_order_relaxed);
+            const bool trimmedTmp = pathTrimmed_.load(std::memory_order_relaxed);
+
+            std::atomic_thread_fence(std::memory_order_acquire);
+            if (pathSeq_.load(std::memory_order_relaxed) == seq)
+            {
+                if (seq == 0) //nothing written yet
+                    return false;
+                relPath = Zstring(pathBuf, pathLen);
+                trimmed = trimmedTmp;
+                return true;
+            }
+        }
+        return false;
+    }
+
+private:
+    static bool isContinuationChar(Zchar c)
+    {
+        return sizeof(Zchar) == 1 ?
+               (static_cast<unsigned char>(c) & 0xc0) == 0x80 :
+               0xdc00 <= static_cast<unsigned int>(c) && static_cast<unsigned int>(c) <= 0xdfff;
+    }
+
+    std::atomic<int> itemsScanned_ { 0 }; //std:atomic is uninitialized by default!
+    std::atomic<int> activeThreads_{ 0 }; //
+
+    std::atomic<unsigned int> pathSeq_{ 0 }; //odd while current path is being written
+    std::atomic<size_t> pathLen_{ 0 };
+    std::atomic<bool> pathTrimmed_{ false };
+    std::atomic<Zchar> currentPath_[MAX_STATUS_PATH_LEN];
+
+    char padding_[CACHE_LINE_SIZE]; //avoid false sharing with the status of the next worker
+};
+
 
 class AsyncCallback //actor pattern
 {
 public:
-    AsyncCallback(size_t reportingIntervalMs) : reportingIntervalTicks(reportingIntervalMs * ticksPerSec() / 1000) {}
+    AsyncCallback(const std::vector<AbstractPath>& baseFolderPaths, //one per WorkerThread, indexed by thread ID
+                  size_t reportingIntervalMs) :
+        baseFolderPaths_(baseFolderPaths),
+        workerStatus(baseFolderPaths.size()),
+        workerRates(baseFolderPaths.size()),
+        reportingIntervalTicks(reportingIntervalMs * ticksPerSec() / 1000) {}
 
     //blocking call: context of worker thread
     FillBufferCallback::HandleError reportError(const std::wstring& msg, size_t retryNumber) //throw ThreadInterruption
@@ -180,27 +213,45 @@ public:
         return rv;
     }
 
+    //non-blocking call: context of worker thread; onResponse is called in context of main thread
+    void queueError(const std::wstring& msg, size_t retryNumber, const std::function<void(FillBufferCallback::HandleError)>& onResponse)
+    {
+        std::lock_guard<std::mutex> dummy(lockErrorInfo);
+        queuedErrors.push_back({ copyStringTo<BasicWString>(msg), retryNumber, onResponse });
+    }
+
     void processErrors(FillBufferCallback& callback) //context of main thread, call repreatedly
     {
-        std::unique_lock<std::mutex> dummy(lockErrorInfo);
-        if (errorInfo.get() && !errorResponse.get())
         {
-            FillBufferCallback::HandleError rv = callback.reportError(copyStringTo<std::wstring>(errorInfo->first), errorInfo->second); //throw!
-            errorResponse = std::make_unique<FillBufferCallback::HandleError>(rv);
+            std::unique_lock<std::mutex> dummy(lockErrorInfo);
+            if (errorInfo.get() && !errorResponse.get())
+            {
+                FillBufferCallback::HandleError rv = callback.reportError(copyStringTo<std::wstring>(errorInfo->first), errorInfo->second); //throw!
+                errorResponse = std::make_unique<FillBufferCallback::HandleError>(rv);
 
-            dummy.unlock(); //optimization for condition_variable::notify_all()
-            conditionGotResponse.notify_all(); //instead of notify_one(); workaround bug: https://svn.boost.org/trac/boost/ticket/7796
+                dummy.unlock(); //optimization for condition_variable::notify_all()
+                conditionGotResponse.notify_all(); //instead of notify_one(); workaround bug: https://svn.boost.org/trac/boost/ticket/7796
+            }
+        }
+
+        for (;;)
+        {
+            std::unique_lock<std::mutex> dummy(lockErrorInfo);
+            if (queuedErrors.empty())
+                break;
+            QueuedError error = std::move(queuedErrors.front());
+            queuedErrors.pop_front();
+            dummy.unlock(); //worker threads continue queueing errors while the user decides
+
+            error.onResponse(callback.reportError(copyStringTo<std::wstring>(error.msg), error.retryNumber)); //throw!
         }
     }
 
-    void incrementNotifyingThreadId() { ++notifyingThreadID; } //context of main thread
+    void setNotifyingThreadId(int threadID) { notifyingThreadID = threadID; } //context of main thread
 
-    //perf optimization: comparison phase is 7% faster by avoiding needless std::wstring contstruction for reportCurrentFile()
-    bool mayReportCurrentFile(int threadID, TickVal& lastReportTime) const
+    //perf optimization: comparison phase is 7% faster by avoiding needless path construction for reportCurrentFile()
+    bool mayReportCurrentFile(TickVal& lastReportTime) const
     {
-        if (threadID != notifyingThreadID) //only one thread at a time may report status
-            return false;
-
         const TickVal now = getTicks(); //0 on error
         if (dist(lastReportTime, now) >= reportingIntervalTicks) //perform ui updates not more often than necessary
         {
@@ -210,40 +261,75 @@ public:
         return false;
     }
 
-    void reportCurrentFile(const std::wstring& filepath) //context of worker thread
-    {
-        std::lock_guard<std::mutex> dummy(lockCurrentStatus);
-        currentFile = copyStringTo<BasicWString>(filepath);
-    }
+    void reportCurrentFile(int threadID, const Zstring& relPath) { workerStatus[threadID].setCurrentPath(relPath); } //context of worker thread
 
     std::wstring getCurrentStatus() //context of main thread, call repreatedly
     {
-        std::wstring filepath;
+        updateWorkerRates();
+
+        //show the path of the worker the main thread is waiting for or the next active one
+        std::wstring filePath;
+        for (size_t i = 0; i < workerStatus.size() && filePath.empty(); ++i)
         {
-            std::lock_guard<std::mutex> dummy(lockCurrentStatus);
-            filepath = copyStringTo<std::wstring>(currentFile);
+            const size_t threadID = (notifyingThreadID + i) % workerStatus.size();
+            if (i == 0 || workerStatus[threadID].getActiveThreads() > 0)
+            {
+                Zstring relPath;
+                bool trimmed = false;
+                if (workerStatus[threadID].getCurrentPath(relPath, trimmed))
+                    filePath = trimmed ? L"..." + utfCvrtTo<std::wstring>(relPath) :
+                               AFS::getDisplayPath(AFS::appendRelPath(baseFolderPaths_[threadID], relPath));
+            }
         }
 
-        if (filepath.empty())
+        if (filePath.empty())
             return std::wstring();
 
         std::wstring statusText = copyStringTo<std::wstring>(textScanning);
 
-        const long activeCount = activeWorker;
+        const long activeCount = getActiveWorker();
         if (activeCount >= 2)
             statusText += L" [" + replaceCpy(_P("1 thread", "%x threads", activeCount), L"%x", numberTo<std::wstring>(activeCount)) + L"]";
 
+        //throughput of each active base folder traversal: find the slow one
+        std::wstring ratesText;
+        size_t activeFolders = 0;
+        bool ratesAvailable = true;
+        for (size_t threadID = 0; threadID < workerStatus.size(); ++threadID)
+            if (workerStatus[threadID].getActiveThreads() > 0)
+            {
+                ratesText += activeFolders++ == 0 ? L" [" : L" | ";
+                ratesText += replaceCpy(_("%x items/sec"), L"%x", formatThreeDigitPrecision(workerRates[threadID].itemsPerSec));
+                ratesAvailable &= workerRates[threadID].itemsPerSecValid;
+            }
+        if (activeFolders >= 2 && ratesAvailable)
+            statusText += ratesText + L"]";
+
         statusText += L" ";
-        statusText += filepath;
+        statusText += filePath;
         return statusText;
     }
 
-    void incItemsScanned() { ++itemsScanned; } //perf: irrelevant! scanning is almost entirely file I/O bound, not CPU bound! => no prob having multiple threads poking at the same variable!
-    long getItemsScanned() const { return itemsScanned; }
+    void incItemsScanned(int threadID) { workerStatus[threadID].incItemsScanned(); } //context of worker thread: no contention between base folders
 
-    void incActiveWorker() { ++activeWorker; }
-    void decActiveWorker() { --activeWorker; }
-    long getActiveWorker() const { return activeWorker; }
+    long getItemsScanned() const //context of main thread
+    {
+        long itemsTotal = 0;
+        for (const WorkerStatus& ws : workerStatus)
+            itemsTotal += ws.getItemsScanned();
+        return itemsTotal;
+    }
+
+    void incActiveWorker(int threadID) { workerStatus[threadID].incActiveThreads(); }
+    void decActiveWorker(int threadID) { workerStatus[threadID].decActiveThreads(); }
+
+    long getActiveWorker() const
+    {
+        long activeCount = 0;
+        for (const WorkerStatus& ws : workerStatus)
+            activeCount += ws.getActiveThreads();
+        return activeCount;
+    }
 
 private:
     //---- error handling ----
@@ -253,18 +339,222 @@ private:
     std::unique_ptr<std::pair<BasicWString, size_t>> errorInfo; //error message + retry number
     std::unique_ptr<FillBufferCallback::HandleError> errorResponse;
 
+    struct QueuedError
+    {
+        BasicWString msg;
+        size_t retryNumber;
+        std::function<void(FillBufferCallback::HandleError)> onResponse;
+    };
+    std::deque<QueuedError> queuedErrors; //deferred error handling: worker threads do not wait for a response
+
     //---- status updates ----
-    std::atomic<int> notifyingThreadID { 0 }; //CAVEAT: do NOT use boost::thread::id: https://svn.boost.org/trac/boost/ticket/5754
+    void updateWorkerRates() //context of main thread
+    {
+        const TickVal now = getTicks(); //0 on error
+        const std::int64_t tps = ticksPerSec(); //0 on error
+        if (!now.isValid() || tps == 0)
+            return;
+
+        for (size_t threadID = 0; threadID < workerStatus.size(); ++threadID)
+        {
+            WorkerRate& rate = workerRates[threadID];
+            const int itemsScanned = workerStatus[threadID].getItemsScanned();
+
+            if (!rate.lastSampleTime.isValid())
+            {
+                rate.lastSampleTime  = now;
+                rate.lastSampleItems = itemsScanned;
+            }
+            else if (dist(rate.lastSampleTime, now) >= tps) //average over at least one second
+            {
+                rate.itemsPerSec = (itemsScanned - rate.lastSampleItems) * static_cast<double>(tps) / dist(rate.lastSampleTime, now);
+                rate.itemsPerSecValid = true;
+                rate.lastSampleTime  = now;
+                rate.lastSampleItems = itemsScanned;
+            }
+        }
+    }
 
-    std::mutex lockCurrentStatus; //use a different lock for current file: continue traversing while some thread may process an error
-    BasicWString currentFile;
+    const std::vector<AbstractPath> baseFolderPaths_; //AbstractPath is thread-safe like an int! :)
+
+    std::vector<WorkerStatus> workerStatus; //lock free: one per WorkerThread
+
+    struct WorkerRate
+    {
+        TickVal lastSampleTime;
+        int lastSampleItems = 0;
+        double itemsPerSec = 0;
+        bool itemsPerSecValid = false;
+    };
+    std::vector<WorkerRate> workerRates; //context of main thread only
+
+    int notifyingThreadID = 0; //context of main thread only
     const std::int64_t reportingIntervalTicks;
 
     const BasicWString textScanning { copyStringTo<BasicWString>(_("Scanning:")) }; //this one is (currently) not shared and could be made a std::wstring, but we stay consistent and use thread-safe variables in this class only!
+};
 
-    //---- status updates II (lock free) ----
-    std::atomic<int> itemsScanned{ 0 }; //std:atomic is uninitialized by default!
-    std::atomic<int> activeWorker{ 0 }; //
+//-------------------------------------------------------------------------------------------------
+
+//sub folder whose traversal is deferred to the thread pool of a single base folder
+struct FolderTask
+{
+    Zstring relPathPf;       //postfixed with FILE_NAME_SEPARATOR or empty for base folder!
+    FolderContainer* output; //not owned
+    int level;
+    size_t retryNumber = 0;
+};
+
+
+//sub folder found by DirCallback: FolderContainer::addSubFolder() invalidates references => use position until parent folder is complete
+struct DeferredFolder
+{
+    Zstring relPathPf;
+    size_t folderPos; //see FolderContainer::FolderList::refData()
+};
+
+
+//error during traversal of a FolderTask: reported without blocking the worker thread, see AsyncCallback::queueError()
+struct ScanError
+{
+    bool folderError;  //folder could not be read (completely) or single item failed
+    Zstring relPath;   //folder error: relative folder path or empty for base folder; item error: relative item path
+    std::wstring msg;
+};
+
+
+//work-stealing scheduler for parallel traversal of a single base folder:
+//- each thread pushes and pops sub folders at the back of its own deque => depth-first, good directory locality
+//- idle threads steal from the front of other deques => oldest entries are likely the biggest sub trees
+//perf: a single lock is sufficient: scanning is almost entirely file I/O bound, not CPU bound!
+class FolderTaskPool
+{
+public:
+    FolderTaskPool(size_t threadCount) : queues_(threadCount) {}
+
+    void push(size_t threadIdx, const std::vector<FolderTask>& tasks) //context of worker threads
+    {
+        if (tasks.empty()) return;
+        {
+            std::lock_guard<std::mutex> dummy(lockQueues_);
+            std::deque<FolderTask>& queue = queues_[threadIdx];
+            queue.insert(queue.end(), tasks.begin(), tasks.end());
+            tasksOutstanding_ += tasks.size();
+        }
+        conditionNewTask_.notify_all();
+    }
+
+    //blocking call: returns false if the whole folder hierarchy has been traversed
+    bool pop(size_t threadIdx, FolderTask& task) //throw ThreadInterruption
+    {
+        std::unique_lock<std::mutex> dummy(lockQueues_);
+        interruptibleWait(conditionNewTask_, dummy, [&] { return tasksOutstanding_ == 0 || tryPop(threadIdx, task); }); //throw ThreadInterruption
+        return tasksOutstanding_ != 0;
+    }
+
+    //call *after* pushing sub folders of a finished task!
+    void taskDone()
+    {
+        bool allDone = false;
+        {
+            std::lock_guard<std::mutex> dummy(lockQueues_);
+            assert(tasksOutstanding_ > 0);
+            allDone = --tasksOutstanding_ == 0;
+        }
+        if (allDone)
+            conditionNewTask_.notify_all();
+    }
+
+    //folder with traversal errors: hold back its sub folders until all errors are answered; meanwhile the worker thread continues with other folders
+    size_t parkTask(const FolderTask& task, std::vector<FolderTask>& subFolders, size_t errorCount) //context of worker threads; returns ID of parked task
+    {
+        assert(errorCount > 0);
+        std::lock_guard<std::mutex> dummy(lockQueues_);
+        const size_t parkedId = nextParkedId_++;
+
+        ParkedTask& parked = parkedTasks_[parkedId];
+        parked.task = task;
+        parked.subFolders.swap(subFolders);
+        parked.errorsPending = errorCount;
+        return parkedId;
+    }
+
+    //context of main thread: retry => traverse parked folder again; ignore => release its sub folders
+    //returns true if the last error of the parked task was answered and none requested a retry
+    bool errorAnswered(size_t parkedId, FillBufferCallback::HandleError rv)
+    {
+        bool ignored = false;
+        {
+            std::lock_guard<std::mutex> dummy(lockQueues_);
+            auto it = parkedTasks_.find(parkedId);
+            assert(it != parkedTasks_.end());
+            ParkedTask& parked = it->second;
+
+            if (rv == FillBufferCallback::ON_ERROR_RETRY)
+                parked.retry = true;
+            if (--parked.errorsPending != 0)
+                return false;
+
+            std::deque<FolderTask>& queue = queues_[0]; //any queue will do: idle threads are stealing
+            if (parked.retry)
+            {
+                ++parked.task.retryNumber;
+                queue.push_back(parked.task); //task is still outstanding
+            }
+            else
+            {
+                queue.insert(queue.end(), parked.subFolders.begin(), parked.subFolders.end());
+                tasksOutstanding_ += parked.subFolders.size();
+                assert(tasksOutstanding_ > 0);
+                --tasksOutstanding_; //parked task is done
+                ignored = true;
+            }
+            parkedTasks_.erase(it);
+        }
+        conditionNewTask_.notify_all();
+        return ignored;
+    }
+
+private:
+    FolderTaskPool           (const FolderTaskPool&) = delete;
+    FolderTaskPool& operator=(const FolderTaskPool&) = delete;
+
+    bool tryPop(size_t threadIdx, FolderTask& task) //call while locked!
+    {
+        std::deque<FolderTask>& ownQueue = queues_[threadIdx];
+        if (!ownQueue.empty())
+        {
+            task = ownQueue.back();
+            ownQueue.pop_back();
+            return true;
+        }
+        for (size_t i = 1; i < queues_.size(); ++i) //steal
+        {
+            std::deque<FolderTask>& otherQueue = queues_[(threadIdx + i) % queues_.size()];
+            if (!otherQueue.empty())
+            {
+                task = otherQueue.front();
+                otherQueue.pop_front();
+                return true;
+            }
+        }
+        return false;
+    }
+
+    std::mutex lockQueues_;
+    std::condition_variable conditionNewTask_;
+    std::vector<std::deque<FolderTask>> queues_; //one per thread
+    size_t tasksOutstanding_ = 0; //queued + currently traversed + parked
+
+    struct ParkedTask
+    {
+        FolderTask task;
+        std::vector<FolderTask> subFolders;
+        size_t errorsPending = 0;
+        bool retry = false;
+    };
+    std::map<size_t, ParkedTask> parkedTasks_;
+    size_t nextParkedId_ = 0;
 };
 
 //-------------------------------------------------------------------------------------------------
@@ -276,27 +566,65 @@ public:
                     const AbstractPath& baseFolderPath,
                     const HardFilter::FilterRef& filter,
                     SymLinkHandling handleSymlinks,
+                    bool allowStaleAttributes,
+                    ScanSnapshotMode snapshotMode,
                     std::map<Zstring, std::wstring, LessFilePath>& failedFolderReads,
                     std::map<Zstring, std::wstring, LessFilePath>& failedItemReads,
                     AsyncCallback& acb) :
         baseFolderPath_(baseFolderPath),
         filter_(filter),
         handleSymlinks_(handleSymlinks),
-        failedDirReads_ (failedFolderReads),
-        failedItemReads_(failedItemReads),
+        allowStaleAttributes_(allowStaleAttributes),
+        snapshotMode_(snapshotMode),
         acb_(acb),
-        threadID_(threadID) {}
+        threadID_(threadID),
+        failedDirReads_ (failedFolderReads),
+        failedItemReads_(failedItemReads) {}
+
+    //context of worker threads: may be called concurrently when traversing with multiple threads!
+    void addFailedFolderRead(const Zstring& folderRelPath, const std::wstring& msg)
+    {
+        std::lock_guard<std::mutex> dummy(lockFailedReads);
+        failedDirReads_[folderRelPath] = msg;
+    }
+    void addFailedItemRead(const Zstring& itemRelPath, const std::wstring& msg)
+    {
+        std::lock_guard<std::mutex> dummy(lockFailedReads);
+        failedItemReads_[itemRelPath] = msg;
+    }
+
+    //context of worker threads: may be called concurrently when traversing with multiple threads!
+    void addFolderSnapshot(const Zstring& folderRelPathPf, const AFS::TraverserCallback::FolderStamp& stamp, std::vector<AFS::TraverserCallback::FolderItem>& items)
+    {
+        //"racy" folder: a change within the time stamp granularity of the file system would go unnoticed next time => don't record
+        const std::int64_t safeTimeNs = (scanStartTime - 2) * 1000000000LL;
+        if (stamp.modTimeNs >= safeTimeNs || stamp.changeTimeNs >= safeTimeNs)
+            return;
+
+        std::lock_guard<std::mutex> dummy(lockSnapshot);
+        FolderSnapshot& folder = currentSnapshot[folderRelPathPf];
+        folder.stamp = stamp;
+        folder.items.swap(items);
+    }
 
     const AbstractPath baseFolderPath_;
     const HardFilter::FilterRef filter_; //always bound!
     const SymLinkHandling handleSymlinks_;
-
-    std::map<Zstring, std::wstring, LessFilePath>& failedDirReads_;
-    std::map<Zstring, std::wstring, LessFilePath>& failedItemReads_;
+    const bool allowStaleAttributes_;
+    const ScanSnapshotMode snapshotMode_;
 
     AsyncCallback& acb_;
     const int threadID_;
-    TickVal lastReportTime;
+
+    ScanSnapshot lastSnapshot; //read-only during traversal
+    ScanSnapshot currentSnapshot;
+
+private:
+    const std::int64_t scanStartTime = std::time(nullptr); //number of seconds since Jan. 1st 1970 UTC
+    std::mutex lockSnapshot;
+    std::mutex lockFailedReads;
+    std::map<Zstring, std::wstring, LessFilePath>& failedDirReads_;
+    std::map<Zstring, std::wstring, LessFilePath>& failedItemReads_;
 };
 
 
@@ -304,13 +632,21 @@ class DirCallback : public AFS::TraverserCallback
 {
 public:
     DirCallback(TraverserConfig& config,
+                TickVal& lastReportTime, //one per traversing thread
                 const Zstring& parentRelPathPf, //postfixed with FILE_NAME_SEPARATOR!
                 FolderContainer& output,
-                int level) :
+                NameArena& arena, //one per traversing thread
+                int level,
+                std::vector<DeferredFolder>* deferredFolders, //optional: collect sub folders instead of recursing, e.g. for parallel traversal
+                std::vector<ScanError>* deferredErrors) : //optional: collect errors instead of waiting for a response
         cfg(config),
+        lastReportTime_(lastReportTime),
         parentRelPathPf_(parentRelPathPf),
         output_(output),
-        level_(level) {}
+        arena_(arena),
+        level_(level),
+        deferredFolders_(deferredFolders),
+        deferredErrors_(deferredErrors) {}
 
     virtual void                               onFile   (const FileInfo&    fi) override; //
     virtual std::unique_ptr<TraverserCallback> onDir    (const DirInfo&     di) override; //throw ThreadInterruption
@@ -319,11 +655,21 @@ public:
     HandleError reportDirError (const std::wstring& msg, size_t retryNumber)                          override; //throw ThreadInterruption
     HandleError reportItemError(const std::wstring& msg, size_t retryNumber, const Zstring& itemName) override; //
 
+    bool allowStaleAttributes() const override { return cfg.allowStaleAttributes_; }
+
+    FolderCacheMode getFolderCacheMode() const override;
+    const std::vector<FolderItem>* getCachedFolderContent(const FolderStamp& stamp) override;
+    void onFolderContent(const FolderStamp& stamp, std::vector<FolderItem>& items) override { cfg.addFolderSnapshot(parentRelPathPf_, stamp, items); }
+
 private:
     TraverserConfig& cfg;
+    TickVal& lastReportTime_;
     const Zstring parentRelPathPf_;
     FolderContainer& output_;
+    NameArena& arena_;
     const int level_;
+    std::vector<DeferredFolder>* const deferredFolders_;
+    std::vector<ScanError>* const deferredErrors_;
 };
 
 
@@ -339,8 +685,8 @@ void DirCallback::onFile(const FileInfo& fi) //throw ThreadInterruption
     const Zstring fileRelPath = parentRelPathPf_ + fi.itemName;
 
     //update status information no matter whether item is excluded or not!
-    if (cfg.acb_.mayReportCurrentFile(cfg.threadID_, cfg.lastReportTime))
-        cfg.acb_.reportCurrentFile(AFS::getDisplayPath(AFS::appendRelPath(cfg.baseFolderPath_, fileRelPath)));
+    if (cfg.acb_.mayReportCurrentFile(lastReportTime_))
+        cfg.acb_.reportCurrentFile(cfg.threadID_, fileRelPath);
 
     //------------------------------------------------------------------------------------
     //apply filter before processing (use relative name!)
@@ -358,9 +704,9 @@ void DirCallback::onFile(const FileInfo& fi) //throw ThreadInterruption
         Linux: retrieveFileID takes about 50% longer in VM! (avoidable because of redundant stat() call!)
     */
 
-    output_.addSubFile(fi.itemName, FileDescriptor(fi.lastWriteTime, fi.fileSize, fi.id, fi.symlinkInfo != nullptr));
+    output_.addSubFile(fi.itemName, FileDescriptor(fi.lastWriteTime, fi.fileSize, fi.id, fi.changeTime, fi.symlinkInfo != nullptr), arena_);
 
-    cfg.acb_.incItemsScanned(); //add 1 element to the progress indicator
+    cfg.acb_.incItemsScanned(cfg.threadID_); //add 1 element to the progress indicator
 }
 
 
@@ -371,8 +717,8 @@ std::unique_ptr<AFS::TraverserCallback> DirCallback::onDir(const DirInfo& di) //
     const Zstring& folderRelPath = parentRelPathPf_ + di.itemName;
 
     //update status information no matter whether item is excluded or not!
-    if (cfg.acb_.mayReportCurrentFile(cfg.threadID_, cfg.lastReportTime))
-        cfg.acb_.reportCurrentFile(AFS::getDisplayPath(AFS::appendRelPath(cfg.baseFolderPath_, folderRelPath)));
+    if (cfg.acb_.mayReportCurrentFile(lastReportTime_))
+        cfg.acb_.reportCurrentFile(cfg.threadID_, folderRelPath);
 
     //------------------------------------------------------------------------------------
     //apply filter before processing (use relative name!)
@@ -382,9 +728,9 @@ std::unique_ptr<AFS::TraverserCallback> DirCallback::onDir(const DirInfo& di) //
         return nullptr; //do NOT traverse subdirs
     //else: attention! ensure directory filtering is applied later to exclude actually filtered directories
 
-    FolderContainer& subFolder = output_.addSubFolder(di.itemName);
+    FolderContainer& subFolder = output_.addSubFolder(di.itemName, arena_);
     if (passFilter)
-        cfg.acb_.incItemsScanned(); //add 1 element to the progress indicator
+        cfg.acb_.incItemsScanned(cfg.threadID_); //add 1 element to the progress indicator
 
     //------------------------------------------------------------------------------------
     if (level_ > 100) //Win32 traverser: stack overflow approximately at level 1000
@@ -394,7 +740,13 @@ std::unique_ptr<AFS::TraverserCallback> DirCallback::onDir(const DirInfo& di) //
         }, *this, di.itemName))
     return nullptr;
 
-    return std::make_unique<DirCallback>(cfg, folderRelPath + FILE_NAME_SEPARATOR, subFolder, level_ + 1); //releaseDirTraverser() is guaranteed to be called in any case
+    if (deferredFolders_)
+    {
+        //don't recurse: sub folder is traversed by the thread pool *after* this folder is complete => a "retry" of the current folder cannot race with the sub folder traversal
+        deferredFolders_->push_back({ folderRelPath + FILE_NAME_SEPARATOR, output_.folders.size() - 1 });
+        return nullptr;
+    }
+    return std::make_unique<DirCallback>(cfg, lastReportTime_, folderRelPath + FILE_NAME_SEPARATOR, subFolder, arena_, level_ + 1, nullptr, nullptr); //releaseDirTraverser() is guaranteed to be called in any case
 }
 
 
@@ -405,8 +757,8 @@ DirCallback::HandleLink DirCallback::onSymlink(const SymlinkInfo& si) //throw Th
     const Zstring& linkRelPath = parentRelPathPf_ + si.itemName;
 
     //update status information no matter whether item is excluded or not!
-    if (cfg.acb_.mayReportCurrentFile(cfg.threadID_, cfg.lastReportTime))
-        cfg.acb_.reportCurrentFile(AFS::getDisplayPath(AFS::appendRelPath(cfg.baseFolderPath_, linkRelPath)));
+    if (cfg.acb_.mayReportCurrentFile(lastReportTime_))
+        cfg.acb_.reportCurrentFile(cfg.threadID_, linkRelPath);
 
     switch (cfg.handleSymlinks_)
     {
@@ -416,8 +768,8 @@ DirCallback::HandleLink DirCallback::onSymlink(const SymlinkInfo& si) //throw Th
         case SymLinkHandling::DIRECT:
             if (cfg.filter_->passFileFilter(linkRelPath)) //always use file filter: Link type may not be "stable" on Linux!
             {
-                output_.addSubLink(si.itemName, LinkDescriptor(si.lastWriteTime));
-                cfg.acb_.incItemsScanned(); //add 1 element to the progress indicator
+                output_.addSubLink(si.itemName, LinkDescriptor(si.lastWriteTime), arena_);
+                cfg.acb_.incItemsScanned(cfg.threadID_); //add 1 element to the progress indicator
             }
             return LINK_SKIP;
 
@@ -441,10 +793,16 @@ DirCallback::HandleLink DirCallback::onSymlink(const SymlinkInfo& si) //throw Th
 
 DirCallback::HandleError DirCallback::reportDirError(const std::wstring& msg, size_t retryNumber) //throw ThreadInterruption
 {
+    if (deferredErrors_) //a "retry" re-traverses the whole folder later, see FolderTaskPool::errorAnswered()
+    {
+        deferredErrors_->push_back({ true, beforeLast(parentRelPathPf_, FILE_NAME_SEPARATOR, IF_MISSING_RETURN_NONE), msg });
+        return ON_ERROR_IGNORE;
+    }
+
     switch (cfg.acb_.reportError(msg, retryNumber)) //throw ThreadInterruption
     {
         case FillBufferCallback::ON_ERROR_IGNORE:
-            cfg.failedDirReads_[beforeLast(parentRelPathPf_, FILE_NAME_SEPARATOR, IF_MISSING_RETURN_NONE)] = msg;
+            cfg.addFailedFolderRead(beforeLast(parentRelPathPf_, FILE_NAME_SEPARATOR, IF_MISSING_RETURN_NONE), msg);
             return ON_ERROR_IGNORE;
 
         case FillBufferCallback::ON_ERROR_RETRY:
@@ -457,10 +815,16 @@ DirCallback::HandleError DirCallback::reportDirError(const std::wstring& msg, si
 
 DirCallback::HandleError DirCallback::reportItemError(const std::wstring& msg, size_t retryNumber, const Zstring& itemName) //throw ThreadInterruption
 {
+    if (deferredErrors_)
+    {
+        deferredErrors_->push_back({ false, parentRelPathPf_ + itemName, msg });
+        return ON_ERROR_IGNORE;
+    }
+
     switch (cfg.acb_.reportError(msg, retryNumber)) //throw ThreadInterruption
     {
         case FillBufferCallback::ON_ERROR_IGNORE:
-            cfg.failedItemReads_[parentRelPathPf_ + itemName] =  msg;
+            cfg.addFailedItemRead(parentRelPathPf_ + itemName, msg);
             return ON_ERROR_IGNORE;
 
         case FillBufferCallback::ON_ERROR_RETRY:
@@ -470,6 +834,33 @@ DirCallback::HandleError DirCallback::reportItemError(const std::wstring& msg, s
     return ON_ERROR_IGNORE;
 }
 
+
+DirCallback::FolderCacheMode DirCallback::getFolderCacheMode() const
+{
+    switch (cfg.snapshotMode_)
+    {
+        case SCAN_SNAPSHOT_OFF:
+            return FOLDER_CACHE_OFF;
+        case SCAN_SNAPSHOT_FAST:
+            return FOLDER_CACHE_FAST;
+        case SCAN_SNAPSHOT_STRICT:
+            return FOLDER_CACHE_STRICT;
+    }
+    assert(false);
+    return FOLDER_CACHE_OFF;
+}
+
+
+const std::vector<DirCallback::FolderItem>* DirCallback::getCachedFolderContent(const FolderStamp& stamp)
+{
+    auto it = cfg.lastSnapshot.find(parentRelPathPf_);
+    if (it != cfg.lastSnapshot.end())
+        if (it->second.stamp.modTimeNs    == stamp.modTimeNs &&
+            it->second.stamp.changeTimeNs == stamp.changeTimeNs)
+            return &it->second.items;
+    return nullptr;
+}
+
 //------------------------------------------------------------------------------------------
 
 class WorkerThread
@@ -477,48 +868,251 @@ class WorkerThread
 public:
     WorkerThread(int threadID,
                  const std::shared_ptr<AsyncCallback>& acb,
+                 const std::shared_ptr<DeviceAccessScheduler>& scheduler,
                  const AbstractPath& baseFolderPath,   //always bound!
                  const HardFilter::FilterRef& filter, //
                  SymLinkHandling handleSymlinks,
+                 size_t threadsPerFolder,
+                 bool allowStaleAttributes,
+                 ScanSnapshotMode snapshotMode,
+                 bool deferErrors,
                  DirectoryValue& dirOutput) :
         acb_(acb),
+        scheduler_(scheduler),
         outputContainer(dirOutput.folderCont),
-        travCfg(threadID,
-                baseFolderPath,
-                filter,
-                handleSymlinks, //shared by all(!) instances of DirCallback while traversing a folder hierarchy
-                dirOutput.failedFolderReads,
-                dirOutput.failedItemReads,
-                *acb_) {}
+        nameArenas_(dirOutput.nameArenas),
+        threadCount_(std::max<size_t>(threadsPerFolder, 1)),
+        deferErrors_(deferErrors),
+        travCfg(std::make_shared<TraverserConfig>(threadID,
+                                                  baseFolderPath,
+                                                  filter,
+                                                  handleSymlinks, //shared by all(!) instances of DirCallback while traversing a folder hierarchy
+                                                  allowStaleAttributes,
+                                                  snapshotMode,
+                                                  dirOutput.failedFolderReads,
+                                                  dirOutput.failedItemReads,
+                                                  *acb_)) {}
 
     void operator()() //thread entry
     {
 #ifdef ZEN_WIN
         setCurrentThreadName("Folder Traverser");
 #endif
+        TickVal lastReportTime;
+        if (acb_->mayReportCurrentFile(lastReportTime))
+            acb_->reportCurrentFile(travCfg->threadID_, Zstring()); //just in case first directory access is blocking
+
+        //don't let multiple threads compete for the read head of a spinning disk:
+        const AFS::StorageDeviceInfo devInfo = AFS::getStorageDeviceInfo(travCfg->baseFolderPath_); //noexcept
+        const bool limitDeviceAccess = devInfo.rotational && !devInfo.deviceId.empty();
+
+        if (limitDeviceAccess)
+            scheduler_->acquire(devInfo.deviceId, travCfg->threadID_); //throw ThreadInterruption
+        ZEN_ON_SCOPE_EXIT(if (limitDeviceAccess) scheduler_->release(devInfo.deviceId));
+
+        if (travCfg->snapshotMode_ != SCAN_SNAPSHOT_OFF)
+            try
+            {
+                travCfg->lastSnapshot = loadScanSnapshot(travCfg->baseFolderPath_); //throw FileError
+            }
+            catch (FileError&) {} //snapshot is just a cache: traverse all folders and overwrite it
 
-        acb_->incActiveWorker();
-        ZEN_ON_SCOPE_EXIT(acb_->decActiveWorker());
+        const size_t threadCount = devInfo.rotational ? 1 : threadCount_;
 
-        if (acb_->mayReportCurrentFile(travCfg.threadID_, travCfg.lastReportTime))
-            acb_->reportCurrentFile(AFS::getDisplayPath(travCfg.baseFolderPath_)); //just in case first directory access is blocking
+        if (threadCount == 1 && !deferErrors_)
+        {
+            acb_->incActiveWorker(travCfg->threadID_);
+            ZEN_ON_SCOPE_EXIT(acb_->decActiveWorker(travCfg->threadID_));
 
-        DirCallback cb(travCfg, Zstring(), outputContainer, 0);
+            nameArenas_.emplace_back();
+            DirCallback cb(*travCfg, lastReportTime, Zstring(), outputContainer, nameArenas_.back(), 0, nullptr, nullptr);
 
-        AFS::traverseFolder(travCfg.baseFolderPath_, cb); //throw X
+            AFS::traverseFolder(travCfg->baseFolderPath_, cb); //throw X
+        }
+        else //deferred errors: traverse other sub folders while a failed folder waits for a response => requires task pool even for a single thread
+            traverseParallel(threadCount); //throw ThreadInterruption
+
+        outputContainer.finalize();
+
+        if (travCfg->snapshotMode_ != SCAN_SNAPSHOT_OFF)
+            for (size_t retryNumber = 0;; ++retryNumber)
+                try
+                {
+                    saveScanSnapshot(travCfg->baseFolderPath_, travCfg->currentSnapshot, travCfg->threadID_); //throw FileError
+                    break;
+                }
+                catch (const FileError& e)
+                {
+                    if (acb_->reportError(e.toString(), retryNumber) == FillBufferCallback::ON_ERROR_IGNORE) //throw ThreadInterruption
+                        break;
+                }
     }
 
 private:
+    //the resulting FolderContainer is identical to the single-threaded case: each folder is traversed by exactly one thread and containers are sorted maps
+    void traverseParallel(size_t threadCount) //throw ThreadInterruption
+    {
+        auto taskPool = std::make_shared<FolderTaskPool>(threadCount); //shared with AsyncCallback::queueError() responses
+        taskPool->push(0, { { Zstring(), &outputContainer, 0 } });
+
+        std::vector<NameArena*> arenas; //one per thread: allocate before starting helper threads
+        for (size_t threadIdx = 0; threadIdx < threadCount; ++threadIdx)
+        {
+            nameArenas_.emplace_back();
+            arenas.push_back(&nameArenas_.back());
+        }
+
+        FixedList<InterruptibleThread> helper;
+        ZEN_ON_SCOPE_EXIT
+        (
+            for (InterruptibleThread& ht : helper)
+                ht.interrupt(); //no-op if helper has finished already
+            for (InterruptibleThread& ht : helper)
+                ht.join();
+        );
+
+        for (size_t threadIdx = 1; threadIdx < threadCount; ++threadIdx)
+            helper.emplace_back([taskPool, threadIdx, travCfg = travCfg, acb = acb_, deferErrors = deferErrors_, &arena = *arenas[threadIdx]]
+            {
+                traverseTasks(taskPool, threadIdx, travCfg, *acb, deferErrors, arena);
+            });
+
+        traverseTasks(taskPool, 0, travCfg, *acb_, deferErrors_, *arenas[0]); //throw ThreadInterruption
+    }
+
+    static void traverseTasks(const std::shared_ptr<FolderTaskPool>& taskPool, size_t threadIdx, const std::shared_ptr<TraverserConfig>& cfg, AsyncCallback& acb, bool deferErrors,
+                              NameArena& arena) //throw ThreadInterruption
+    {
+        TickVal lastReportTime;
+        std::vector<DeferredFolder> deferredFolders;
+        std::vector<FolderTask> subFolders;
+        std::vector<ScanError> errors;
+
+        for (FolderTask task; taskPool->pop(threadIdx, task); ) //throw ThreadInterruption
+        {
+            acb.incActiveWorker(cfg->threadID_);
+            ZEN_ON_SCOPE_EXIT(acb.decActiveWorker(cfg->threadID_));
+
+            deferredFolders.clear();
+            subFolders.clear();
+            errors.clear();
+            DirCallback cb(*cfg, lastReportTime, task.relPathPf, *task.output, arena, task.level, &deferredFolders, deferErrors ? &errors : nullptr);
+
+            AFS::traverseFolder(AFS::appendRelPath(cfg->baseFolderPath_, beforeLast(task.relPathPf, FILE_NAME_SEPARATOR, IF_MISSING_RETURN_NONE)), cb); //throw X
+
+            //folder traversal "retry" may report the same sub folder more than once: keep the latest, consistent with FolderContainer::finalize()
+            std::stable_sort(deferredFolders.begin(), deferredFolders.end(), [](const DeferredFolder& lhs, const DeferredFolder& rhs) { return LessFilePath()(lhs.relPathPf, rhs.relPathPf); });
+
+            for (auto it = deferredFolders.begin(); it != deferredFolders.end(); ++it)
+                if (std::next(it) == deferredFolders.end() || LessFilePath()(it->relPathPf, std::next(it)->relPathPf))
+                    subFolders.push_back({ it->relPathPf, &task.output->folders.refData(it->folderPos), task.level + 1 }); //parent folder complete => addresses are stable
+
+            if (errors.empty())
+            {
+                taskPool->push(threadIdx, subFolders);
+                taskPool->taskDone();
+            }
+            else
+            {
+                const size_t parkedId = taskPool->parkTask(task, subFolders, errors.size());
+                auto parkedErrors = std::make_shared<std::vector<ScanError>>(errors);
+
+                for (const ScanError& error : errors)
+                    acb.queueError(error.msg, task.retryNumber, [taskPool, cfg, parkedId, parkedErrors](FillBufferCallback::HandleError rv)
+                {
+                    if (taskPool->errorAnswered(parkedId, rv)) //context of main thread
+                    {
+                        for (const ScanError& e : *parkedErrors)
+                            if (e.folderError)
+                                cfg->addFailedFolderRead(e.relPath, e.msg);
+                            else
+                                cfg->addFailedItemRead(e.relPath, e.msg);
+                    }
+                });
+            }
+        }
+    }
+
     std::shared_ptr<AsyncCallback> acb_;
+    std::shared_ptr<DeviceAccessScheduler> scheduler_;
     FolderContainer& outputContainer;
-    TraverserConfig travCfg;
+    std::list<NameArena>& nameArenas_;
+    const size_t threadCount_;
+    const bool deferErrors_;
+    std::shared_ptr<TraverserConfig> travCfg; //contains mutex => keep address stable when WorkerThread is moved
 };
+
+//------------------------------------------------------------------------------------------
+
+const FolderContainer* findFolder(const FolderContainer& baseFolder, const Zstring& folderRelPath) //folderRelPath: empty for base folder
+{
+    const FolderContainer* folder = &baseFolder;
+    if (!folderRelPath.empty())
+        for (const Zstring& itemName : split(folderRelPath, FILE_NAME_SEPARATOR))
+        {
+            auto it = folder->folders.find(itemName);
+            if (it == folder->folders.end())
+                return nullptr;
+            folder = &it->second;
+        }
+    return folder;
+}
+
+
+//derive the traversal result of a single filter from the traversal of a union filter: same filter logic as DirCallback!
+void deriveFolderContent(const FolderContainer& input, FolderContainer& output, NameArena& arena, const HardFilter& filter, const Zstring& parentRelPathPf)
+{
+    for (const auto& file : input.files)
+        if (filter.passFileFilter(parentRelPathPf + file.first.c_str()))
+            output.addSubFile(file.first, file.second, arena);
+
+    for (const auto& link : input.symlinks)
+        if (filter.passFileFilter(parentRelPathPf + link.first.c_str())) //always use file filter: see DirCallback::onSymlink()
+            output.addSubLink(link.first, link.second, arena);
+
+    for (const auto& folder : input.folders)
+    {
+        const Zstring& folderRelPath = parentRelPathPf + folder.first.c_str();
+
+        bool childItemMightMatch = true;
+        const bool passFilter = filter.passDirFilter(folderRelPath, &childItemMightMatch);
+        if (passFilter || childItemMightMatch)
+            deriveFolderContent(folder.second, output.addSubFolder(folder.first, arena), arena, filter, folderRelPath + FILE_NAME_SEPARATOR);
+    }
+}
+
+
+void deriveDirectoryValue(const DirectoryValue& input, DirectoryValue& output, const HardFilter& filter)
+{
+    output.nameArenas.emplace_back();
+    deriveFolderContent(input.folderCont, output.folderCont, output.nameArenas.back(), filter, Zstring());
+    output.folderCont.finalize(); //no-op: input is sorted already
+
+    //keep errors for folders which would have been traversed:
+    for (const auto& item : input.failedFolderReads)
+        if (findFolder(output.folderCont, item.first))
+            output.failedFolderReads.insert(item);
+
+    //keep errors for items which would not have been skipped by the filter:
+    for (const auto& item : input.failedItemReads)
+        if (findFolder(output.folderCont, beforeLast(item.first, FILE_NAME_SEPARATOR, IF_MISSING_RETURN_NONE)))
+        {
+            bool childItemMightMatch = true;
+            if (filter.passFileFilter(item.first) ||
+                filter.passDirFilter(item.first, &childItemMightMatch) || childItemMightMatch)
+                output.failedItemReads.insert(item);
+        }
+}
 }
 
 
 void zen::fillBuffer(const std::set<DirectoryKey>& keysToRead, //in
                      std::map<DirectoryKey, DirectoryValue>& buf, //out
                      FillBufferCallback& callback,
+                     size_t threadsPerFolder,
+                     bool allowStaleAttributes,
+                     ScanSnapshotMode snapshotMode,
+                     bool deferErrors,
                      size_t updateIntervalMs)
 {
     buf.clear();
@@ -534,36 +1128,116 @@ void zen::fillBuffer(const std::set<DirectoryKey>& keysToRead, //in
                 wt.join();     //in this context it is possible a thread is *not* joinable anymore due to the thread::try_join_for() below!
             );
 
-    auto acb = std::make_shared<AsyncCallback>(updateIntervalMs / 2 /*reportingIntervalMs*/);
+    //scan each physical folder only once: folder pairs referencing the same folder with different filters share a traversal using the union of all filters
+    std::map<DirectoryKey, std::vector<DirectoryKey>> sharedKeys; //key: union filter => value: keys to derive
+    std::set<DirectoryKey> keysToScan;
 
-    //init worker threads
-    for (const DirectoryKey& key : keysToRead)
+    for (auto it = keysToRead.begin(); it != keysToRead.end();)
     {
-        assert(buf.find(key) == buf.end());
-        DirectoryValue& dirOutput = buf[key];
+        //keys are sorted by symlink handling and folder path first => keys for the same physical folder are adjacent
+        auto itEnd = std::find_if(it, keysToRead.end(), [&](const DirectoryKey& key)
+        {
+            return key.handleSymlinks_ != it->handleSymlinks_ ||
+                   AFS::LessAbstractPath()(it->folderPath_, key.folderPath_);
+        });
+
+        if (std::next(it) == itEnd)
+            keysToScan.insert(*it);
+        else
+        {
+            std::vector<HardFilter::FilterRef> filters;
+            std::for_each(it, itEnd, [&](const DirectoryKey& key) { filters.push_back(key.filter_); });
+
+            const DirectoryKey unionKey(it->folderPath_, unionFilters(filters), it->handleSymlinks_);
+            sharedKeys.emplace(unionKey, std::vector<DirectoryKey>(it, itEnd));
+        }
+        it = itEnd;
+    }
 
+    std::map<DirectoryKey, DirectoryValue> sharedBuf;
+
+    std::vector<AbstractPath> workerFolderPaths; //indexed by thread ID: same order as worker threads are created below
+    for (const DirectoryKey& key : keysToScan)
+        workerFolderPaths.push_back(key.folderPath_);
+    for (const auto& item : sharedKeys)
+        workerFolderPaths.push_back(item.first.folderPath_);
+
+    auto acb       = std::make_shared<AsyncCallback>(workerFolderPaths, updateIntervalMs / 2 /*reportingIntervalMs*/);
+    auto scheduler = std::make_shared<DeviceAccessScheduler>();
+
+    //init worker threads
+    auto startWorker = [&](const DirectoryKey& key, DirectoryValue& dirOutput)
+    {
         const int threadId = static_cast<int>(worker.size());
         worker.emplace_back(WorkerThread(threadId,
                                          acb,
+                                         scheduler,
                                          key.folderPath_, //AbstractPath is thread-safe like an int! :)
                                          key.filter_,
                                          key.handleSymlinks_,
+                                         threadsPerFolder,
+                                         allowStaleAttributes,
+                                         snapshotMode,
+                                         deferErrors,
                                          dirOutput));
+    };
+
+    for (const DirectoryKey& key : keysToScan)
+    {
+        assert(buf.find(key) == buf.end());
+        startWorker(key, buf[key]);
     }
+    for (const auto& item : sharedKeys)
+        startWorker(item.first, sharedBuf[item.first]);
 
-    //wait until done
-    for (InterruptibleThread& wt : worker)
+    struct PendingWorker
     {
-        do
-        {
-            //update status
-            callback.reportStatus(acb->getCurrentStatus(), acb->getItemsScanned()); //throw!
+        int threadId;
+        InterruptibleThread* thread;
+        const DirectoryKey* key;
+        const std::vector<DirectoryKey>* derivedKeys; //nullptr if not a shared traversal
+    };
+    std::vector<PendingWorker> pendingWorker;
+    for (const DirectoryKey& key : keysToScan)
+        pendingWorker.push_back({ static_cast<int>(pendingWorker.size()), nullptr, &key, nullptr });
+    for (const auto& item : sharedKeys)
+        pendingWorker.push_back({ static_cast<int>(pendingWorker.size()), nullptr, &item.first, &item.second });
+    {
+        auto itPending = pendingWorker.begin();
+        for (InterruptibleThread& wt : worker)
+            (itPending++)->thread = &wt; //same order as worker threads were created
+    }
 
-            //process errors
-            acb->processErrors(callback);
-        }
-        while (!wt.tryJoinFor(std::chrono::milliseconds(updateIntervalMs)));
+    //wait until done: folders are reported as soon as they are complete, not in order => caller may process them while others are still being scanned
+    while (!pendingWorker.empty())
+    {
+        acb->setNotifyingThreadId(pendingWorker.front().threadId); //process info messages of one thread at a time only
 
-        acb->incrementNotifyingThreadId(); //process info messages of one thread at a time only
+        //update status
+        callback.reportStatus(acb->getCurrentStatus(), acb->getItemsScanned()); //throw!
+
+        //process errors
+        acb->processErrors(callback);
+
+        std::vector<PendingWorker> stillPending;
+        bool haveWaited = false;
+        for (const PendingWorker& pw : pendingWorker)
+        {
+            const bool finished = pw.thread->tryJoinFor(std::chrono::milliseconds(haveWaited ? 0 : updateIntervalMs));
+            haveWaited = true;
+
+            if (!finished)
+                stillPending.push_back(pw);
+            else if (!pw.derivedKeys)
+                callback.reportFolderScanned(*pw.key); //throw!
+            else
+                for (const DirectoryKey& key : *pw.derivedKeys)
+                {
+                    assert(buf.find(key) == buf.end());
+                    deriveDirectoryValue(sharedBuf[*pw.key], buf[key], *key.filter_);
+                    callback.reportFolderScanned(key); //throw!
+                }
+        }
+        pendingWorker.swap(stillPending);
     }
 }
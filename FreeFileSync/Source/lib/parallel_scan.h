@@ -9,7 +9,9 @@
 
 #include <map>
 #include <set>
+#include <list>
 #include "hard_filter.h"
+#include "scan_snapshot.h"
 #include "../structures.h"
 #include "../file_hierarchy.h"
 
@@ -49,6 +51,8 @@ bool operator<(const DirectoryKey& lhs, const DirectoryKey& rhs)
 struct DirectoryValue
 {
     FolderContainer folderCont;
+    std::list<NameArena> nameArenas; //item names of folderCont: one arena per traversing thread
+
     //relative names (or empty string for root) for directories that could not be read (completely), e.g. access denied, or temporal network drop
     std::map<Zstring, std::wstring, LessFilePath> failedFolderReads; //with corresponding error message
 
@@ -68,13 +72,25 @@ struct FillBufferCallback
     };
     virtual HandleError reportError (const std::wstring& msg, size_t retryNumber) = 0; //may throw!
     virtual void        reportStatus(const std::wstring& msg, int    itemsTotal ) = 0; //
+
+    //buf[key] is complete: called while other folders are still being scanned => process scan results early
+    virtual void reportFolderScanned(const DirectoryKey& key) = 0; //may throw!
 };
 
 //attention: ensure directory filtering is applied later to exclude filtered directories which have been kept as parent folders
 
+//threadsPerFolder: number of threads traversing a single base folder: 1 = sequential traversal; > 1 = sub folders are distributed via work-stealing
+//                  folders on spinning disks are always traversed sequentially, one folder per disk at a time
+//allowStaleAttributes: see AFS::TraverserCallback::allowStaleAttributes()
+//snapshotMode: reuse content of folders which are unchanged since the last traversal, see scan_snapshot.h
+//deferErrors: queue traversal errors instead of waiting for a response: worker threads continue with other sub folders, "retry" traverses a failed folder again
 void fillBuffer(const std::set<DirectoryKey>& keysToRead, //in
                 std::map<DirectoryKey, DirectoryValue>& buf, //out
                 FillBufferCallback& callback,
+                size_t threadsPerFolder,
+                bool allowStaleAttributes,
+                ScanSnapshotMode snapshotMode,
+                bool deferErrors,
                 size_t updateIntervalMs); //unit: [ms]
 }
 
@@ -204,6 +204,9 @@ void writeText(const CompareVariant& value, std::string& output)
         case CompareVariant::SIZE:
             output = "Size";
             break;
+        case CompareVariant::CONTENT_SAMPLED:
+            output = "ContentSampled";
+            break;
     }
 }
 
@@ -217,6 +220,8 @@ bool readText(const std::string& input, CompareVariant& value)
         value = CompareVariant::CONTENT;
     else if (tmp == "Size")
         value = CompareVariant::SIZE;
+    else if (tmp == "ContentSampled")
+        value = CompareVariant::CONTENT_SAMPLED;
     else
         return false;
     return true;
@@ -417,6 +422,39 @@ bool readText(const std::string& input, SymLinkHandling& value)
 }
 
 
+template <> inline
+void writeText(const ScanSnapshotMode& value, std::string& output)
+{
+    switch (value)
+    {
+        case SCAN_SNAPSHOT_OFF:
+            output = "Off";
+            break;
+        case SCAN_SNAPSHOT_FAST:
+            output = "Fast";
+            break;
+        case SCAN_SNAPSHOT_STRICT:
+            output = "Strict";
+            break;
+    }
+}
+
+template <> inline
+bool readText(const std::string& input, ScanSnapshotMode& value)
+{
+    const std::string tmp = trimCpy(input);
+    if (tmp == "Off")
+        value = SCAN_SNAPSHOT_OFF;
+    else if (tmp == "Fast")
+        value = SCAN_SNAPSHOT_FAST;
+    else if (tmp == "Strict")
+        value = SCAN_SNAPSHOT_STRICT;
+    else
+        return false;
+    return true;
+}
+
+
 template <> inline
 void writeText(const ColumnTypeRim& value, std::string& output)
 {
@@ -1043,6 +1081,17 @@ void readConfig(const XmlIn& in, XmlGlobalSettings& config, int formatVer)
     inGeneral["AutomaticRetry"           ].attribute("Delay"  , config.automaticRetryDelay);
     inGeneral["FileTimeTolerance"        ].attribute("Seconds", config.fileTimeTolerance);
     inGeneral["FolderAccessTimeout"      ].attribute("Seconds", config.folderAccessTimeout);
+    inGeneral["ScanThreadsPerFolder"     ].attribute("Count"  , config.scanThreadsPerFolder);
+    inGeneral["ScanAllowStaleAttributes" ].attribute("Enabled", config.scanAllowStaleAttributes);
+    inGeneral["ScanSnapshot"             ].attribute("Mode"   , config.scanSnapshotMode);
+    inGeneral["ScanDeferErrors"          ].attribute("Enabled", config.scanDeferErrors);
+    inGeneral["ContentCompareThreads"    ].attribute("Count"  , config.contentCompareThreads);
+    inGeneral["ContentHashCache"         ].attribute("Enabled", config.contentHashCache);
+    inGeneral["TrustSyncDatabase"        ].attribute("Enabled", config.trustSyncDatabase);
+    inGeneral["SampledContentCompare"    ].attribute("Blocks" , config.sampledCompareBlocks);
+    inGeneral["SampledContentCompare"    ].attribute("FullComparePercent", config.sampledCompareFullPercent);
+    inGeneral["DiskOrderedAccess"        ].attribute("Enabled", config.diskOrderedAccess);
+    inGeneral["OutOfCoreComparison"      ].attribute("Folder" , config.outOfCoreFolderPath);
     inGeneral["RunWithBackgroundPriority"].attribute("Enabled", config.runWithBackgroundPriority);
     inGeneral["LockDirectoriesDuringSync"].attribute("Enabled", config.createLockFile);
     inGeneral["VerifyCopiedFiles"        ].attribute("Enabled", config.verifyFileCopy);
@@ -1489,6 +1538,17 @@ void writeConfig(const XmlGlobalSettings& config, XmlOut& out)
     outGeneral["AutomaticRetry"           ].attribute("Delay"  , config.automaticRetryDelay);
     outGeneral["FileTimeTolerance"        ].attribute("Seconds", config.fileTimeTolerance);
     outGeneral["FolderAccessTimeout"      ].attribute("Seconds", config.folderAccessTimeout);
+    outGeneral["ScanThreadsPerFolder"     ].attribute("Count"  , config.scanThreadsPerFolder);
+    outGeneral["ScanAllowStaleAttributes" ].attribute("Enabled", config.scanAllowStaleAttributes);
+    outGeneral["ScanSnapshot"             ].attribute("Mode"   , config.scanSnapshotMode);
+    outGeneral["ScanDeferErrors"          ].attribute("Enabled", config.scanDeferErrors);
+    outGeneral["ContentCompareThreads"    ].attribute("Count"  , config.contentCompareThreads);
+    outGeneral["ContentHashCache"         ].attribute("Enabled", config.contentHashCache);
+    outGeneral["TrustSyncDatabase"        ].attribute("Enabled", config.trustSyncDatabase);
+    outGeneral["SampledContentCompare"    ].attribute("Blocks" , config.sampledCompareBlocks);
+    outGeneral["SampledContentCompare"    ].attribute("FullComparePercent", config.sampledCompareFullPercent);
+    outGeneral["DiskOrderedAccess"        ].attribute("Enabled", config.diskOrderedAccess);
+    outGeneral["OutOfCoreComparison"      ].attribute("Folder" , config.outOfCoreFolderPath);
     outGeneral["RunWithBackgroundPriority"].attribute("Enabled", config.runWithBackgroundPriority);
     outGeneral["LockDirectoriesDuringSync"].attribute("Enabled", config.createLockFile);
     outGeneral["VerifyCopiedFiles"        ].attribute("Enabled", config.verifyFileCopy);
@@ -10,6 +10,7 @@
 #include <zen/xml_io.h>
 #include <wx/gdicmn.h>
 #include "localization.h"
+#include "scan_snapshot.h"
 #include "../structures.h"
 #include "../ui/column_attr.h"
 
@@ -148,6 +149,19 @@ struct XmlGlobalSettings
 
     int fileTimeTolerance = 2; //max. allowed file time deviation; < 0 means unlimited tolerance; default 2s: FAT vs NTFS
     int folderAccessTimeout = 20;  //unit: [s]; consider CD-ROM insert or hard disk spin up time from sleep
+    size_t scanThreadsPerFolder = 1; //> 1: traverse sub folders of a single base folder in parallel
+    bool scanAllowStaleAttributes = false; //don't force revalidation of cached file attributes on network shares during comparison (Linux: statx AT_STATX_DONT_SYNC)
+    zen::ScanSnapshotMode scanSnapshotMode = zen::SCAN_SNAPSHOT_OFF; //skip enumeration of folders unchanged since last comparison
+    bool scanDeferErrors = false; //continue scanning other folders while an error waits for a response
+    size_t contentCompareThreads = 4; //compare by content: files compared concurrently per pair of devices; spinning disks: always one
+    bool contentHashCache = false; //compare by content: trust stored hashes of files unchanged (file id, size, modification time) since the last comparison
+    bool trustSyncDatabase = false; //compare by content, two way: files unchanged (file id, size, modification and change time) since the last sync are equal without reading
+    size_t sampledCompareBlocks = 16;     //CompareVariant::CONTENT_SAMPLED: 1 MB blocks compared in addition to head and tail
+    size_t sampledCompareFullPercent = 0; //CompareVariant::CONTENT_SAMPLED: compare this share of files completely nevertheless; 0 - 100
+    //=> selected by hash of the relative path: the same files on each run, a different set needs renaming
+    bool diskOrderedAccess = false; //spinning disks: compare and copy files in the order of their physical location instead of hierarchy order
+    Zstring outOfCoreFolderPath; //huge comparisons: keep comparison rows and item names in a memory-mapped temporary file in this folder; empty: disabled
+    //=> reduces, but doesn't bound RAM: object handles (16 bytes per row), file ids and the scan result while comparing stay in RAM
     bool runWithBackgroundPriority = false;
     bool createLockFile = true;
     bool verifyFileCopy = false;
@@ -0,0 +1,179 @@
+// *****************************************************************************
+// * This file is part of the FreeFileSync project. It is distributed under    *
+// * GNU General Public License: http://www.gnu.org/licenses/gpl-3.0           *
+// * Copyright (C) Zenju (zenju AT freefilesync DOT org) - All Rights Reserved *
+// *****************************************************************************
+
+#include "scan_snapshot.h"
+#include <zen/file_access.h>
+#include <zen/file_io.h>
+#include <zen/scope_guard.h>
+#include <wx+/zlib_wrap.h>
+#include "ffs_paths.h"
+
+using namespace zen;
+
+
+namespace
+{
+//-------------------------------------------------------------------------------------------------------------------------------
+const char FILE_FORMAT_DESCR[] = "FreeFileSync";
+const int SNAPSHOT_FORMAT_VER = 1;
+//-------------------------------------------------------------------------------------------------------------------------------
+
+using MemStreamOut = MemoryStreamOut<ByteArray>;
+using MemStreamIn  = MemoryStreamIn <ByteArray>;
+
+//-----------------------------------------------------------------------------------
+//| ensure 32/64 bit portability: use fixed size data types only e.g. std::uint32_t |
+//-----------------------------------------------------------------------------------
+
+Zstring getSnapshotFilePath(const AbstractPath& baseFolderPath)
+{
+    //FNV-1a: short and stable file name for arbitrary folder paths; collisions are detected when loading
+    std::uint64_t hash = 14695981039346656037ULL;
+    for (const char c : utfCvrtTo<std::string>(AFS::getInitPathPhrase(baseFolderPath)))
+    {
+        hash ^= static_cast<unsigned char>(c);
+        hash *= 1099511628211ULL;
+    }
+
+    Zstring fileName;
+    for (int i = 60; i >= 0; i -= 4)
+        fileName += "0123456789abcdef"[(hash >> i) & 0xf];
+
+    return getConfigDir() + Zstr("ScanSnapshots") + FILE_NAME_SEPARATOR + fileName + SCAN_SNAPSHOT_FILE_ENDING;
+}
+
+
+void writeUtf8(MemStreamOut& output, const Zstring& str) { writeContainer(output, utfCvrtTo<Zbase<char>>(str)); }
+
+Zstring readUtf8(MemStreamIn& input) { return utfCvrtTo<Zstring>(readContainer<Zbase<char>>(input)); } //throw UnexpectedEndOfStreamError
+}
+
+
+void zen::saveScanSnapshot(const AbstractPath& baseFolderPath, const ScanSnapshot& snapshot, int threadID) //throw FileError
+{
+    const Zstring filePath = getSnapshotFilePath(baseFolderPath);
+
+    MemStreamOut streamFolders;
+    writeNumber<std::uint32_t>(streamFolders, static_cast<std::uint32_t>(snapshot.size()));
+    for (const auto& folder : snapshot)
+    {
+        writeUtf8(streamFolders, folder.first);
+        writeNumber<std::int64_t>(streamFolders, folder.second.stamp.modTimeNs);
+        writeNumber<std::int64_t>(streamFolders, folder.second.stamp.changeTimeNs);
+
+        writeNumber<std::uint32_t>(streamFolders, static_cast<std::uint32_t>(folder.second.items.size()));
+        for (const AFS::TraverserCallback::FolderItem& item : folder.second.items)
+        {
+            writeUtf8(streamFolders, item.itemName);
+            writeNumber<std::int8_t>(streamFolders, static_cast<std::int8_t>(item.type));
+            writeNumber<std::uint64_t>(streamFolders, item.fileSize);
+            writeNumber<std::int64_t>(streamFolders, item.lastWriteTime);
+            writeContainer(streamFolders, item.id);
+            static_assert(IsSameType<decltype(item.id), Zbase<char>>::value, "");
+        }
+    }
+
+    ByteArray folderData;
+    try
+    {
+        folderData = compress(streamFolders.ref(), 3); //throw ZlibInternalError; level 3: see db_file.cpp
+    }
+    catch (ZlibInternalError&)
+    {
+        throw FileError(replaceCpy(_("Cannot write file %x."), L"%x", fmtPath(filePath)), L"zlib internal error");
+    }
+
+    MemStreamOut streamOut;
+    writeArray(streamOut, FILE_FORMAT_DESCR, sizeof(FILE_FORMAT_DESCR));
+    writeNumber<std::int32_t>(streamOut, SNAPSHOT_FORMAT_VER);
+    writeUtf8(streamOut, AFS::getInitPathPhrase(baseFolderPath));
+    writeContainer<ByteArray>(streamOut, folderData);
+
+    makeDirectoryRecursively(beforeLast(filePath, FILE_NAME_SEPARATOR, IF_MISSING_RETURN_NONE)); //throw FileError
+
+    //write as a transaction: snapshot may be saved by concurrent comparisons, e.g. two folder pairs with the same base folder
+    const Zstring tmpFilePath = filePath + Zstr(".") + numberTo<Zstring>(threadID) + Zstr(".tmp");
+
+    saveBinContainer(tmpFilePath, streamOut.ref(), nullptr); //throw FileError
+    ZEN_ON_SCOPE_FAIL(try { removeFile(tmpFilePath); }
+    catch (FileError&) {});
+
+    removeFile(filePath); //throw FileError
+    try
+    {
+        renameFile(tmpFilePath, filePath); //throw FileError, ErrorDifferentVolume, ErrorTargetExisting
+    }
+    catch (ErrorTargetExisting&) //concurrent writer was faster: either snapshot will do
+    {
+        removeFile(tmpFilePath); //throw FileError
+    }
+}
+
+
+ScanSnapshot zen::loadScanSnapshot(const AbstractPath& baseFolderPath) //throw FileError
+{
+    const Zstring filePath = getSnapshotFilePath(baseFolderPath);
+
+    if (!fileExists(filePath))
+        return ScanSnapshot();
+
+    try
+    {
+        const ByteArray buffer = loadBinContainer<ByteArray>(filePath, nullptr); //throw FileError
+        MemStreamIn streamIn(buffer);
+
+        char formatDescr[sizeof(FILE_FORMAT_DESCR)] = {};
+        readArray(streamIn, formatDescr, sizeof(formatDescr)); //throw UnexpectedEndOfStreamError
+
+        if (!std::equal(FILE_FORMAT_DESCR, FILE_FORMAT_DESCR + sizeof(FILE_FORMAT_DESCR), formatDescr) ||
+            readNumber<std::int32_t>(streamIn) != SNAPSHOT_FORMAT_VER) //throw UnexpectedEndOfStreamError
+            return ScanSnapshot(); //outdated snapshot: just traverse all folders once
+
+        if (readUtf8(streamIn) != AFS::getInitPathPhrase(baseFolderPath)) //throw UnexpectedEndOfStreamError
+            return ScanSnapshot(); //hash collision
+
+        ByteArray folderData;
+        try
+        {
+            folderData = decompress(readContainer<ByteArray>(streamIn)); //throw UnexpectedEndOfStreamError, ZlibInternalError
+        }
+        catch (ZlibInternalError&)
+        {
+            throw FileError(replaceCpy(_("Cannot read file %x."), L"%x", fmtPath(filePath)), L"zlib internal error");
+        }
+        MemStreamIn streamFolders(folderData);
+
+        ScanSnapshot snapshot;
+
+        size_t folderCount = readNumber<std::uint32_t>(streamFolders); //throw UnexpectedEndOfStreamError
+        while (folderCount-- != 0)
+        {
+            const Zstring folderRelPathPf = readUtf8(streamFolders);
+            FolderSnapshot& folder = snapshot[folderRelPathPf];
+
+            folder.stamp.modTimeNs    = readNumber<std::int64_t>(streamFolders);
+            folder.stamp.changeTimeNs = readNumber<std::int64_t>(streamFolders);
+
+            size_t itemCount = readNumber<std::uint32_t>(streamFolders);
+            folder.items.reserve(itemCount);
+            while (itemCount-- != 0)
+            {
+                AFS::TraverserCallback::FolderItem item;
+                item.itemName      = readUtf8(streamFolders);
+                item.type          = static_cast<AFS::TraverserCallback::FolderItemType>(readNumber<std::int8_t>(streamFolders));
+                item.fileSize      = readNumber<std::uint64_t>(streamFolders);
+                item.lastWriteTime = readNumber<std::int64_t>(streamFolders);
+                item.id            = readContainer<Zbase<char>>(streamFolders);
+                folder.items.push_back(std::move(item));
+            }
+        }
+        return snapshot;
+    }
+    catch (UnexpectedEndOfStreamError&)
+    {
+        throw FileError(replaceCpy(_("Cannot read file %x."), L"%x", fmtPath(filePath)), L"Unexpected end of stream.");
+    }
+}
@@ -0,0 +1,40 @@
+// *****************************************************************************
+// * This file is part of the FreeFileSync project. It is distributed under    *
+// * GNU General Public License: http://www.gnu.org/licenses/gpl-3.0           *
+// * Copyright (C) Zenju (zenju AT freefilesync DOT org) - All Rights Reserved *
+// *****************************************************************************
+
+#ifndef SCAN_SNAPSHOT_H_3479027834650923474
+#define SCAN_SNAPSHOT_H_3479027834650923474
+
+#include <map>
+#include <zen/file_error.h>
+#include "../file_hierarchy.h"
+
+
+namespace zen
+{
+const Zchar SCAN_SNAPSHOT_FILE_ENDING[] = Zstr(".ffs_scan"); //don't use Zstring as global constant: avoid static initialization order problem in global namespace!
+
+enum ScanSnapshotMode
+{
+    SCAN_SNAPSHOT_OFF,
+    SCAN_SNAPSHOT_FAST,   //unchanged folders: reuse item names and file attributes => modifications of existing files are NOT detected!
+    SCAN_SNAPSHOT_STRICT, //unchanged folders: reuse item names, but read file attributes
+};
+
+//raw folder content of the last traversal: folders with unchanged modification/change time need not be enumerated again
+struct FolderSnapshot
+{
+    AFS::TraverserCallback::FolderStamp stamp;
+    std::vector<AFS::TraverserCallback::FolderItem> items;
+};
+
+using ScanSnapshot = std::map<Zstring, FolderSnapshot>; //key: folder path relative to base folder, postfixed with FILE_NAME_SEPARATOR; base folder: empty string
+
+//snapshots are stored in the config folder, one per base folder
+ScanSnapshot loadScanSnapshot(const AbstractPath& baseFolderPath); //throw FileError; return empty snapshot if not existing
+void         saveScanSnapshot(const AbstractPath& baseFolderPath, const ScanSnapshot& snapshot, int threadID); //throw FileError; threadID: distinguish temporary files of concurrent writers
+}
+
+#endif //SCAN_SNAPSHOT_H_3479027834650923474
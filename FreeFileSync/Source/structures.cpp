@@ -61,6 +61,8 @@ std::wstring zen::getVariantName(CompareVariant var)
             return _("File content");
         case CompareVariant::SIZE:
             return _("File size");
+        case CompareVariant::CONTENT_SAMPLED:
+            return _("File content (sampled)");
     }
     assert(false);
     return _("Error");
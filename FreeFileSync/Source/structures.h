@@ -17,7 +17,8 @@ enum class CompareVariant
 {
     TIME_SIZE,
     CONTENT,
-    SIZE
+    SIZE,
+    CONTENT_SAMPLED //compare head, tail and a few blocks in between: quick check for huge files
 };
 
 std::wstring getVariantName(CompareVariant var);
@@ -46,7 +47,7 @@ enum CompareFilesResult
     FILE_RIGHT_SIDE_ONLY,
     FILE_LEFT_NEWER,  //CompareVariant::TIME_SIZE only!
     FILE_RIGHT_NEWER, //
-    FILE_DIFFERENT_CONTENT, //CompareVariant::CONTENT, CompareVariant::SIZE only!
+    FILE_DIFFERENT_CONTENT, //CompareVariant::CONTENT, CompareVariant::CONTENT_SAMPLED, CompareVariant::SIZE only!
     FILE_DIFFERENT_METADATA, //both sides equal, but different metadata only: short name case
     FILE_CONFLICT
 };
@@ -108,7 +109,7 @@ struct DirectionSet
     SyncDirection exRightSideOnly = SyncDirection::LEFT;
     SyncDirection leftNewer       = SyncDirection::RIGHT; //CompareVariant::TIME_SIZE only!
     SyncDirection rightNewer      = SyncDirection::LEFT;  //
-    SyncDirection different       = SyncDirection::NONE; //CompareVariant::CONTENT, CompareVariant::SIZE only!
+    SyncDirection different       = SyncDirection::NONE; //CompareVariant::CONTENT, CompareVariant::CONTENT_SAMPLED, CompareVariant::SIZE only!
     SyncDirection conflict        = SyncDirection::NONE;
 };
 
@@ -7,11 +7,13 @@
 #include "synchronization.h"
 #include <zen/process_priority.h>
 #include <zen/perf.h>
+#include <zen/format_unit.h>
 #include "lib/db_file.h"
 #include "lib/dir_exist_async.h"
 #include "lib/status_handler_impl.h"
 #include "lib/versioning.h"
 #include "lib/binary.h"
+#include "lib/disk_order.h"
 #include "fs/concrete.h"
 #include "fs/native.h"
 
@@ -58,8 +60,70 @@ SyncStatistics::SyncStatistics(const FilePair& file)
 }
 
 
-inline
 void SyncStatistics::recurse(const HierarchyObject& hierObj)
+{
+    HierarchyObject::SyncStatsBuffer& buf = hierObj.statsBuffered;
+
+    if (hierObj.haveBufferedStats)
+    {
+        if (buf.conflictCount > 0)
+            collectConflicts(hierObj);
+    }
+    else //only subtrees changed since the last call need to be evaluated: see HierarchyObject::notifySyncCfgChanged()
+    {
+        SyncStatistics subStats;
+        subStats.processChildren(hierObj);
+
+        buf.createLeft    = subStats.createLeft;
+        buf.createRight   = subStats.createRight;
+        buf.updateLeft    = subStats.updateLeft;
+        buf.updateRight   = subStats.updateRight;
+        buf.deleteLeft    = subStats.deleteLeft;
+        buf.deleteRight   = subStats.deleteRight;
+        buf.conflictCount = subStats.conflictCount();
+        buf.dataToProcess = subStats.dataToProcess;
+        buf.rowsTotal     = subStats.rowsTotal;
+        hierObj.haveBufferedStats = true;
+
+        conflictMsgs.insert(conflictMsgs.end(), std::make_move_iterator(subStats.conflictMsgs.begin()), std::make_move_iterator(subStats.conflictMsgs.end()));
+    }
+
+    createLeft    += buf.createLeft;
+    createRight   += buf.createRight;
+    updateLeft    += buf.updateLeft;
+    updateRight   += buf.updateRight;
+    deleteLeft    += buf.deleteLeft;
+    deleteRight   += buf.deleteRight;
+    dataToProcess += buf.dataToProcess;
+    rowsTotal     += buf.rowsTotal;
+}
+
+
+void SyncStatistics::collectConflicts(const HierarchyObject& hierObj)
+{
+    //same order as processChildren()
+    for (const FilePair& file : hierObj.refSubFiles())
+        if (file.getSyncOperation() == SO_UNRESOLVED_CONFLICT)
+            conflictMsgs.emplace_back(file.getPairRelativePath(), file.getSyncOpConflict());
+
+    for (const SymlinkPair& link : hierObj.refSubLinks())
+        if (link.getSyncOperation() == SO_UNRESOLVED_CONFLICT)
+            conflictMsgs.emplace_back(link.getPairRelativePath(), link.getSyncOpConflict());
+
+    for (const FolderPair& folder : hierObj.refSubFolders())
+    {
+        if (folder.getSyncOperation() == SO_UNRESOLVED_CONFLICT)
+            conflictMsgs.emplace_back(folder.getPairRelativePath(), folder.getSyncOpConflict());
+
+        assert(folder.haveBufferedStats);
+        if (folder.statsBuffered.conflictCount > 0)
+            collectConflicts(folder);
+    }
+}
+
+
+inline
+void SyncStatistics::processChildren(const HierarchyObject& hierObj)
 {
     for (const FilePair& file : hierObj.refSubFiles())
         processFile(file);
@@ -619,6 +683,8 @@ public:
                           bool verifyCopiedFiles,
                           bool copyFilePermissions,
                           bool failSafeFileCopy,
+                          bool diskOrderLeft,
+                          bool diskOrderRight,
 #ifdef ZEN_WIN
                           shadow::ShadowCopy* shadowCopyHandler,
 #endif
@@ -632,13 +698,16 @@ public:
         delHandlingRight_(delHandlingRight),
         verifyCopiedFiles_(verifyCopiedFiles),
         copyFilePermissions_(copyFilePermissions),
-        failSafeFileCopy_(failSafeFileCopy) {}
+        failSafeFileCopy_(failSafeFileCopy),
+        diskOrderLeft_(diskOrderLeft),
+        diskOrderRight_(diskOrderRight) {}
 
     void startSync(BaseFolderPair& baseFolder)
     {
         runZeroPass(baseFolder);       //first process file moves
         runPass<PASS_ONE>(baseFolder); //delete files (or overwrite big ones with smaller ones)
         runPass<PASS_TWO>(baseFolder); //copy rest
+        runDiskOrderPass();            //copy files deferred by PASS_TWO: all target folders exist by now
     }
 
 private:
@@ -663,6 +732,9 @@ private:
     template <PassId pass>
     void runPass(HierarchyObject& hierObj);
 
+    bool deferToDiskOrderPass(FilePair& file); //PASS_TWO: copy from a spinning disk => defer and read source files in the order of their physical location
+    void runDiskOrderPass();
+
     void synchronizeFile(FilePair& file);
     template <SelectedSide side> void synchronizeFileInt(FilePair& file, SyncOperation syncOp);
 
@@ -699,6 +771,9 @@ private:
     const bool verifyCopiedFiles_;
     const bool copyFilePermissions_;
     const bool failSafeFileCopy_;
+    const bool diskOrderLeft_;  //source side located on a spinning disk
+    const bool diskOrderRight_; //
+    std::vector<std::pair<FilePair*, SelectedSide>> diskOrderFiles_; //file to copy, source side
 
     //preload status texts
     const std::wstring txtCreatingFile     {_("Creating file %x"         )};
@@ -760,7 +835,8 @@ template <SelectedSide side>
 void SynchronizeFolderPair::prepare2StepMove(FilePair& sourceObj,
                                              FilePair& targetObj) //throw FileError
 {
-    Zstring sourceRelPathTmp = sourceObj.getItemName<side>() + AFS::TEMP_FILE_ENDING;
+    const Zstring sourceItemName = sourceObj.getItemName<side>();
+    Zstring sourceRelPathTmp = sourceItemName + AFS::TEMP_FILE_ENDING;
     //this could still lead to a name-clash in obscure cases, if some file exists on the other side with
     //the very same (.ffs_tmp) name and is copied before the second step of the move is executed
     //good news: even in this pathologic case, this may only prevent the copy of the other file, but not the move
@@ -780,7 +856,7 @@ void SynchronizeFolderPair::prepare2StepMove(FilePair& sourceObj,
         catch (const ErrorTargetExisting&) //repeat until unique name found: no file system race condition!
         {
             if (i == 10) throw; //avoid endless recursion in pathological cases
-            sourceRelPathTmp = sourceObj.getItemName<side>() + Zchar('_') + numberTo<Zstring>(i) + AFS::TEMP_FILE_ENDING;
+            sourceRelPathTmp = sourceItemName + Zchar('_') + numberTo<Zstring>(i) + AFS::TEMP_FILE_ENDING;
         }
 
     warn_static("was wenn diff volume: symlink aliasing!") //throw FileError, ErrorDifferentVolume, ErrorTargetExisting
@@ -789,10 +865,11 @@ void SynchronizeFolderPair::prepare2StepMove(FilePair& sourceObj,
     const FileDescriptor descrSource(sourceObj.getLastWriteTime <side>(),
                                      sourceObj.getFileSize      <side>(),
                                      sourceObj.getFileId        <side>(),
+                                     0, //change time: renaming changed it
                                      sourceObj.isFollowedSymlink<side>());
 
     FilePair& tempFile = sourceObj.base().addSubFile<side>(afterLast(sourceRelPathTmp, FILE_NAME_SEPARATOR, IF_MISSING_RETURN_ALL), descrSource);
-    static_assert(IsSameType<FixedList<FilePair>, HierarchyObject::FileList>::value,
+    static_assert(IsSameType<FixedList<FilePair, ObjectPoolAlloc>, HierarchyObject::FileList>::value,
                   "ATTENTION: we're adding to the file list WHILE looping over it! This is only working because FixedList iterators are not invalidated by insertion!");
     sourceObj.removeObject<side>(); //remove only *after* evaluating "sourceObj, side"!
 
@@ -1070,7 +1147,8 @@ void SynchronizeFolderPair::runPass(HierarchyObject& hierObj)
     //synchronize files:
     for (FilePair& file : hierObj.refSubFiles())
         if (pass == this->getPass(file)) //"this->" required by two-pass lookup as enforced by GCC 4.7
-            tryReportingError([&] { synchronizeFile(file); }, procCallback_); //throw X?
+            if (pass != PASS_TWO || !this->deferToDiskOrderPass(file))
+                tryReportingError([&] { synchronizeFile(file); }, procCallback_); //throw X?
 
     //synchronize symbolic links:
     for (SymlinkPair& symlink : hierObj.refSubLinks())
@@ -1119,6 +1197,72 @@ Opt<SelectedSide> getTargetDirection(SyncOperation syncOp)
 }
 
 
+bool SynchronizeFolderPair::deferToDiskOrderPass(FilePair& file)
+{
+    switch (file.getSyncOperation())
+    {
+        case SO_CREATE_NEW_LEFT:
+        case SO_OVERWRITE_LEFT:
+            if (!diskOrderRight_)
+                return false;
+            diskOrderFiles_.emplace_back(&file, RIGHT_SIDE);
+            return true;
+
+        case SO_CREATE_NEW_RIGHT:
+        case SO_OVERWRITE_RIGHT:
+            if (!diskOrderLeft_)
+                return false;
+            diskOrderFiles_.emplace_back(&file, LEFT_SIDE);
+            return true;
+
+        case SO_DELETE_LEFT:
+        case SO_DELETE_RIGHT:
+        case SO_MOVE_LEFT_SOURCE:
+        case SO_MOVE_LEFT_TARGET:
+        case SO_MOVE_RIGHT_SOURCE:
+        case SO_MOVE_RIGHT_TARGET:
+        case SO_COPY_METADATA_TO_LEFT:
+        case SO_COPY_METADATA_TO_RIGHT:
+        case SO_DO_NOTHING:
+        case SO_EQUAL:
+        case SO_UNRESOLVED_CONFLICT:
+            break;
+    }
+    return false;
+}
+
+
+void SynchronizeFolderPair::runDiskOrderPass()
+{
+    if (diskOrderFiles_.empty())
+        return;
+
+    const auto lookupStartTime = std::chrono::steady_clock::now();
+    std::vector<std::uint64_t> locations;
+    std::uint64_t bytesToCopy = 0;
+    for (const auto& item : diskOrderFiles_)
+    {
+        const FilePair& file = *item.first;
+        locations.push_back(AFS::getDiskLocation(item.second == LEFT_SIDE ? file.getAbstractPath<LEFT_SIDE>() : file.getAbstractPath<RIGHT_SIDE>())); //noexcept
+        bytesToCopy += item.second == LEFT_SIDE ? file.getFileSize<LEFT_SIDE>() : file.getFileSize<RIGHT_SIDE>();
+        procCallback_.requestUiRefresh(); //throw X
+    }
+    const std::vector<size_t> order = getDiskOrder(locations);
+    applyDiskOrder(diskOrderFiles_, order);
+    procCallback_.reportInfo(getDiskOrderReport(locations, order, std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - lookupStartTime))); //throw X
+
+    const auto copyStartTime = std::chrono::steady_clock::now();
+
+    for (const auto& item : diskOrderFiles_)
+        tryReportingError([&] { synchronizeFile(*item.first); }, procCallback_); //throw X?
+    diskOrderFiles_.clear();
+
+    procCallback_.reportInfo(replaceCpy(replaceCpy(_("Copying files in disk order: %x in %y ms"),
+                                                   L"%x", filesizeToShortString(static_cast<std::int64_t>(bytesToCopy))),
+                                        L"%y", numberTo<std::wstring>(std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - copyStartTime).count()))); //throw X
+}
+
+
 inline
 void SynchronizeFolderPair::synchronizeFile(FilePair& file)
 {
@@ -1835,6 +1979,7 @@ void zen::synchronize(const TimeComp& timeStamp,
                       bool failSafeFileCopy,
                       bool runWithBackgroundPriority,
                       int folderAccessTimeout,
+                      bool diskOrderedAccess,
                       const std::vector<FolderPairSyncCfg>& syncConfig,
                       FolderComparison& folderCmp,
                       ProcessCallback& callback)
@@ -2253,7 +2398,10 @@ void zen::synchronize(const TimeComp& timeStamp,
                                              callback);
 
 
-                SynchronizeFolderPair syncFP(callback, verifyCopiedFiles, copyPermissionsFp, failSafeFileCopy,
+                const bool diskOrderLeft  = diskOrderedAccess && AFS::getStorageDeviceInfo(j->getAbstractPath< LEFT_SIDE>()).rotational; //noexcept
+                const bool diskOrderRight = diskOrderedAccess && AFS::getStorageDeviceInfo(j->getAbstractPath<RIGHT_SIDE>()).rotational; //
+
+                SynchronizeFolderPair syncFP(callback, verifyCopiedFiles, copyPermissionsFp, failSafeFileCopy, diskOrderLeft, diskOrderRight,
 #ifdef ZEN_WIN
                                              shadowCopyHandler.get(),
 #endif
@@ -44,7 +44,11 @@ public:
     const std::vector<ConflictInfo>& getConflicts() const { return conflictMsgs; }
 
 private:
-    void recurse(const HierarchyObject& hierObj);
+    SyncStatistics() {}
+
+    void recurse(const HierarchyObject& hierObj); //uses and updates the statistics buffered by hierObj
+    void processChildren(const HierarchyObject& hierObj);
+    void collectConflicts(const HierarchyObject& hierObj); //precondition: statistics buffered
 
     void processFile(const FilePair& file);
     void processLink(const SymlinkPair& link);
@@ -93,6 +97,7 @@ void synchronize(const TimeComp& timeStamp,
                  bool failSafeFileCopy,
                  bool runWithBackgroundPriority,
                  int folderAccessTimeout,
+                 bool diskOrderedAccess, //spinning disks: copy files in the order of their physical location
                  const std::vector<FolderPairSyncCfg>& syncConfig, //CONTRACT: syncConfig and folderCmp correspond row-wise!
                  FolderComparison& folderCmp,                      //
                  ProcessCallback& callback);
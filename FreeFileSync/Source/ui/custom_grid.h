@@ -7,6 +7,7 @@
 #ifndef CUSTOM_GRID_H_8405817408327894
 #define CUSTOM_GRID_H_8405817408327894
 
+#include <unordered_set>
 #include <wx+/grid.h>
 #include "grid_view.h"
 #include "column_attr.h"
@@ -1337,6 +1337,7 @@ void extractFileDetails(const FileSystemObject& fsObj, Function onDetails)
                                                       FileDescriptor(file.getLastWriteTime <side>(),
                                                                      file.getFileSize      <side>(),
                                                                      file.getFileId        <side>(),
+                                                                     file.getChangeTime    <side>(),
                                                                      file.isFollowedSymlink<side>())
                                                     };
         onDetails(details);
@@ -2631,6 +2632,7 @@ void MainDialog::OnCompSettingsContext(wxEvent& event)
     addVariantItem(CompareVariant::TIME_SIZE, L"file-time-small");
     addVariantItem(CompareVariant::CONTENT,   L"file-content-small");
     addVariantItem(CompareVariant::SIZE,      L"file-size-small");
+    addVariantItem(CompareVariant::CONTENT_SAMPLED, L"file-content-sampled-small");
 
     //menu.addRadio(getVariantName(CompareVariant::TIME_SIZE), [&] { setVariant(CompareVariant::TIME_SIZE); }, activeCmpVar == CompareVariant::TIME_SIZE);
     //menu.addRadio(getVariantName(CompareVariant::CONTENT  ), [&] { setVariant(CompareVariant::CONTENT);   }, activeCmpVar == CompareVariant::CONTENT);
@@ -3750,6 +3752,17 @@ void MainDialog::OnCompare(wxCommandEvent& event)
                             true, //allowUserInteraction
                             globalCfg.runWithBackgroundPriority,
                             globalCfg.folderAccessTimeout,
+                            globalCfg.scanThreadsPerFolder,
+                            globalCfg.scanAllowStaleAttributes,
+                            globalCfg.scanSnapshotMode,
+                            globalCfg.scanDeferErrors,
+                            globalCfg.contentCompareThreads,
+                            globalCfg.contentHashCache,
+                            globalCfg.trustSyncDatabase,
+                            globalCfg.sampledCompareBlocks,
+                            globalCfg.sampledCompareFullPercent,
+                            globalCfg.diskOrderedAccess,
+                            globalCfg.outOfCoreFolderPath,
                             globalCfg.createLockFile,
                             dirLocks,
                             cmpConfig,
@@ -3883,6 +3896,7 @@ void MainDialog::applyCompareConfig(bool setDefaultViewType)
                 break;
 
             case CompareVariant::CONTENT:
+            case CompareVariant::CONTENT_SAMPLED:
                 setViewTypeSyncAction(false);
                 break;
         }
@@ -3974,6 +3988,7 @@ void MainDialog::OnStartSync(wxCommandEvent& event)
                     globalCfg.failSafeFileCopy,
                     globalCfg.runWithBackgroundPriority,
                     globalCfg.folderAccessTimeout,
+                    globalCfg.diskOrderedAccess,
                     syncProcessCfg,
                     folderCmp,
                     statusHandler);
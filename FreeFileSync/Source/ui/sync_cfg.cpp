@@ -73,7 +73,13 @@ private:
 
     void OnToggleLocalCompSettings(wxCommandEvent& event) override { updateCompGui(); updateSyncGui(); /*affects sync settings, too!*/ }
     void OnCompByTimeSize         (wxCommandEvent& event) override { localCmpVar = CompareVariant::TIME_SIZE; updateCompGui(); updateSyncGui(); } //
-    void OnCompByContent          (wxCommandEvent& event) override { localCmpVar = CompareVariant::CONTENT;   updateCompGui(); updateSyncGui(); } //affects sync settings, too!
+    void OnCompByContent          (wxCommandEvent& event) override //affects sync settings, too!
+    {
+        //clicking the active button switches between complete and sampled content comparison: see variant description
+        localCmpVar = localCmpVar == CompareVariant::CONTENT ? CompareVariant::CONTENT_SAMPLED : CompareVariant::CONTENT;
+        updateCompGui();
+        updateSyncGui();
+    }
     void OnCompBySize             (wxCommandEvent& event) override { localCmpVar = CompareVariant::SIZE;      updateCompGui(); updateSyncGui(); } //
     void OnCompByTimeSizeDouble   (wxMouseEvent&   event) override;
     void OnCompBySizeDouble       (wxMouseEvent&   event) override;
@@ -188,6 +194,8 @@ std::wstring getCompVariantDescription(CompareVariant var)
             return _("Identify equal files by comparing the file content.");
         case CompareVariant::SIZE:
             return _("Identify equal files by comparing their file size.");
+        case CompareVariant::CONTENT_SAMPLED:
+            return _("Identify equal files by comparing the beginning, the end and a few blocks in between of the file content.");
     }
     assert(false);
     return _("Error");
@@ -470,7 +478,9 @@ void ConfigDialog::OnCompBySizeDouble(wxMouseEvent& event)
 void ConfigDialog::OnCompByContentDouble(wxMouseEvent& event)
 {
     wxCommandEvent dummy;
-    OnCompByContent(dummy);
+    if (localCmpVar != CompareVariant::CONTENT &&
+        localCmpVar != CompareVariant::CONTENT_SAMPLED) //the single clicks already selected the variant: don't switch it again
+        OnCompByContent(dummy);
     OnOkay(dummy);
 }
 
@@ -551,6 +561,7 @@ void ConfigDialog::updateCompGui()
                 m_toggleBtnByTimeSize->SetValue(true);
                 break;
             case CompareVariant::CONTENT:
+            case CompareVariant::CONTENT_SAMPLED:
                 m_toggleBtnByContent->SetValue(true);
                 break;
             case CompareVariant::SIZE:
@@ -567,7 +578,7 @@ void ConfigDialog::updateCompGui()
             bmpCtrl.SetBitmap(greyScale(bmp));
     };
     setBitmap(*m_bitmapByTimeSize, localCmpVar == CompareVariant::TIME_SIZE, getResourceImage(L"file-time"));
-    setBitmap(*m_bitmapByContent,  localCmpVar == CompareVariant::CONTENT,   getResourceImage(L"file-content"));
+    setBitmap(*m_bitmapByContent,  localCmpVar == CompareVariant::CONTENT || localCmpVar == CompareVariant::CONTENT_SAMPLED, getResourceImage(L"file-content"));
     setBitmap(*m_bitmapBySize,     localCmpVar == CompareVariant::SIZE,      getResourceImage(L"file-size"));
 
     //active variant description:
@@ -957,8 +968,8 @@ void ConfigDialog::updateSyncGui()
         m_bitmapRightNewer  ->Show(activeCmpVar == CompareVariant::TIME_SIZE);
         m_bpButtonRightNewer->Show(activeCmpVar == CompareVariant::TIME_SIZE);
 
-        m_bitmapDifferent  ->Show(activeCmpVar == CompareVariant::CONTENT || activeCmpVar == CompareVariant::SIZE);
-        m_bpButtonDifferent->Show(activeCmpVar == CompareVariant::CONTENT || activeCmpVar == CompareVariant::SIZE);
+        m_bitmapDifferent  ->Show(activeCmpVar == CompareVariant::CONTENT || activeCmpVar == CompareVariant::CONTENT_SAMPLED || activeCmpVar == CompareVariant::SIZE);
+        m_bpButtonDifferent->Show(activeCmpVar == CompareVariant::CONTENT || activeCmpVar == CompareVariant::CONTENT_SAMPLED || activeCmpVar == CompareVariant::SIZE);
     }
 
     //active variant description:
@@ -5,6 +5,7 @@
 // *****************************************************************************
 
 #include <set>
+#include <unordered_set>
 #include "tree_view.h"
 #include <wx/settings.h>
 #include <wx/menu.h>
@@ -0,0 +1,175 @@
+// *****************************************************************************
+// * This file is part of the FreeFileSync project. It is distributed under    *
+// * GNU General Public License: http://www.gnu.org/licenses/gpl-3.0           *
+// * Copyright (C) Zenju (zenju AT freefilesync DOT org) - All Rights Reserved *
+// *****************************************************************************
+
+#ifndef BLAKE2B_H_5820394857203948572
+#define BLAKE2B_H_5820394857203948572
+
+#include <cstdint>
+#include <cstring>
+#include <algorithm>
+
+
+namespace zen
+{
+struct Hash128
+{
+    std::uint64_t low  = 0;
+    std::uint64_t high = 0;
+};
+
+inline bool operator==(const Hash128& lhs, const Hash128& rhs) { return lhs.low == rhs.low && lhs.high == rhs.high; }
+inline bool operator!=(const Hash128& lhs, const Hash128& rhs) { return !(lhs == rhs); }
+
+
+//BLAKE2b with 128 bit digest, unkeyed (RFC 7693): cryptographic hash => equal hashes may decide file equality without reading the data
+class Blake2bHash128
+{
+public:
+    Blake2bHash128()
+    {
+        std::copy(getIv(), getIv() + 8, h_);
+        h_[0] ^= 0x01010000 ^ DIGEST_SIZE; //parameter block: fanout = depth = 1, no key
+    }
+
+    //incremental: any split of the input into update() calls yields the same hash
+    void update(const void* data, size_t size)
+    {
+        auto it  = static_cast<const unsigned char*>(data);
+        auto end = it + size;
+
+        while (it != end)
+        {
+            if (pendingSize_ == BLOCK_SIZE) //the last block is processed by finalize(): needs the "final block" flag
+            {
+                addToCounter(BLOCK_SIZE);
+                compress(pending_, false);
+                pendingSize_ = 0;
+            }
+
+            if (pendingSize_ == 0)
+                for (; end - it > static_cast<std::ptrdiff_t>(BLOCK_SIZE); it += BLOCK_SIZE) //keep at least one byte for the last block
+                {
+                    addToCounter(BLOCK_SIZE);
+                    compress(it, false);
+                }
+
+            const size_t bytesToCopy = std::min<size_t>(BLOCK_SIZE - pendingSize_, end - it);
+            std::memcpy(pending_ + pendingSize_, it, bytesToCopy);
+            pendingSize_ += bytesToCopy;
+            it += bytesToCopy;
+        }
+    }
+
+    Hash128 finalize() const
+    {
+        Blake2bHash128 tmp = *this;
+        std::memset(tmp.pending_ + tmp.pendingSize_, 0, BLOCK_SIZE - tmp.pendingSize_);
+        tmp.addToCounter(tmp.pendingSize_);
+        tmp.compress(tmp.pending_, true);
+
+        Hash128 hash; //first 16 bytes of the little-endian state
+        hash.low  = tmp.h_[0];
+        hash.high = tmp.h_[1];
+        return hash;
+    }
+
+private:
+    static const size_t BLOCK_SIZE  = 128;
+    static const size_t DIGEST_SIZE = 16;
+
+    static const std::uint64_t* getIv()
+    {
+        static const std::uint64_t iv[8] =
+        {
+            0x6a09e667f3bcc908ULL, 0xbb67ae8584caa73bULL, 0x3c6ef372fe94f82bULL, 0xa54ff53a5f1d36f1ULL,
+            0x510e527fade682d1ULL, 0x9b05688c2b3e6c1fULL, 0x1f83d9abfb41bd6bULL, 0x5be0cd19137e2179ULL
+        };
+        return iv;
+    }
+
+    static std::uint64_t rotr(std::uint64_t x, int r) { return (x >> r) | (x << (64 - r)); }
+
+    static std::uint64_t readLittleEndian(const unsigned char* ptr)
+    {
+        std::uint64_t val = 0;
+        for (int i = 7; i >= 0; --i)
+            val = (val << 8) | ptr[i];
+        return val; //compiles to a single load on little-endian platforms
+    }
+
+    void addToCounter(size_t bytes)
+    {
+        t_[0] += bytes;
+        if (t_[0] < bytes) //overflow
+            ++t_[1];
+    }
+
+    void compress(const unsigned char* block, bool lastBlock)
+    {
+        std::uint64_t m[16];
+        for (size_t i = 0; i < 16; ++i)
+            m[i] = readLittleEndian(block + 8 * i);
+
+        std::uint64_t v[16];
+        std::copy(h_, h_ + 8, v);
+        std::copy(getIv(), getIv() + 8, v + 8);
+        v[12] ^= t_[0];
+        v[13] ^= t_[1];
+        if (lastBlock)
+            v[14] = ~v[14];
+
+        auto mix = [&v](int a, int b, int c, int d, std::uint64_t x, std::uint64_t y)
+        {
+            v[a] = v[a] + v[b] + x;
+            v[d] = rotr(v[d] ^ v[a], 32);
+            v[c] = v[c] + v[d];
+            v[b] = rotr(v[b] ^ v[c], 24);
+            v[a] = v[a] + v[b] + y;
+            v[d] = rotr(v[d] ^ v[a], 16);
+            v[c] = v[c] + v[d];
+            v[b] = rotr(v[b] ^ v[c], 63);
+        };
+
+        static const unsigned char sigma[12][16] = //message word permutation per round
+        {
+            {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+            { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+            { 11,  8, 12,  0,  5,  2, 15, 13, 10, 14,  3,  6,  7,  1,  9,  4 },
+            {  7,  9,  3,  1, 13, 12, 11, 14,  2,  6,  5, 10,  4,  0, 15,  8 },
+            {  9,  0,  5,  7,  2,  4, 10, 15, 14,  1, 11, 12,  6,  8,  3, 13 },
+            {  2, 12,  6, 10,  0, 11,  8,  3,  4, 13,  7,  5, 15, 14,  1,  9 },
+            { 12,  5,  1, 15, 14, 13,  4, 10,  0,  7,  6,  3,  9,  2,  8, 11 },
+            { 13, 11,  7, 14, 12,  1,  3,  9,  5,  0, 15,  4,  8,  6,  2, 10 },
+            {  6, 15, 14,  9, 11,  3,  0,  8, 12,  2, 13,  7,  1,  4, 10,  5 },
+            { 10,  2,  8,  4,  7,  6,  1,  5, 15, 11,  9, 14,  3, 12, 13,  0 },
+            {  0,  1,  2,  3,  4,  5,  6,  7,  8,  9, 10, 11, 12, 13, 14, 15 },
+            { 14, 10,  4,  8,  9, 15, 13,  6,  1, 12,  0,  2, 11,  7,  5,  3 },
+        };
+
+        for (const unsigned char (&s)[16] : sigma)
+        {
+            mix(0, 4,  8, 12, m[s[ 0]], m[s[ 1]]);
+            mix(1, 5,  9, 13, m[s[ 2]], m[s[ 3]]);
+            mix(2, 6, 10, 14, m[s[ 4]], m[s[ 5]]);
+            mix(3, 7, 11, 15, m[s[ 6]], m[s[ 7]]);
+            mix(0, 5, 10, 15, m[s[ 8]], m[s[ 9]]);
+            mix(1, 6, 11, 12, m[s[10]], m[s[11]]);
+            mix(2, 7,  8, 13, m[s[12]], m[s[13]]);
+            mix(3, 4,  9, 14, m[s[14]], m[s[15]]);
+        }
+
+        for (size_t i = 0; i < 8; ++i)
+            h_[i] ^= v[i] ^ v[i + 8];
+    }
+
+    std::uint64_t h_[8];
+    std::uint64_t t_[2] = {}; //number of bytes hashed
+    unsigned char pending_[BLOCK_SIZE] = {}; //last block of the previous update(): processed by finalize() if no more data follows
+    size_t pendingSize_ = 0;
+};
+}
+
+#endif //BLAKE2B_H_5820394857203948572
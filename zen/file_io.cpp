@@ -17,7 +17,7 @@
 #elif defined ZEN_LINUX || defined ZEN_MAC
     #include <sys/stat.h>
     #include <fcntl.h>  //open, close
-    #include <unistd.h> //read, write
+    #include <unistd.h> //read, write, lseek
 #endif
 
 using namespace zen;
@@ -213,6 +213,24 @@ size_t FileInput::tryRead(void* buffer, size_t bytesToRead) //throw FileError; m
     return bytesRead; //"zero indicates end of file"
 }
 
+
+void FileInput::seek(std::uint64_t offset) //throw FileError
+{
+#ifdef ZEN_WIN
+    LARGE_INTEGER newPos = {};
+    newPos.QuadPart = static_cast<LONGLONG>(offset);
+    if (!::SetFilePointerEx(fileHandle, //__in       HANDLE hFile,
+                            newPos,     //__in       LARGE_INTEGER liDistanceToMove,
+                            nullptr,    //__out_opt  PLARGE_INTEGER lpNewFilePointer,
+                            FILE_BEGIN)) //__in       DWORD dwMoveMethod
+        THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot read file %x."), L"%x", fmtPath(getFilePath())), L"SetFilePointerEx");
+
+#elif defined ZEN_LINUX || defined ZEN_MAC
+    if (::lseek(fileHandle, static_cast<off_t>(offset), SEEK_SET) < 0)
+        THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot read file %x."), L"%x", fmtPath(getFilePath())), L"lseek");
+#endif
+}
+
 //----------------------------------------------------------------------------------------------------
 
 FileOutput::FileOutput(FileHandle handle, const Zstring& filepath) : FileBase(filepath), fileHandle(handle) {}
@@ -59,6 +59,7 @@ public:
     //Linux: use st_blksize?
     size_t getBlockSize() const { return 128 * 1024; }
     size_t tryRead(void* buffer, size_t bytesToRead); //throw FileError; may return short, only 0 means EOF! =>  CONTRACT: bytesToRead > 0!
+    void seek(std::uint64_t offset); //throw FileError; absolute position for the next read
 
     FileHandle getHandle() { return fileHandle; }
 
@@ -0,0 +1,166 @@
+// *****************************************************************************
+// * This file is part of the FreeFileSync project. It is distributed under    *
+// * GNU General Public License: http://www.gnu.org/licenses/gpl-3.0           *
+// * Copyright (C) Zenju (zenju AT freefilesync DOT org) - All Rights Reserved *
+// *****************************************************************************
+
+#ifndef FILE_MAPPING_H_4710582936401758
+#define FILE_MAPPING_H_4710582936401758
+
+#include <new>
+#include <vector>
+#include <cassert>
+#include <cstdint>
+#include "file_error.h"
+#include "scope_guard.h"
+#include "i18n.h"
+
+#ifdef ZEN_WIN
+    #include "win.h" //includes "windows.h"
+
+#elif defined ZEN_LINUX || defined ZEN_MAC
+    #include <fcntl.h>    //posix_fallocate
+    #include <unistd.h>   //close, unlink, ftruncate
+    #include <sys/mman.h> //mmap
+#endif
+
+
+namespace zen
+{
+//memory backed by a temporary file instead of the page file: the OS may write pages back to the file and drop them from RAM
+//=> bounded resident memory for huge data sets accessed mostly sequentially; the file is deleted automatically, even after a crash
+class TempFileMapping
+{
+public:
+    explicit TempFileMapping(const Zstring& folderPath); //throw FileError
+    ~TempFileMapping();
+
+    static const size_t GRANULARITY = 64 * 1024; //Windows: file offsets of mapped views must be aligned to the allocation granularity
+
+    //append "bytes" (multiple of GRANULARITY) to the file: memory is zero-initialized and valid until destruction
+    char* map(size_t bytes); //throw std::bad_alloc
+
+private:
+    TempFileMapping           (const TempFileMapping&) = delete;
+    TempFileMapping& operator=(const TempFileMapping&) = delete;
+
+    std::uint64_t fileSize_ = 0;
+    std::vector<std::pair<char*, size_t>> views_;
+#ifdef ZEN_WIN
+    HANDLE fileHandle_ = INVALID_HANDLE_VALUE;
+#elif defined ZEN_LINUX || defined ZEN_MAC
+    int fileHandle_ = -1;
+#endif
+};
+
+
+
+
+
+
+
+//######################## implementation ########################
+inline
+TempFileMapping::TempFileMapping(const Zstring& folderPath) //throw FileError
+{
+#ifdef ZEN_WIN
+    wchar_t filePath[MAX_PATH] = {};
+    if (::GetTempFileName(folderPath.c_str(), //_In_  LPCTSTR lpPathName,
+                          L"map",             //_In_  LPCTSTR lpPrefixString,
+                          0,                  //_In_  UINT    uUnique,
+                          filePath) == 0)     //_Out_ LPTSTR  lpTempFileName
+        THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot create file %x."), L"%x", fmtPath(folderPath)), L"GetTempFileName");
+
+    fileHandle_ = ::CreateFile(filePath,                     //_In_     LPCTSTR               lpFileName,
+                               GENERIC_READ | GENERIC_WRITE, //_In_     DWORD                 dwDesiredAccess,
+                               0,                            //_In_     DWORD                 dwShareMode,
+                               nullptr,                      //_In_opt_ LPSECURITY_ATTRIBUTES lpSecurityAttributes,
+                               OPEN_EXISTING,                //_In_     DWORD                 dwCreationDisposition,
+                               FILE_ATTRIBUTE_TEMPORARY | FILE_FLAG_DELETE_ON_CLOSE, //_In_ DWORD dwFlagsAndAttributes,
+                               nullptr);                     //_In_opt_ HANDLE                hTemplateFile
+    if (fileHandle_ == INVALID_HANDLE_VALUE)
+    {
+        const DWORD ec = ::GetLastError(); //copy before making other system calls!
+        ::DeleteFile(filePath);
+        throw FileError(replaceCpy(_("Cannot create file %x."), L"%x", fmtPath(filePath)), formatSystemError(L"CreateFile", ec));
+    }
+
+#elif defined ZEN_LINUX || defined ZEN_MAC
+    const Zstring templatePath = appendSeparator(folderPath) + Zstr("mapped_memory_XXXXXX");
+    std::vector<char> filePath(templatePath.c_str(), templatePath.c_str() + templatePath.size() + 1);
+
+    fileHandle_ = ::mkstemp(&filePath[0]);
+    if (fileHandle_ == -1)
+        THROW_LAST_FILE_ERROR(replaceCpy(_("Cannot create file %x."), L"%x", fmtPath(templatePath)), L"mkstemp");
+
+    ::unlink(&filePath[0]); //no name: the file is removed as soon as it is closed
+#endif
+}
+
+
+inline
+TempFileMapping::~TempFileMapping()
+{
+#ifdef ZEN_WIN
+    for (const auto& view : views_)
+        ::UnmapViewOfFile(view.first);
+    ::CloseHandle(fileHandle_);
+
+#elif defined ZEN_LINUX || defined ZEN_MAC
+    for (const auto& view : views_)
+        ::munmap(view.first, view.second);
+    ::close(fileHandle_);
+#endif
+}
+
+
+inline
+char* TempFileMapping::map(size_t bytes) //throw std::bad_alloc
+{
+    assert(bytes > 0 && bytes % GRANULARITY == 0);
+    views_.reserve(views_.size() + 1); //throw std::bad_alloc; don't leak a view below
+
+    const std::uint64_t offset = fileSize_;
+    const std::uint64_t fileSizeNew = fileSize_ + bytes;
+#ifdef ZEN_WIN
+    //the file is extended when creating the mapping object; fails if the disk is full
+    HANDLE mappingHandle = ::CreateFileMapping(fileHandle_,                            //_In_     HANDLE                hFile,
+                                               nullptr,                                //_In_opt_ LPSECURITY_ATTRIBUTES lpAttributes,
+                                               PAGE_READWRITE,                         //_In_     DWORD                 flProtect,
+                                               static_cast<DWORD>(fileSizeNew >> 32),  //_In_     DWORD                 dwMaximumSizeHigh,
+                                               static_cast<DWORD>(fileSizeNew),        //_In_     DWORD                 dwMaximumSizeLow,
+                                               nullptr);                               //_In_opt_ LPCTSTR               lpName
+    if (!mappingHandle)
+        throw std::bad_alloc();
+    ZEN_ON_SCOPE_EXIT(::CloseHandle(mappingHandle)); //the view keeps the mapping object alive
+
+    void* view = ::MapViewOfFile(mappingHandle,                     //_In_ HANDLE hFileMappingObject,
+                                 FILE_MAP_WRITE,                    //_In_ DWORD  dwDesiredAccess,
+                                 static_cast<DWORD>(offset >> 32),  //_In_ DWORD  dwFileOffsetHigh,
+                                 static_cast<DWORD>(offset),        //_In_ DWORD  dwFileOffsetLow,
+                                 bytes);                            //_In_ SIZE_T dwNumberOfBytesToMap
+    if (!view)
+        throw std::bad_alloc();
+
+#elif defined ZEN_LINUX || defined ZEN_MAC
+    //reserve disk space now: writing to a page of a sparse file on a full disk would raise SIGBUS instead of an error
+#ifdef ZEN_LINUX
+    if (::posix_fallocate(fileHandle_, offset, bytes) != 0)
+        throw std::bad_alloc();
+#else
+    if (::ftruncate(fileHandle_, fileSizeNew) != 0) //OS X: no posix_fallocate()
+        throw std::bad_alloc();
+#endif
+
+    void* view = ::mmap(nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED, fileHandle_, offset);
+    if (view == MAP_FAILED)
+        throw std::bad_alloc();
+#endif
+
+    fileSize_ = fileSizeNew;
+    views_.emplace_back(static_cast<char*>(view), bytes);
+    return static_cast<char*>(view);
+}
+}
+
+#endif //FILE_MAPPING_H_4710582936401758
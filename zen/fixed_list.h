@@ -9,13 +9,22 @@
 
 #include <cassert>
 #include <iterator>
+#include <new>
 
 
 namespace zen
 {
+//default node allocation: one heap allocation per element
+struct FixedListHeapAlloc
+{
+    static void* allocate(size_t bytes, size_t /*alignment*/) { return ::operator new(bytes); } //throw std::bad_alloc
+    static void deallocate(void* ptr, size_t /*bytes*/) { ::operator delete(ptr); }
+};
+
+
 //std::list(C++11)-like class for inplace element construction supporting non-copyable/movable types
 //may be replaced by C++11 std::list when available...or never...
-template <class T>
+template <class T, class NodeAlloc = FixedListHeapAlloc>
 class FixedList
 {
     struct Node
@@ -28,7 +37,7 @@ class FixedList
     };
 
 public:
-    FixedList() {}
+    explicit FixedList(const NodeAlloc& alloc = NodeAlloc()) : alloc_(alloc) {}
 
     ~FixedList() { clear(); }
 
@@ -68,7 +77,15 @@ public:
     const_reference& back() const { return lastInsert->val; }
 
     template <class... Args>
-    void emplace_back(Args&& ... args) { pushNode(new Node(std::forward<Args>(args)...)); }
+    void emplace_back(Args&& ... args)
+    {
+        void* const nodeBuf = alloc_.allocate(sizeof(Node), alignof(Node)); //throw std::bad_alloc
+        try
+        {
+            pushNode(new (nodeBuf) Node(std::forward<Args>(args)...));
+        }
+        catch (...) { alloc_.deallocate(nodeBuf, sizeof(Node)); throw; }
+    }
 
     template <class Predicate>
     void remove_if(Predicate pred)
@@ -120,8 +137,11 @@ public:
         std::swap(firstInsert, other.firstInsert);
         std::swap(lastInsert , other.lastInsert);
         std::swap(sz         , other.sz);
+        std::swap(alloc_     , other.alloc_);
     }
 
+    const NodeAlloc& get_allocator() const { return alloc_; }
+
 private:
     FixedList           (const FixedList&) = delete;
     FixedList& operator=(const FixedList&) = delete;
@@ -146,12 +166,14 @@ private:
     {
         assert(sz > 0);
         --sz;
-        delete oldNode;
+        oldNode->~Node();
+        alloc_.deallocate(oldNode, sizeof(Node));
     }
 
     Node* firstInsert = nullptr;
     Node* lastInsert  = nullptr; //point to last insertion; required by efficient emplace_back()
     size_t sz = 0;
+    NodeAlloc alloc_;
 };
 }
 
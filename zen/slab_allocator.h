@@ -0,0 +1,150 @@
+// *****************************************************************************
+// * This file is part of the FreeFileSync project. It is distributed under    *
+// * GNU General Public License: http://www.gnu.org/licenses/gpl-3.0           *
+// * Copyright (C) Zenju (zenju AT freefilesync DOT org) - All Rights Reserved *
+// *****************************************************************************
+
+#ifndef SLAB_ALLOCATOR_H_8391047562019384756
+#define SLAB_ALLOCATOR_H_8391047562019384756
+
+#include <atomic>
+#include <new>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <cassert>
+#include <cstdint>
+#include <algorithm>
+#include "file_mapping.h"
+
+
+namespace zen
+{
+//thread-safe allocator for many small objects sharing the same lifetime: memory is taken from large slabs and released all at once
+//by the destructor => no per-object heap overhead, no fragmentation, objects created together are adjacent in memory
+//deallocated blocks are kept in a free list per block size and reused by later allocations of the same size, e.g. rows removed after comparison
+class SlabAllocator
+{
+public:
+    explicit SlabAllocator(std::unique_ptr<TempFileMapping> backingFile = nullptr) : backingFile_(std::move(backingFile)) {} //optional: take slabs from a memory-mapped file instead of the heap
+
+    void* allocate(size_t bytes, size_t alignment) //throw std::bad_alloc
+    {
+        assert(alignment <= ALIGNMENT && ALIGNMENT % alignment == 0);
+        bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+        if (freeBlockCount_.load(std::memory_order_relaxed) != 0) //don't lock unless something was deallocated
+        {
+            std::lock_guard<std::mutex> dummy(lockFreeLists_);
+            for (FreeList& fl : freeLists_)
+                if (fl.blockSize == bytes && fl.first)
+                {
+                    FreeBlock* block = fl.first;
+                    fl.first = block->next;
+                    --freeBlockCount_;
+                    return block; //all blocks are aligned to ALIGNMENT
+                }
+        }
+
+        for (;;)
+        {
+            Slab* slab = current_.load(std::memory_order_acquire);
+            if (slab)
+            {
+                const size_t pos = slab->used.fetch_add(bytes, std::memory_order_relaxed); //lock-free for concurrent MergeSides threads
+                if (pos + bytes <= slab->size)
+                    return slab->data + pos;
+            }
+
+            std::lock_guard<std::mutex> dummy(lockSlabs_);
+            if (current_.load(std::memory_order_relaxed) == slab) //not yet replaced by another thread
+            {
+                const size_t minSlabSize = backingFile_ ? MIN_MAPPED_SLAB_SIZE : MIN_SLAB_SIZE;
+                const size_t maxSlabSize = backingFile_ ? MAX_MAPPED_SLAB_SIZE : MAX_SLAB_SIZE; //fewer mappings: each costs a kernel object
+
+                size_t slabSize = slabs_.empty() ? minSlabSize : 2 * slabs_.back()->size; //grow exponentially: small folder pairs should not waste a large slab
+                if (slabSize > maxSlabSize)
+                    slabSize = maxSlabSize;
+                if (slabSize < bytes)
+                    slabSize = (bytes + minSlabSize - 1) / minSlabSize * minSlabSize;
+
+                slabs_.reserve(slabs_.size() + 1); //throw std::bad_alloc
+                if (backingFile_)
+                    slabs_.push_back(std::make_unique<Slab>(nullptr, backingFile_->map(slabSize), slabSize)); //throw std::bad_alloc
+                else
+                {
+                    std::unique_ptr<char[]> heapData(new char[slabSize]); //throw std::bad_alloc; operator new[]: aligned for any fundamental type
+                    char* data = heapData.get();
+                    slabs_.push_back(std::make_unique<Slab>(std::move(heapData), data, slabSize)); //throw std::bad_alloc
+                }
+                current_.store(slabs_.back().get(), std::memory_order_release);
+            }
+        }
+    }
+
+    void deallocate(void* ptr, size_t bytes) //noexcept
+    {
+        bytes = (bytes + ALIGNMENT - 1) / ALIGNMENT * ALIGNMENT;
+
+        std::lock_guard<std::mutex> dummy(lockFreeLists_);
+        for (FreeList& fl : freeLists_)
+            if (fl.blockSize == bytes || fl.blockSize == 0)
+            {
+                fl.blockSize = bytes;
+                fl.first = new (ptr) FreeBlock{ fl.first };
+                ++freeBlockCount_;
+                return;
+            }
+        //more distinct block sizes than free lists: memory is reused only after the allocator is gone
+    }
+
+    //memory report
+    std::uint64_t getBytesReserved() const
+    {
+        std::lock_guard<std::mutex> dummy(lockSlabs_);
+        std::uint64_t bytesReserved = 0;
+        for (const auto& slab : slabs_)
+            bytesReserved += slab->size;
+        return bytesReserved;
+    }
+
+private:
+    SlabAllocator           (const SlabAllocator&) = delete;
+    SlabAllocator& operator=(const SlabAllocator&) = delete;
+
+    static const size_t ALIGNMENT     = std::max(alignof(void*), alignof(std::int64_t)); //sufficient for objects made of pointers and 64-bit integers
+    static const size_t MIN_SLAB_SIZE = 4 * 1024;
+    static const size_t MAX_SLAB_SIZE = 1024 * 1024;
+    static const size_t MIN_MAPPED_SLAB_SIZE = TempFileMapping::GRANULARITY;
+    static const size_t MAX_MAPPED_SLAB_SIZE = 64 * 1024 * 1024;
+
+    struct Slab
+    {
+        Slab(std::unique_ptr<char[]>&& heapDataIn, char* dataIn, size_t sizeIn) : heapData(std::move(heapDataIn)), data(dataIn), size(sizeIn) {}
+
+        const std::unique_ptr<char[]> heapData; //nullptr if memory-mapped: unmapped by TempFileMapping
+        char* const data;
+        const size_t size;
+        std::atomic<size_t> used { 0 }; //may exceed "size" after failed allocations
+    };
+
+    struct FreeBlock { FreeBlock* next; }; //stored inside the deallocated memory
+
+    struct FreeList
+    {
+        size_t blockSize = 0; //0: unused
+        FreeBlock* first = nullptr;
+    };
+
+    const std::unique_ptr<TempFileMapping> backingFile_;
+    mutable std::mutex lockSlabs_;
+    std::vector<std::unique_ptr<Slab>> slabs_;
+    std::atomic<Slab*> current_ { nullptr };
+
+    std::mutex lockFreeLists_;
+    FreeList freeLists_[8]; //few distinct sizes: node sizes are fixed per FixedList<T>
+    std::atomic<size_t> freeBlockCount_ { 0 };
+};
+}
+
+#endif //SLAB_ALLOCATOR_H_8391047562019384756